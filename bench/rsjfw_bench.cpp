@@ -0,0 +1,529 @@
+// rsjfw-bench: reproducible Downloader::installVersion benchmark.
+//
+// Generates a synthetic Studio version (manifest plus zip packages shaped
+// like a real one), serves it from a forked localhost HTTP server with
+// optional latency and per-connection bandwidth shaping, points the
+// installer at it through installer.mirror and reports per-phase timings,
+// throughput and resource usage as JSON.
+
+#include "rsjfw/config.hpp"
+#include "rsjfw/downloader.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/path_manager.hpp"
+#include "rsjfw/roblox_api.hpp"
+#include <archive.h>
+#include <archive_entry.h>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string VERSION_GUID = "version-rsjfwbench0000";
+
+struct Options {
+  double scale = 0.1;
+  int runs = 3;
+  int latencyMs = 0;
+  int bandwidthKBps = 0; // per connection, 0 = unshaped
+  int maxTransfers = 16;
+  bool stream = true;
+  std::string jsonPath;
+  bool keep = false;
+};
+
+// Packed size in MiB and file count of a real Studio release, roughly
+struct PackageShape {
+  const char *name;
+  double packedMB;
+  int files;
+};
+
+const std::vector<PackageShape> PROFILE = {
+    {"RobloxStudio.zip", 140, 4},
+    {"Libraries.zip", 20, 40},
+    {"LibrariesQt5.zip", 25, 60},
+    {"redist.zip", 2, 10},
+    {"shaders.zip", 3, 200},
+    {"ssl.zip", 1, 2},
+    {"ApplicationConfig.zip", 1, 20},
+    {"Plugins.zip", 1, 10},
+    {"content-avatar.zip", 60, 900},
+    {"content-configs.zip", 1, 30},
+    {"content-fonts.zip", 10, 80},
+    {"content-models.zip", 25, 400},
+    {"content-sky.zip", 2, 30},
+    {"content-sounds.zip", 5, 60},
+    {"content-textures2.zip", 30, 1500},
+    {"content-terrain.zip", 30, 120},
+    {"content-platform-fonts.zip", 8, 40},
+    {"content-studio_svg_textures.zip", 4, 2500},
+    {"extracontent-luapackages.zip", 40, 12000},
+    {"extracontent-translations.zip", 15, 300},
+    {"extracontent-models.zip", 10, 150},
+    {"extracontent-textures.zip", 5, 200},
+    {"BuiltInPlugins.zip", 20, 60},
+    {"BuiltInStandalonePlugins.zip", 5, 20},
+    {"StudioFonts.zip", 1, 10},
+};
+
+void usage() {
+  std::cout
+      << "Usage: rsjfw-bench [options]\n\n"
+      << "  --scale F           Package size multiplier (default 0.1)\n"
+      << "  --runs N            Cold installs to time (default 3)\n"
+      << "  --latency-ms N      Server delay before each response\n"
+      << "  --bandwidth-kbps N  Per-connection rate cap in KiB/s\n"
+      << "  --max-transfers N   installer.max_transfers (default 16)\n"
+      << "  --no-stream         Download packages before extracting\n"
+      << "  --json FILE         Write the report to FILE instead of stdout\n"
+      << "  --keep              Keep the work directory\n";
+}
+
+bool parseArgs(int argc, char **argv, Options &o) {
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    auto next = [&]() -> std::string {
+      return i + 1 < argc ? argv[++i] : "";
+    };
+    try {
+      if (a == "--scale")
+        o.scale = std::stod(next());
+      else if (a == "--runs")
+        o.runs = std::stoi(next());
+      else if (a == "--latency-ms")
+        o.latencyMs = std::stoi(next());
+      else if (a == "--bandwidth-kbps")
+        o.bandwidthKBps = std::stoi(next());
+      else if (a == "--max-transfers")
+        o.maxTransfers = std::stoi(next());
+      else if (a == "--no-stream")
+        o.stream = false;
+      else if (a == "--json")
+        o.jsonPath = next();
+      else if (a == "--keep")
+        o.keep = true;
+      else
+        return false;
+    } catch (...) {
+      return false;
+    }
+  }
+  return o.scale > 0 && o.runs > 0;
+}
+
+// --- Synthetic packages -----------------------------------------------------
+
+// Half repeating text, half random bytes, so deflate has real work to do and
+// the result is about as compressible as Studio's assets
+void fillContent(std::vector<char> &buf, std::mt19937_64 &rng) {
+  static const char text[] = "local Roact = require(script.Parent.Roact)\n";
+  for (size_t i = 0; i < buf.size();) {
+    size_t run = std::min<size_t>(4096, buf.size() - i);
+    if (rng() & 1) {
+      for (size_t j = 0; j < run; ++j)
+        buf[i + j] = text[(i + j) % (sizeof(text) - 1)];
+    } else {
+      for (size_t j = 0; j < run; j += 8) {
+        uint64_t r = rng();
+        std::memcpy(&buf[i + j], &r, std::min<size_t>(8, run - j));
+      }
+    }
+    i += run;
+  }
+}
+
+bool writePackage(const fs::path &path, const PackageShape &shape,
+                  double scale, std::mt19937_64 &rng, uint64_t &unpacked) {
+  struct archive *a = archive_write_new();
+  archive_write_set_format_zip(a);
+  archive_write_zip_set_compression_deflate(a);
+  if (archive_write_open_filename(a, path.c_str()) != ARCHIVE_OK) {
+    archive_write_free(a);
+    return false;
+  }
+
+  // Aim at ~2x the packed size unpacked, spread over the file count
+  uint64_t total = (uint64_t)(shape.packedMB * scale * 2 * 1024 * 1024);
+  uint64_t perFile = std::max<uint64_t>(256, total / shape.files);
+  std::string stem = fs::path(shape.name).stem().string();
+  std::vector<char> buf;
+  for (int i = 0; i < shape.files; ++i) {
+    std::string name = stem + "/" + std::to_string(i % 16) + "/file" +
+                       std::to_string(i) + ".bin";
+    // LibrariesQt5 ships Qt plugins that the installer relocates
+    if (stem == "LibrariesQt5" && i % 4 == 0)
+      name = "Qt5/plugins" + std::to_string(i % 3) + "/plugin" +
+             std::to_string(i) + ".dll";
+    buf.resize(perFile / 2 + rng() % perFile);
+    fillContent(buf, rng);
+
+    struct archive_entry *e = archive_entry_new();
+    archive_entry_set_pathname(e, name.c_str());
+    archive_entry_set_size(e, buf.size());
+    archive_entry_set_filetype(e, AE_IFREG);
+    archive_entry_set_perm(e, 0644);
+    archive_write_header(a, e);
+    archive_write_data(a, buf.data(), buf.size());
+    archive_entry_free(e);
+    unpacked += buf.size();
+  }
+  archive_write_close(a);
+  archive_write_free(a);
+  return true;
+}
+
+struct Generated {
+  uint64_t packedBytes = 0;
+  uint64_t unpackedBytes = 0;
+  uint64_t files = 0;
+};
+
+bool generateVersion(const fs::path &setupDir, double scale, Generated &out) {
+  fs::create_directories(setupDir);
+  std::mt19937_64 rng(0x5253'4a46); // fixed seed: identical runs
+  std::vector<rsjfw::RobloxPackage> packages;
+  for (const auto &shape : PROFILE) {
+    fs::path zip = setupDir / (VERSION_GUID + "-" + shape.name);
+    uint64_t unpacked = 0;
+    if (!writePackage(zip, shape, scale, rng, unpacked))
+      return false;
+    rsjfw::RobloxPackage pkg;
+    pkg.name = shape.name;
+    pkg.checksum = rsjfw::Md5::hashFile(zip.string());
+    pkg.size = unpacked;
+    pkg.packedSize = fs::file_size(zip);
+    packages.push_back(pkg);
+    out.packedBytes += pkg.packedSize;
+    out.unpackedBytes += unpacked;
+    out.files += shape.files;
+  }
+  std::ofstream(setupDir / (VERSION_GUID + "-rbxPkgManifest.txt"))
+      << rsjfw::RobloxAPI::formatPackageManifest(packages);
+  return true;
+}
+
+// --- Fake CDN ---------------------------------------------------------------
+
+bool sendAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+// One keep-alive connection: GET/HEAD with optional single byte range
+void serveConnection(int fd, const fs::path &docRoot, const Options &o) {
+  std::string pending;
+  std::vector<char> chunk(64 * 1024);
+  while (true) {
+    size_t end;
+    while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+      char buf[4096];
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        return;
+      pending.append(buf, n);
+    }
+    std::string head = pending.substr(0, end);
+    pending.erase(0, end + 4);
+
+    std::istringstream lines(head);
+    std::string method, target, line;
+    lines >> method >> target;
+    uint64_t rangeStart = 0, rangeEnd = UINT64_MAX;
+    bool ranged = false;
+    while (std::getline(lines, line)) {
+      if (strncasecmp(line.c_str(), "Range: bytes=", 13) == 0) {
+        ranged = true;
+        rangeStart = std::strtoull(line.c_str() + 13, nullptr, 10);
+        auto dash = line.find('-');
+        if (dash != std::string::npos && std::isdigit(line[dash + 1]))
+          rangeEnd = std::strtoull(line.c_str() + dash + 1, nullptr, 10);
+      }
+    }
+
+    if (o.latencyMs > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(o.latencyMs));
+
+    fs::path path = docRoot / fs::path(target).relative_path();
+    int file = target.find("..") == std::string::npos
+                   ? open(path.c_str(), O_RDONLY | O_CLOEXEC)
+                   : -1;
+    struct stat st{};
+    if (file < 0 || fstat(file, &st) != 0 || !S_ISREG(st.st_mode)) {
+      if (file >= 0)
+        close(file);
+      const char *nf =
+          "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      if (!sendAll(fd, nf, strlen(nf)))
+        return;
+      continue;
+    }
+
+    uint64_t size = st.st_size;
+    rangeEnd = std::min<uint64_t>(rangeEnd, size - 1);
+    if (!ranged || rangeStart > rangeEnd) {
+      ranged = false;
+      rangeStart = 0;
+      rangeEnd = size - 1;
+    }
+    uint64_t length = size ? rangeEnd - rangeStart + 1 : 0;
+    std::ostringstream hdr;
+    hdr << (ranged ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n")
+        << "Accept-Ranges: bytes\r\nContent-Length: " << length << "\r\n";
+    if (ranged)
+      hdr << "Content-Range: bytes " << rangeStart << "-" << rangeEnd << "/"
+          << size << "\r\n";
+    hdr << "\r\n";
+    std::string h = hdr.str();
+    bool ok = sendAll(fd, h.data(), h.size());
+
+    // Paced in 64 KiB chunks when a per-connection cap is set
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+    while (ok && method == "GET" && sent < length) {
+      size_t want = std::min<uint64_t>(chunk.size(), length - sent);
+      ssize_t n = pread(file, chunk.data(), want, rangeStart + sent);
+      ok = n > 0 && sendAll(fd, chunk.data(), n);
+      sent += n > 0 ? n : 0;
+      if (o.bandwidthKBps > 0) {
+        auto due = start + std::chrono::duration<double>(
+                               (double)sent / (o.bandwidthKBps * 1024.0));
+        std::this_thread::sleep_until(due);
+      }
+    }
+    close(file);
+    if (!ok)
+      return;
+  }
+}
+
+// Forks the server so its threads and syscalls stay out of the measurements
+pid_t startServer(const fs::path &docRoot, const Options &o, uint16_t &port) {
+  int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listenFd, 128) != 0 ||
+      getsockname(listenFd, (sockaddr *)&addr, &len) != 0)
+    return -1;
+  port = ntohs(addr.sin_port);
+
+  pid_t pid = fork();
+  if (pid != 0) {
+    close(listenFd);
+    return pid;
+  }
+  while (true) {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    std::thread([fd, docRoot, &o]() {
+      serveConnection(fd, docRoot, o);
+      close(fd);
+    }).detach();
+  }
+}
+
+// --- Measurement ------------------------------------------------------------
+
+// Read/write-family syscall counts of this process
+std::pair<uint64_t, uint64_t> syscallCounts() {
+  std::ifstream io("/proc/self/io");
+  std::string key;
+  uint64_t value, reads = 0, writes = 0;
+  while (io >> key >> value) {
+    if (key == "syscr:")
+      reads = value;
+    else if (key == "syscw:")
+      writes = value;
+  }
+  return {reads, writes};
+}
+
+// A field of /proc/self/status in KiB, -1 if missing
+long statusKiB(const std::string &field) {
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    long value;
+    if (key == field + ":" && status >> value)
+      return value;
+    status.ignore(4096, '\n');
+  }
+  return -1;
+}
+
+// Resets VmHWM to the current RSS so each run reports its own peak rather
+// than the process lifetime's (Linux 4.0+)
+bool resetPeakRss() {
+  std::ofstream clear("/proc/self/clear_refs");
+  return clear && (clear << "5").flush();
+}
+
+nlohmann::json measureRun(const fs::path &root) {
+  fs::remove_all(root / "versions");
+  fs::remove_all(root / "cache" / "packages");
+  fs::remove_all(root / "downloads");
+  fs::create_directories(root / "versions");
+  fs::create_directories(root / "cache" / "packages");
+  fs::create_directories(root / "downloads");
+
+  bool perRunPeak = resetPeakRss();
+  long rssStart = statusKiB("VmRSS");
+  rusage before{}, after{};
+  getrusage(RUSAGE_SELF, &before);
+  auto [reads0, writes0] = syscallCounts();
+  auto start = std::chrono::steady_clock::now();
+
+  rsjfw::Downloader downloader(root.string());
+  bool ok = downloader.installVersion(VERSION_GUID);
+
+  double wall = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  getrusage(RUSAGE_SELF, &after);
+  auto [reads1, writes1] = syscallCounts();
+  const auto &t = downloader.lastTimings();
+
+  auto cpu = [](const timeval &a, const timeval &b) {
+    return (b.tv_sec - a.tv_sec) + (b.tv_usec - a.tv_usec) / 1e6;
+  };
+  return {
+      {"ok", ok},
+      {"wall_s", wall},
+      {"phases_s",
+       {{"manifest", t.manifest},
+        {"download", t.download},
+        {"extract", t.extract},
+        {"qt_relocation", t.qtRelocation},
+        {"app_settings", t.appSettings}}},
+      {"bytes_downloaded", t.bytesDownloaded},
+      {"throughput_mib_s", t.bytesDownloaded / 1048576.0 / wall},
+      {"user_cpu_s", cpu(before.ru_utime, after.ru_utime)},
+      {"system_cpu_s", cpu(before.ru_stime, after.ru_stime)},
+      {"peak_rss_kib", perRunPeak ? statusKiB("VmHWM") : after.ru_maxrss},
+      // "process" when the kernel can't reset the peak between runs
+      {"peak_rss_scope", perRunPeak ? "run" : "process"},
+      {"start_rss_kib", rssStart},
+      {"syscalls", {{"read", reads1 - reads0}, {"write", writes1 - writes0}}},
+      {"context_switches",
+       {{"voluntary", after.ru_nvcsw - before.ru_nvcsw},
+        {"involuntary", after.ru_nivcsw - before.ru_nivcsw}}},
+  };
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options o;
+  if (!parseArgs(argc, argv, o)) {
+    usage();
+    return 2;
+  }
+
+  char tmpl[] = "/tmp/rsjfw-bench-XXXXXX";
+  if (!mkdtemp(tmpl)) {
+    std::cerr << "[RSJFW] Could not create a work directory\n";
+    return 1;
+  }
+  fs::path work = tmpl;
+  fs::path docRoot = work / "cdn";
+  fs::path root = work / "root";
+
+  std::cerr << "[RSJFW] Generating packages in " << docRoot << "...\n";
+  Generated gen;
+  if (!generateVersion(docRoot / "setup", o.scale, gen)) {
+    std::cerr << "[RSJFW] Failed to generate packages\n";
+    return 1;
+  }
+
+  uint16_t port = 0;
+  pid_t server = startServer(docRoot, o, port);
+  if (server < 0) {
+    std::cerr << "[RSJFW] Failed to start the fake CDN\n";
+    return 1;
+  }
+
+  rsjfw::PathManager::instance().init(root.string());
+  auto &installer = rsjfw::Config::instance().getInstaller();
+  installer.mirror = "http://127.0.0.1:" + std::to_string(port) + "/";
+  installer.maxTransfers = o.maxTransfers;
+  installer.streamExtract = o.stream;
+  installer.packageCacheMB = 0; // every run is a cold install
+  installer.deltaUpdates = false;
+  installer.lanSharing = false;
+  installer.launchBeforeComplete = false;
+
+  nlohmann::json report = {
+      {"config",
+       {{"scale", o.scale},
+        {"latency_ms", o.latencyMs},
+        {"bandwidth_kbps", o.bandwidthKBps},
+        {"max_transfers", o.maxTransfers},
+        {"stream_extract", o.stream}}},
+      {"version",
+       {{"packages", PROFILE.size()},
+        {"files", gen.files},
+        {"packed_bytes", gen.packedBytes},
+        {"unpacked_bytes", gen.unpackedBytes}}},
+      {"runs", nlohmann::json::array()}};
+
+  // The installer reports progress on stdout; keep that free for the JSON
+  std::streambuf *stdoutBuf = std::cout.rdbuf(std::cerr.rdbuf());
+  bool allOk = true;
+  for (int i = 0; i < o.runs; ++i) {
+    std::cerr << "[RSJFW] Run " << i + 1 << "/" << o.runs << "...\n";
+    auto run = measureRun(root);
+    allOk = allOk && run["ok"].get<bool>();
+    report["runs"].push_back(run);
+  }
+
+  // Log lines reach std::cout from the logger's thread
+  rsjfw::Logger::instance().flush();
+  std::cout.rdbuf(stdoutBuf);
+
+  kill(server, SIGKILL);
+  waitpid(server, nullptr, 0);
+  if (!o.keep)
+    fs::remove_all(work);
+
+  if (o.jsonPath.empty()) {
+    std::cout << report.dump(2) << "\n";
+  } else {
+    std::ofstream(o.jsonPath) << report.dump(2) << "\n";
+  }
+  return allOk ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#ifndef RSJFW_BINARY_LOG_HPP
+#define RSJFW_BINARY_LOG_HPP
+
+#include "rsjfw/logger.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace rsjfw {
+
+// Append-only structured log for the Studio/Wine output, which easily runs
+// to hundreds of MB with Wine debug channels on.
+//
+//   <name>.rlog      "RSJFWLG1", then records:
+//                      u32 size (whole record), u64 time (us since epoch),
+//                      u8 level, u8 source, u16 channel length,
+//                      channel bytes, message bytes
+//   <name>.rlog.idx  "RSJFWIX1", then one entry per block of records:
+//                      u64 offset, u32 bytes, u32 records, u64 first time,
+//                      u64 last time, u64 first record, u8 level mask
+//
+// The index is sparse (a block is up to 1024 records or 256 KiB) and only
+// ever trails the data, so readers can seek by time or skip blocks without
+// the wanted severities and scan just the unindexed tail. All integers are
+// little endian.
+enum class LogSource : uint8_t { Rsjfw, Wine, Studio };
+
+class BinaryLogWriter {
+public:
+  BinaryLogWriter() = default;
+  ~BinaryLogWriter();
+
+  // Starts a fresh log at `path` (and its index), replacing any old one.
+  // The log is flock()ed while open; if another writer still holds `path`
+  // this one goes to "<stem>-<pid>.rlog" next to it instead, see path().
+  bool open(const std::filesystem::path &path);
+  void close();
+  bool isOpen() const { return fd_ >= 0; }
+  const std::filesystem::path &path() const { return path_; }
+
+  // Thread-safe. Buffered; written within 100ms, also when output stops
+  void append(LogLevel level, LogSource source, std::string_view channel,
+              std::string_view message);
+  void flush();
+
+  BinaryLogWriter(const BinaryLogWriter &) = delete;
+  BinaryLogWriter &operator=(const BinaryLogWriter &) = delete;
+
+private:
+  void flushLocked();
+  void closeBlockLocked();
+
+  std::mutex mutex_;
+  std::condition_variable_any pending_;
+  std::jthread flusher_;
+  std::filesystem::path path_;
+  int fd_ = -1;
+  int idxFd_ = -1;
+  std::string buffer_;
+  uint64_t written_ = 0; // file size once buffer_ is out
+  uint64_t lastFlushUs_ = 0;
+
+  // Block being filled
+  uint64_t blockOffset_ = 0;
+  uint32_t blockBytes_ = 0;
+  uint32_t blockCount_ = 0;
+  uint64_t blockFirstTs_ = 0;
+  uint64_t blockLastTs_ = 0;
+  uint8_t blockMask_ = 0;
+  uint64_t records_ = 0;
+};
+
+class BinaryLogReader {
+public:
+  struct Record {
+    uint64_t offset = 0;
+    uint64_t timeUs = 0;
+    LogLevel level = LogLevel::INFO;
+    LogSource source = LogSource::Rsjfw;
+    std::string channel;
+    std::string message;
+  };
+
+  struct Block {
+    uint64_t offset = 0;
+    uint32_t bytes = 0;
+    uint32_t count = 0;
+    uint64_t firstTs = 0;
+    uint64_t lastTs = 0;
+    uint64_t firstRecord = 0;
+    uint8_t levelMask = 0;
+  };
+
+  BinaryLogReader() = default;
+  ~BinaryLogReader();
+
+  bool open(const std::filesystem::path &path);
+  void close();
+  // Picks up records appended since the last call; true if there were any
+  // or a new session replaced the log. Only the part past the on-disk index
+  // is scanned.
+  bool refresh();
+  // Bumped whenever refresh() finds a new session; offsets from an older
+  // session are meaningless
+  uint64_t session() const { return session_; }
+
+  const std::vector<Block> &blocks() const { return blocks_; }
+  uint64_t recordCount() const;
+  uint64_t firstTime() const { return blocks_.empty() ? 0 : blocks_.front().firstTs; }
+  uint64_t lastTime() const { return blocks_.empty() ? 0 : blocks_.back().lastTs; }
+
+  // Offset of the first block that can hold records at or after `timeUs`
+  uint64_t seekTime(uint64_t timeUs) const;
+  // Offset from which roughly the last `records` records follow
+  uint64_t seekTail(uint64_t records) const;
+
+  // Up to `max` records at or after `offset` whose level bit is in
+  // `levelMask`, skipping whole blocks without one. `next` receives the
+  // offset to continue from.
+  std::vector<Record> read(uint64_t offset, size_t max, uint8_t levelMask,
+                           uint64_t *next = nullptr) const;
+
+  static uint8_t levelBit(LogLevel level) {
+    return static_cast<uint8_t>(1u << static_cast<int>(level));
+  }
+  static uint8_t maskAtLeast(LogLevel level);
+
+  // "[2024-01-01 12:00:00.123] [WARN] [wine:d3d] message"
+  static std::string format(const Record &record);
+  // Writes the log as plain text; with `follow` keeps printing new records
+  // until the stream fails
+  static bool toText(const std::filesystem::path &path, std::ostream &out,
+                     LogLevel minLevel = LogLevel::DEBUG, bool follow = false);
+
+  BinaryLogReader(const BinaryLogReader &) = delete;
+  BinaryLogReader &operator=(const BinaryLogReader &) = delete;
+
+private:
+  void loadIndex(uint64_t fileSize);
+  void scan(uint64_t from, uint64_t to);
+
+  bool reopenIfReplaced();
+
+  std::filesystem::path path_;
+  int fd_ = -1;
+  ino_t ino_ = 0;
+  std::string firstHeader_; // of the first record, identifies the session
+  uint64_t session_ = 0;
+  std::vector<Block> blocks_;
+  size_t indexedBlocks_ = 0; // blocks_ prefix backed by the .idx file
+  uint64_t indexedEnd_ = 0;
+  uint64_t idxRead_ = 0;     // bytes of the .idx file consumed
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_BINARY_LOG_HPP
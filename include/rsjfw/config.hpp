@@ -70,6 +70,46 @@ struct WineConfig {
   bool desktopMode = false;
   bool multipleDesktops = false;
   std::string desktopResolution = "1920x1080";
+  // Keep a persistent wineserver running per prefix between launches
+  bool persistentServer = false;
+};
+
+struct InstallerConfig {
+  // Pipe package downloads straight into the extractor instead of landing
+  // the zip in downloads/ first
+  bool streamExtract = true;
+  // Upper bound on concurrent transfers in the shared HTTP engine
+  int maxTransfers = 16;
+  // Size cap of the shared package store in MiB, 0 disables it
+  int packageCacheMB = 4096;
+  // Reflink or hard-link files identical to another installed version
+  bool dedupeVersions = true;
+  // Reuse unchanged packages from the installed version instead of
+  // downloading the whole manifest again
+  bool deltaUpdates = true;
+  // Extra attempts for a failed transfer, resumed with a Range request when
+  // the server supports it
+  int downloadRetries = 4;
+  // Parallel byte ranges for large single-file downloads (Wine, DXVK)
+  int downloadSegments = 4;
+  // Cap on total download rate in KiB/s so an install doesn't starve a
+  // running Studio session, 0 for unlimited
+  int bandwidthLimitKBps = 0;
+  // Return from an install once Studio can boot and fetch the remaining
+  // content packages in the background
+  bool launchBeforeComplete = false;
+  // Stage new Studio versions ahead of time (`rsjfw prefetch`, run by the
+  // systemd timer or the config window) and launch whatever `current` points
+  // at instead of checking for updates first
+  bool backgroundUpdates = false;
+  // Install from a mirror written by `rsjfw mirror sync` instead of the
+  // Roblox CDN and GitHub: a directory, file:// or http(s):// URL
+  std::string mirror = "";
+  // Serve the package store to other RSJFW hosts on the LAN and fetch
+  // packages from them before the CDN
+  bool lanSharing = false;
+  // TCP port for serving packages, 0 picks a free one
+  int lanPort = 0;
 };
 
 class Config {
@@ -82,6 +122,7 @@ public:
   // Getters
   GeneralConfig &getGeneral() { return general_; }
   WineConfig &getWine() { return wine_; }
+  InstallerConfig &getInstaller() { return installer_; }
 
   // FFlags are dynamic, just expose the map
   std::map<std::string, nlohmann::json> &getFFlags() { return fflags_; }
@@ -99,6 +140,7 @@ private:
   std::filesystem::path configPath_;
   GeneralConfig general_;
   WineConfig wine_;
+  InstallerConfig installer_;
   std::map<std::string, nlohmann::json> fflags_;
 
   std::recursive_mutex mutex_;
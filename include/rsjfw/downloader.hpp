@@ -3,7 +3,11 @@
 
 #include "rsjfw/config.hpp"
 #include "rsjfw/roblox_api.hpp"
+#include "rsjfw/version_index.hpp"
+#include "rsjfw/zip_util.hpp"
+#include <filesystem>
 #include <functional>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -18,8 +22,43 @@ public:
                          size_t itemIndex, size_t totalItems)>;
   bool installLatest(ProgressCallback callback = nullptr);
   bool isVersionInstalled(const std::string &versionGUID);
+  // True once the boot-critical packages are in place, even while content
+  // packages are still being fetched in the background
+  bool isVersionLaunchable(const std::string &versionGUID);
   bool installVersion(const std::string &versionGUID,
                       ProgressCallback callback = nullptr);
+  // Packages Studio may need while starting: all but a few known to be
+  // safe to defer. Scheduled ahead of the rest.
+  static bool isCriticalPackage(const std::string &packageName);
+  // Download rank of the packages Studio reads first while booting; every
+  // other package shares the last rank
+  static size_t bootPriority(const std::string &packageName);
+  // Manifest names held back in launch-before-complete mode
+  static const std::set<std::string> &deferrablePackages();
+  // True for manifest names with a known install location
+  static bool isKnownPackage(const std::string &packageName);
+
+  // Where the last installVersion spent its time, in seconds. Download and
+  // extract are summed over workers; streamed packages count as download.
+  struct PhaseTimings {
+    double manifest = 0;
+    double download = 0;
+    double extract = 0;
+    double qtRelocation = 0;
+    double appSettings = 0;
+    uint64_t bytesDownloaded = 0;
+  };
+  const PhaseTimings &lastTimings() const { return timings_; }
+
+  // Installs the latest version at idle CPU/I/O priority and points
+  // versions/current at it once complete
+  bool prefetchLatest();
+  // Version versions/current points at, or "" if it is missing or not
+  // launchable
+  std::string getCurrentVersion();
+  // Stops background installs after their in-flight packages; they resume
+  // on the next run
+  static void cancelBackground();
 
   // v2.1: Unified GitHub API support
   struct GitHubAsset {
@@ -45,6 +84,15 @@ public:
 
   // GitHub API interactions
   std::vector<GitHubRelease> fetchReleases(const std::string &repo);
+  // Finds the release for `version` ("latest" or a tag) and the asset
+  // installWine/installDxvk would install: assetName if set, else the first
+  // archive matching `preferences` in order
+  bool resolveRelease(const std::string &repo, const std::string &version,
+                      const std::string &assetName,
+                      const std::vector<std::string> &preferences,
+                      GitHubRelease &release, GitHubAsset &asset);
+  static const std::vector<std::string> WINE_ARCHIVES;
+  static const std::vector<std::string> DXVK_ARCHIVES;
   bool validateRepo(const std::string &repo, std::string &outError);
 
   // Management
@@ -65,16 +113,59 @@ public:
 
   std::string getLatestVersionGUID();
   std::vector<std::string> getInstalledVersions();
+  // Re-hashes every indexed file of an installed version. Returns the number
+  // of missing or modified files, or -1 if the version has no index.
+  int verifyVersion(const std::string &versionGUID);
 
 private:
   std::string rootDir_;
   std::string versionsDir_;
   std::string downloadsDir_;
+  // Set for prefetch runs: everything is installed at background priority
+  bool background_ = false;
+  PhaseTimings timings_;
 
   std::string downloadLatestRobloxStudio(const std::string &versionGUID);
 
+  // Runs the download/extract workers over packages[order], writing a
+  // marker per finished package. Background runs use idle I/O priority.
+  bool installPackages(const std::string &versionGUID,
+                       const std::string &installDir,
+                       const std::vector<RobloxPackage> &packages,
+                       const std::vector<size_t> &order, VersionIndex &index,
+                       ProgressCallback callback, bool background);
+  // Atomically repoints versions/current at versionGUID
+  bool setCurrentVersion(const std::string &versionGUID);
+  // Qt relocation, dedupe, index and AppSettings.xml once packages are in
+  void finalizeVersion(const std::string &installDir, VersionIndex &index);
+
+  // Where a package zip lives on disk: the shared store, or downloads/ when
+  // the store is disabled
+  std::string packageFile(const RobloxPackage &pkg) const;
   bool downloadPackage(const std::string &versionGUID, const RobloxPackage &pkg,
                        std::function<void(size_t, size_t)> progressCb);
+  // Downloads and extracts a package in one pass without touching downloads/.
+  // On failure, including a checksum mismatch, the files it wrote are removed.
+  bool streamPackage(const std::string &versionGUID, const RobloxPackage &pkg,
+                     const std::string &destDir,
+                     std::function<void(size_t, size_t)> progressCb,
+                     const ZipUtil::FileCallback &onFile = nullptr);
+  // Clones packages whose checksum matches the newest installed version into
+  // installDir and returns their indices in `packages`
+  std::set<size_t>
+  reuseUnchangedPackages(const std::string &installDir,
+                         const std::vector<RobloxPackage> &packages,
+                         VersionIndex &index);
+  // Replaces files of a fresh install with reflinks/hard links to identical
+  // files in other installed versions
+  void dedupeVersion(const std::string &installDir, const VersionIndex &index);
+  // Streams a Wine/DXVK release archive into a staging directory under
+  // parentDir and renames its top-level directory into place. Returns the
+  // installed root, or "" if isRoot rejects the extracted tree.
+  std::string
+  installArchive(const std::string &url, const std::filesystem::path &parentDir,
+                 const std::function<bool(const std::filesystem::path &)> &isRoot,
+                 ProgressCallback callback);
   std::string extractArchive(const std::string &archivePath,
                              const std::string &destDir,
                              ProgressCallback callback);
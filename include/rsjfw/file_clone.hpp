@@ -0,0 +1,28 @@
+#ifndef RSJFW_FILE_CLONE_HPP
+#define RSJFW_FILE_CLONE_HPP
+
+#include <filesystem>
+
+namespace rsjfw {
+
+class FileClone {
+public:
+  enum class Method { None, Reflink, Hardlink, Copy };
+
+  // Materializes `src` at `dst` sharing storage where the filesystem allows:
+  // a copy-on-write reflink (FICLONE on btrfs/xfs), else a hard link, else a
+  // plain copy when allowCopy is set. Without allowHardlink `dst` never
+  // shares an inode with `src`, for files that get written in place. An
+  // existing `dst` is replaced atomically. Returns the method that succeeded.
+  static Method clone(const std::filesystem::path &src,
+                      const std::filesystem::path &dst, bool allowCopy = true,
+                      bool allowHardlink = true);
+
+  // True if both paths already share the same inode
+  static bool sameFile(const std::filesystem::path &a,
+                       const std::filesystem::path &b);
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_FILE_CLONE_HPP
@@ -1,22 +1,42 @@
 #ifndef RSJFW_HTTP_HPP
 #define RSJFW_HTTP_HPP
 
+#include "rsjfw/stream.hpp"
+#include <chrono>
 #include <string>
 #include <curl/curl.h>
 #include <functional>
 
 namespace rsjfw {
 
+// Convenience wrappers over HttpEngine. Every call shares the engine's
+// connection pool, so repeated requests to the same host skip the handshake.
 class HTTP {
 public:
     using ProgressCallback = std::function<void(size_t current, size_t total)>;
-    static std::string get(const std::string& url);
-    static bool download(const std::string& url, const std::string& filepath, ProgressCallback callback = nullptr);
 
-private:
-    static size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* userp);
-    static size_t fileWriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
-    static int progressCallback(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+    static std::string get(const std::string& url);
+    // get() backed by an on-disk cache under cache/http. Entries younger
+    // than maxAge are returned without touching the network, older ones are
+    // revalidated with If-None-Match/If-Modified-Since. A cached copy is
+    // also served when the server is unreachable or rate limits us.
+    static std::string getCached(const std::string& url, std::chrono::seconds maxAge = std::chrono::seconds(0));
+    // Failed transfers are retried with backoff and resumed from
+    // `<filepath>.part` when the server validates the range (ETag or
+    // Last-Modified). With expectedMd5 set, the body is hashed as it is
+    // written and a mismatch fails the download instead of landing at
+    // `filepath`. Without retry there is exactly one attempt.
+    static bool download(const std::string& url, const std::string& filepath, ProgressCallback callback = nullptr,
+                         const std::string& expectedMd5 = "", bool retry = true);
+    // Splits a large file into `segments` byte ranges fetched over separate
+    // connections into a preallocated .part file. Falls back to download()
+    // when the server doesn't advertise range support.
+    static bool downloadSegmented(const std::string& url, const std::string& filepath, int segments,
+                                  ProgressCallback callback = nullptr);
+    // Hands the body to `sink` as it arrives. A Full result pauses the
+    // transfer until the sink has room again. A dropped connection is
+    // resumed from the last delivered byte when the server allows it.
+    static bool stream(const std::string& url, ByteSink sink, ProgressCallback callback = nullptr);
 };
 
 } // namespace rsjfw
@@ -0,0 +1,152 @@
+#ifndef RSJFW_HTTP_ENGINE_HPP
+#define RSJFW_HTTP_ENGINE_HPP
+
+#include "rsjfw/stream.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <curl/curl.h>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rsjfw {
+
+// Single curl_multi event loop shared by every transfer in the process.
+// Connections, DNS results and TLS sessions are reused across requests and
+// HTTP/2 streams are multiplexed over one connection per host.
+class HttpEngine {
+public:
+  // Limits shared by one set of transfers, such as the packages of one
+  // install, so they never throttle unrelated requests. Transfers outside a
+  // group are only bound by the engine-wide cap.
+  class Group {
+  public:
+    // Background groups have their bytes written at idle I/O priority
+    explicit Group(bool background = false) : background_(background) {}
+
+    // Transfers of this group attached at once, 0 for no cap of its own
+    void setMaxInFlight(size_t limit);
+    // Download rate cap in bytes per second over the whole group, 0 for
+    // unlimited
+    void setBandwidthLimit(uint64_t bytesPerSecond);
+
+  private:
+    friend class HttpEngine;
+    bool takeTokens(size_t bytes);
+
+    const bool background_;
+    std::atomic<size_t> maxInFlight_{0};
+    std::atomic<uint64_t> bandwidthLimit_{0};
+    // Only touched on the engine thread
+    size_t active_ = 0;
+    double tokens_ = 0;
+    std::chrono::steady_clock::time_point lastRefill_;
+  };
+
+  // Requests submitted from this thread without a group join `group` for
+  // as long as the scope lives
+  class GroupScope {
+  public:
+    explicit GroupScope(std::shared_ptr<Group> group);
+    ~GroupScope();
+    GroupScope(const GroupScope &) = delete;
+    GroupScope &operator=(const GroupScope &) = delete;
+
+  private:
+    std::shared_ptr<Group> previous_;
+  };
+  // The group of the innermost GroupScope on this thread, if any
+  static std::shared_ptr<Group> currentGroup();
+
+  struct Request {
+    std::string url;
+    std::vector<std::string> headers;
+    bool noBody = false;      // HEAD-style request
+    bool failOnError = true;  // Treat HTTP >= 400 as a failed transfer
+    std::string range;        // "start-end" byte range, empty for everything
+    bool ownConnection = false; // HTTP/1.1 on a connection of its own
+    long connectTimeoutMs = 0;  // 0 keeps curl's default
+    ByteSink sink;            // Body consumer, nullptr discards the body
+    std::function<void(size_t current, size_t total)> progress;
+    std::function<void(const std::string &line)> header;
+    std::shared_ptr<Group> group; // Defaults to currentGroup()
+  };
+
+  struct Response {
+    bool ok = false;
+    CURLcode code = CURLE_OK;
+    long status = 0;
+    curl_off_t contentLength = -1;
+    std::string error;
+  };
+
+  static HttpEngine &instance();
+
+  std::future<Response> submit(Request req);
+  Response perform(Request req) { return submit(std::move(req)).get(); }
+
+  // Caps the number of transfers attached to the multi handle at once
+  void setMaxInFlight(size_t limit);
+
+  HttpEngine(const HttpEngine &) = delete;
+  HttpEngine &operator=(const HttpEngine &) = delete;
+
+private:
+  HttpEngine();
+  ~HttpEngine();
+
+  struct Transfer {
+    HttpEngine *engine = nullptr;
+    Request req;
+    std::promise<Response> promise;
+    CURL *easy = nullptr;
+    curl_slist *headerList = nullptr;
+    bool paused = false;
+    bool aborted = false;
+    char errorBuf[CURL_ERROR_SIZE] = {0};
+  };
+
+  void run(std::stop_token stop);
+  void attachPending();
+  void resumePaused();
+  void finish(CURL *easy, CURLcode code);
+  void wake();
+  void setIoIdle(bool idle);
+  CURL *createHandle(Transfer &t);
+
+  static size_t writeCallback(char *data, size_t size, size_t nmemb,
+                              void *userp);
+  static size_t headerCallback(char *data, size_t size, size_t nmemb,
+                               void *userp);
+  static int progressCallback(void *clientp, curl_off_t dltotal,
+                              curl_off_t dlnow, curl_off_t ultotal,
+                              curl_off_t ulnow);
+  static void lockShare(CURL *, curl_lock_data data, curl_lock_access,
+                        void *userp);
+  static void unlockShare(CURL *, curl_lock_data data, void *userp);
+
+  CURLM *multi_ = nullptr;
+  CURLSH *share_ = nullptr;
+  std::mutex shareLocks_[CURL_LOCK_DATA_LAST];
+
+  std::mutex mutex_;
+  std::deque<std::unique_ptr<Transfer>> pending_;
+  std::unordered_map<CURL *, std::unique_ptr<Transfer>> active_;
+  size_t maxInFlight_ = 16;
+
+  // I/O class the engine thread is running at; switched per sink call
+  bool ioIdle_ = false;
+
+  std::jthread worker_;
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_HTTP_ENGINE_HPP
@@ -0,0 +1,84 @@
+#ifndef RSJFW_LAN_PEERS_HPP
+#define RSJFW_LAN_PEERS_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rsjfw {
+
+// Opt-in sharing of the package store between RSJFW hosts on one LAN.
+// Every instance serves `GET /pkg/<checksum>` from its PackageCache over
+// plain HTTP and announces its port on a UDP multicast group; installs ask
+// the peers they have heard from before going to the CDN.
+class LanPeers {
+public:
+  using ProgressCallback = std::function<void(size_t current, size_t total)>;
+
+  static LanPeers &instance();
+
+  // Starts the package server and the announce listener. A no-op unless
+  // installer.lan_sharing is set; safe to call repeatedly.
+  bool start();
+  void stop();
+  bool running() const;
+  uint16_t port() const { return port_; }
+
+  // Base URLs of peers heard from recently. With none known, queries the
+  // group (at most every 30s; start() sends the first query) and waits
+  // until `wait` after the last query for an answer.
+  std::vector<std::string>
+  peers(std::chrono::milliseconds wait = std::chrono::milliseconds(250));
+
+  // Downloads a package zip from the first peer that has it, verified
+  // against `checksum`
+  bool fetch(const std::string &checksum, const std::string &destPath,
+             ProgressCallback progressCb);
+
+  LanPeers(const LanPeers &) = delete;
+  LanPeers &operator=(const LanPeers &) = delete;
+
+private:
+  LanPeers() = default;
+  ~LanPeers();
+
+  void serve(std::stop_token stop);
+  void work(std::stop_token stop);
+  void handleClient(int fd);
+  void listen(std::stop_token stop);
+  void send(const std::string &message);
+  void forget(const std::string &peer);
+
+  int httpFd_ = -1;
+  int udpFd_ = -1;
+  uint16_t port_ = 0;
+  std::string id_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable peerCv_;
+  std::map<std::string, std::chrono::steady_clock::time_point> peers_;
+  std::chrono::steady_clock::time_point lastQuery_{};
+
+  // Accepted connections wait here for one of a few workers; beyond the
+  // backlog they are turned away
+  std::mutex clientMutex_;
+  std::condition_variable_any clientCv_;
+  std::deque<int> queued_;
+  std::set<int> serving_;
+
+  std::jthread server_;
+  std::jthread listener_;
+  std::vector<std::jthread> workers_;
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_LAN_PEERS_HPP
@@ -47,6 +47,11 @@ private:
   // Configures environment variables for the prefix (Proton logic etc)
   void configureEnvironment(rsjfw::wine::Prefix &pfx, bool isProton);
 
+  // Prefix template for the configured Wine build and DXVK
+  std::string templateKey(const rsjfw::wine::Prefix &pfx, bool isProton);
+  // Snapshots a freshly set-up prefix that Studio has not run in yet
+  void captureTemplate();
+
 public:
   void setDebug(bool debug) { debug_ = debug; }
 
@@ -8,6 +8,11 @@
 #include <mutex>
 #include <chrono>
 #include <iomanip>
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <thread>
 
 namespace rsjfw {
 
@@ -18,34 +23,96 @@ enum class LogLevel {
     ERROR
 };
 
+// What log() does when the queue is full. Warnings and errors always wait
+// for room; the policy only applies to DEBUG and INFO.
+enum class OverflowPolicy {
+    Drop,  // never stall the caller (e.g. a chatty Wine process); count it
+    Block  // wait for the writer thread
+};
+
+// Asynchronous logger: callers push into a bounded lock-free MPSC ring and a
+// writer thread formats batches, writev()s them to the log file and hands
+// console lines to std::cout/std::cerr. Errors wait until they are on disk.
 class Logger {
 public:
     static Logger& instance();
 
     void init(const std::filesystem::path& logPath, bool verbose);
     void log(LogLevel level, const std::string& message);
+    void log(LogLevel level, std::string&& message);
+
+    // Cheap check the LOG_* macros make before building the message
+    bool wants(LogLevel level) const {
+        return static_cast<int>(level) >= minLevel_.load(std::memory_order_relaxed);
+    }
+    void setLevel(LogLevel level) { minLevel_ = static_cast<int>(level); }
+    void setOverflowPolicy(OverflowPolicy policy) { policy_ = policy; }
+
+    // Blocks until everything logged so far has been written
+    void flush();
 
     // Forbidden
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
 private:
-    Logger() = default;
+    Logger();
     ~Logger();
 
-    std::ofstream logFile_;
-    bool verbose_ = false;
-    std::mutex mutex_;
+    struct Record {
+        LogLevel level = LogLevel::INFO;
+        std::time_t time = 0;
+        std::string message;
+    };
+    struct Slot {
+        std::atomic<size_t> seq{0};
+        Record record;
+    };
+
+    static constexpr size_t kCapacity = 8192;
+
+    bool push(Record&& record, bool block);
+    void writerLoop();
+    size_t drain();
+    void writeBatch(Record* records, size_t count);
+
+    std::unique_ptr<Slot[]> ring_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    std::atomic<size_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::atomic<int> logFd_{-1};
+    std::atomic<bool> verbose_{false};
+    std::atomic<int> minLevel_{static_cast<int>(LogLevel::DEBUG)};
+    std::atomic<OverflowPolicy> policy_{OverflowPolicy::Drop};
+
+    std::atomic<bool> writerIdle_{false};
+    std::atomic<bool> stopping_{false};
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable writtenCv_;
+    std::thread writer_;
+
+    // Writer-thread only: "YYYY-mm-dd HH:MM:SS" for cachedSecond_
+    std::time_t cachedSecond_ = -1;
+    std::string cachedStamp_;
 
     std::string getTimestamp();
     std::string getLevelString(LogLevel level);
 };
 
-// Convenience macros
-#define LOG_DEBUG(msg) rsjfw::Logger::instance().log(rsjfw::LogLevel::DEBUG, msg)
-#define LOG_INFO(msg) rsjfw::Logger::instance().log(rsjfw::LogLevel::INFO, msg)
-#define LOG_WARN(msg) rsjfw::Logger::instance().log(rsjfw::LogLevel::WARNING, msg)
-#define LOG_ERROR(msg) rsjfw::Logger::instance().log(rsjfw::LogLevel::ERROR, msg)
+// Convenience macros; the message is only built when the level is wanted
+#define RSJFW_LOG_AT(level, msg)                                  \
+    do {                                                          \
+        if (rsjfw::Logger::instance().wants(level))               \
+            rsjfw::Logger::instance().log(level, msg);            \
+    } while (0)
+
+#define LOG_DEBUG(msg) RSJFW_LOG_AT(rsjfw::LogLevel::DEBUG, msg)
+#define LOG_INFO(msg) RSJFW_LOG_AT(rsjfw::LogLevel::INFO, msg)
+#define LOG_WARN(msg) RSJFW_LOG_AT(rsjfw::LogLevel::WARNING, msg)
+#define LOG_ERROR(msg) RSJFW_LOG_AT(rsjfw::LogLevel::ERROR, msg)
 
 } // namespace rsjfw
 
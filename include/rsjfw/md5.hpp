@@ -0,0 +1,46 @@
+#ifndef RSJFW_MD5_HPP
+#define RSJFW_MD5_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rsjfw {
+
+// Incremental MD5, matching the checksums in rbxPkgManifest.txt
+class Md5 {
+public:
+  using Digest = std::array<uint8_t, 16>;
+
+  Md5();
+  void update(const void *data, size_t len);
+  Digest finish();
+  std::string hexdigest();
+
+  static std::string toHex(const Digest &digest);
+  // Case-insensitive comparison of hex digests
+  static bool sameHex(const std::string &a, const std::string &b);
+
+  // Digests independent buffers four at a time, one per SSE2 lane, where the
+  // target supports it. Buffers of similar length keep the lanes busy.
+  static std::vector<Digest>
+  digestMany(const std::vector<std::string_view> &inputs);
+
+  // Hex digest of a whole file, empty if it can't be read
+  static std::string hashFile(const std::string &path);
+
+private:
+  void transform(const uint8_t block[64]);
+
+  uint32_t state_[4];
+  uint64_t length_ = 0;
+  uint8_t buffer_[64];
+  size_t buffered_ = 0;
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_MD5_HPP
@@ -0,0 +1,46 @@
+#ifndef RSJFW_MIRROR_HPP
+#define RSJFW_MIRROR_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace rsjfw {
+
+// Portable copy of everything an install needs, for machines without
+// internet access. Served from a directory, file:// or a LAN HTTP server:
+//
+//   index.json                              what the mirror holds
+//   clientsettings/<channel>.json           {"clientVersionUpload": guid}
+//   setup/<guid>-rbxPkgManifest.txt         same names as setup.rbxcdn.com
+//   setup/<guid>-<package>
+//   github/<owner>/<repo>/releases.json     GitHub API subset, relative URLs
+//   github/<owner>/<repo>/download/<tag>/<asset>
+class Mirror {
+public:
+  // A Wine or DXVK release to carry in the mirror
+  struct ReleaseSource {
+    std::string repo;
+    std::string version = "latest";
+    std::string asset; // empty = whatever the installer would pick
+    bool isWine = true;
+  };
+
+  // True when installer.mirror is set
+  static bool enabled();
+  // Configured mirror as a URL with a trailing slash; plain paths become
+  // file:// URLs
+  static std::string base();
+  static std::string url(const std::string &relative);
+
+  // Fetches a Studio version (latest for the configured channel when
+  // versionGUID is empty) and the given releases into `dir`, skipping files
+  // that are already present and intact
+  static bool sync(const std::filesystem::path &dir,
+                   const std::string &versionGUID,
+                   const std::vector<ReleaseSource> &releases);
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_MIRROR_HPP
@@ -0,0 +1,54 @@
+#ifndef RSJFW_PACKAGE_CACHE_HPP
+#define RSJFW_PACKAGE_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+namespace rsjfw {
+
+// Content-addressed store of Roblox package zips keyed by the manifest
+// checksum. Entries are shared by every Studio version that references the
+// same checksum and evicted least-recently-used first once the store grows
+// past its size cap.
+class PackageCache {
+public:
+  static PackageCache &instance();
+
+  // A cap of 0 disables the cache entirely
+  bool enabled() const;
+
+  // Returns the cached zip for `checksum` and marks it as recently used, or
+  // an empty path on a miss
+  std::filesystem::path lookup(const std::string &checksum);
+
+  // Creates a staging file for a new entry and returns its descriptor, or
+  // -1. Each writer gets its own `<checksum>.<pid>.<n>.stream`, opened with
+  // O_EXCL, so it never touches the resumable `<checksum>.part` of a
+  // download or another installer's staging file.
+  int openStaging(const std::string &checksum, std::filesystem::path &path);
+  bool commit(const std::string &checksum,
+              const std::filesystem::path &staging);
+  void discard(const std::filesystem::path &staging);
+
+  // Evicts least recently used entries until the store fits its cap
+  void trim();
+  uint64_t totalBytes() const;
+
+  PackageCache(const PackageCache &) = delete;
+  PackageCache &operator=(const PackageCache &) = delete;
+
+private:
+  PackageCache() = default;
+
+  std::filesystem::path dir() const;
+  std::filesystem::path entryPath(const std::string &checksum) const;
+  uint64_t capBytes() const;
+
+  mutable std::mutex mutex_;
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_PACKAGE_CACHE_HPP
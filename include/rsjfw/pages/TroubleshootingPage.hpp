@@ -3,6 +3,7 @@
 
 #include "rsjfw/page.hpp"
 #include "rsjfw/diagnostics.hpp"
+#include "rsjfw/binary_log.hpp"
 #include "imgui.h"
 
 namespace rsjfw {
@@ -35,6 +36,23 @@ private:
     std::vector<std::string> logFiles_;
     int selectedLog_ = 0;
     void refreshLogList();
+
+    // Log viewer. Text logs are read incrementally; structured (.rlog) logs
+    // show a window of records around a seek point.
+    std::string loadedLog_;
+    bool structuredLog_ = false;
+    BinaryLogReader logReader_;
+    uint64_t logTextSize_ = 0;
+    std::string logPartial_;
+    uint64_t logWindowStart_ = 0;
+    uint8_t logMask_ = 0;
+    std::vector<std::string> logLines_;
+    std::vector<LogLevel> logLevels_;
+    std::vector<int> logVisible_;
+    void openLog(const std::string& path);
+    void readTextLog();
+    void loadLogWindow(uint64_t offset);
+    void filterLog(uint8_t mask);
 };
 
 } // namespace rsjfw
@@ -21,6 +21,9 @@ public:
     std::filesystem::path downloads() const { return downloadsDir_; }
     std::filesystem::path wine() const { return wineDir_; }
     std::filesystem::path dxvk() const { return dxvkDir_; }
+    std::filesystem::path packageCache() const { return packageCacheDir_; }
+    std::filesystem::path httpCache() const { return httpCacheDir_; }
+    std::filesystem::path prefixTemplates() const { return prefixTemplatesDir_; }
     
     // Returns the path where the Vulkan layer .so should be found
     std::filesystem::path layerLib() const;
@@ -48,6 +51,9 @@ private:
     std::filesystem::path downloadsDir_;
     std::filesystem::path wineDir_;
     std::filesystem::path dxvkDir_;
+    std::filesystem::path packageCacheDir_;
+    std::filesystem::path httpCacheDir_;
+    std::filesystem::path prefixTemplatesDir_;
     std::filesystem::path currentLogPath_;
     std::filesystem::path inboxDir_;
     std::filesystem::path lockFilePath_;
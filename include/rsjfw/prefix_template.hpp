@@ -0,0 +1,48 @@
+#ifndef RSJFW_PREFIX_TEMPLATE_HPP
+#define RSJFW_PREFIX_TEMPLATE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+namespace rsjfw {
+
+namespace wine {
+class Prefix;
+}
+
+// Snapshots of a fully set-up prefix, keyed by the Wine build and DXVK in
+// use. A new prefix is cloned from one with reflinks, or hard links where
+// the filesystem has none, instead of being booted and configured again.
+// Only PE images are ever hard-linked, read-only; every other file gets a
+// private copy so a clone never writes through into its template.
+class PrefixTemplate {
+public:
+  // Identifies the Wine build (by its wineserver binary), the prefix flavour
+  // and `dxvk`, a description of the DXVK setup ("" when disabled)
+  static std::string key(const wine::Prefix &pfx, bool proton,
+                         const std::string &dxvk);
+  static std::filesystem::path dir(const std::string &key);
+  static bool exists(const std::string &key);
+
+  // Snapshots a set-up prefix. Needs the prefix's wineserver stopped so the
+  // hives on disk are current. Cheap: gives up rather than copy PE images
+  // it cannot link.
+  static bool capture(const wine::Prefix &pfx, const std::string &key);
+  // Deletes all but `keep` and the most recently used templates, `max` in
+  // all, and what interrupted captures left behind
+  static void prune(const std::string &keep, size_t max = 2);
+  // Clones the template into `prefixDir`, which must not hold a prefix yet
+  static bool instantiate(const std::string &key,
+                          const std::filesystem::path &prefixDir);
+
+  // Template a prefix was cloned from and still shares files with, or ""
+  static std::string clonedFrom(const std::filesystem::path &prefixDir);
+  // Gives a cloned prefix private copies of every shared file, before a
+  // different Wine build updates them in place
+  static bool detach(const std::filesystem::path &prefixDir);
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_PREFIX_TEMPLATE_HPP
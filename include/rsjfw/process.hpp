@@ -14,19 +14,31 @@ struct ProcessInfo {
     std::string winePrefix;
 };
 
+// Scans /proc with getdents64 and pread. A process's WINEPREFIX is cached
+// per PID until its start time or exe changes, so repeated scans mostly cost
+// one readlink and one stat read per process; each distinct prefix is
+// stat()ed once per scan.
 class Process {
 public:
-    // Finds all processes matching the name
+    // Finds all processes whose exe path contains the name
     static std::vector<ProcessInfo> findByName(const std::string& name);
     
     // Finds all Roblox Studio processes in a specific prefix
     static std::vector<ProcessInfo> findStudioInPrefix(const std::string& prefixDir);
+
+    // Roblox Studio processes in any prefix
+    static std::vector<int> findStudio();
+
+    // Whether pid is a Roblox Studio process. Under Wine /proc/<pid>/exe is
+    // the preloader, so this goes by the process name Wine sets.
+    static bool isStudio(int pid);
     
     // Forcefully kills a process
     static bool kill(int pid, bool force = true);
     
-    // Kills all processes in a prefix
-    static bool killAllInPrefix(const std::string& prefixDir);
+    // Kills the Studio processes in a prefix; the wineserver and Wine's own
+    // services stay up
+    static bool killStudioInPrefix(const std::string& prefixDir);
 
 private:
     static std::optional<std::string> getProcessPrefix(int pid);
@@ -0,0 +1,73 @@
+#ifndef RSJFW_PROCESS_SUPERVISOR_HPP
+#define RSJFW_PROCESS_SUPERVISOR_HPP
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsjfw {
+
+// Tracks the Wine processes RSJFW starts and reports the Studio processes
+// among them to State. Exits arrive as pidfd events on an epoll loop, so
+// nothing polls for them; descendants are found by walking
+// /proc/<pid>/task/*/children of the tracked tree only. Kernels without
+// pidfd_open fall back to checking the tracked PIDs on each walk.
+class ProcessSupervisor {
+public:
+  static ProcessSupervisor &instance();
+
+  // Tracks a process and its descendants. With `reap` the supervisor
+  // collects the exit status of this (child) process; otherwise whoever
+  // started it waits for it and the status is only peeked at.
+  void watch(int pid, bool reap);
+
+  // Picks up Studio processes started elsewhere (another RSJFW, a
+  // protocol launch); one scan of /proc
+  void adoptRunning();
+
+  // Tells a following supervisor, in whichever RSJFW process, about a
+  // launch: writes the PID to a file in the RSJFW root
+  static void announceLaunch(int pid);
+  // Tracks every announced launch from now on (inotify on that file), so
+  // the GUI sees protocol launches without scanning /proc
+  void followLaunches();
+
+  ProcessSupervisor(const ProcessSupervisor &) = delete;
+  ProcessSupervisor &operator=(const ProcessSupervisor &) = delete;
+
+private:
+  ProcessSupervisor() = default;
+  ~ProcessSupervisor();
+
+  struct Tracked {
+    int pidfd = -1;
+    bool reap = false;
+    bool studio = false;
+  };
+
+  void start();
+  void loop();
+  void track(int pid, bool reap);
+  void discover();
+  void exited(int pid);
+  void wake();
+  void readAnnouncements();
+
+  std::mutex mutex_;
+  std::map<int, Tracked> tracked_;
+  std::vector<std::pair<int, bool>> pending_; // watch() calls for the loop
+
+  int epollFd_ = -1;
+  int wakeFd_ = -1;
+  int inotifyFd_ = -1;
+  bool stopping_ = false;
+  bool pidfdSupported_ = true;
+  std::chrono::steady_clock::time_point lastWatch_;
+  std::thread thread_;
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_PROCESS_SUPERVISOR_HPP
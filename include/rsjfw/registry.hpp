@@ -1,13 +1,80 @@
 #ifndef RSJFW_REGISTRY_HPP
 #define RSJFW_REGISTRY_HPP
 
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "rsjfw/wine.hpp"
 
 namespace rsjfw {
 
+// In-process reader/writer for Wine's text hives (user.reg, system.reg).
+// Keys are found through a case-insensitive index of their paths; values we
+// do not touch keep their original text, so a rewrite only changes what was
+// set. Only safe while the prefix's wineserver is stopped, since a running
+// server owns the registry and rewrites the files from memory; writers go
+// through Prefix::withServerStopped() so none can start mid-rewrite.
+class RegistryHive {
+public:
+  enum Type : uint32_t {
+    SZ = 1,
+    EXPAND_SZ = 2,
+    BINARY = 3,
+    DWORD = 4,
+    MULTI_SZ = 7
+  };
+
+  struct Value {
+    std::string name; // empty = the key's default value (@)
+    uint32_t type = SZ;
+    std::string str;                 // SZ, EXPAND_SZ (UTF-8)
+    uint32_t dword = 0;              // DWORD
+    std::vector<unsigned char> data; // BINARY and other hex(N) types
+    std::string raw;                 // text after '=' as loaded
+  };
+
+  bool load(const std::filesystem::path &path);
+  // Writes to a temporary file and renames it over `path`
+  bool save(const std::filesystem::path &path) const;
+
+  bool hasKey(const std::string &key) const;
+  const Value *find(const std::string &key, const std::string &name) const;
+  // Creates the key if needed and stamps its modification time
+  void set(const std::string &key, Value value);
+
+  // Maps "HKEY_CURRENT_USER\..."/"HKCU\..." (and HKLM/HKCR) to the hive file
+  // holding it and the key path inside that file
+  static bool resolve(const std::string &fullKey, std::string &hiveFile,
+                      std::string &keyPath);
+  // Parsed hive, shared and cached until the file changes on disk
+  static std::shared_ptr<const RegistryHive>
+  open(const std::filesystem::path &file);
+  // Applies a batch to the hives of `prefixDir`, one atomic rewrite per hive.
+  // False, with nothing written, if any entry cannot be handled natively.
+  static bool apply(const std::filesystem::path &prefixDir,
+                    const std::vector<wine::Prefix::RegistryEntry> &entries);
+
+private:
+  struct Key {
+    std::string rawName; // escaped, as between the brackets
+    int64_t modified = 0;
+    std::vector<std::string> meta; // #time=, #class=, #link lines
+    std::vector<Value> values;
+    std::unordered_map<std::string, size_t> index;
+    bool dirty = false;
+  };
+
+  Key &keyFor(const std::string &path);
+
+  std::vector<std::string> preamble_;
+  std::vector<Key> keys_;
+  std::unordered_map<std::string, size_t> index_;
+};
+
 class Registry {
 public:
   Registry(rsjfw::wine::Prefix &pfx);
@@ -19,6 +86,8 @@ public:
   bool addBinary(const std::string &key, const std::string &valueName,
                  const std::vector<unsigned char> &data);
 
+  // Answered from the hive files while wineserver is stopped; only a
+  // running server costs a `wine reg query`
   bool exists(const std::string &key, const std::string &valueName);
 
   std::string readString(const std::string &key, const std::string &valueName);
@@ -26,6 +95,11 @@ public:
                                         const std::string &valueName);
 
 private:
+  // The value from disk; false when the files cannot answer
+  bool lookup(const std::string &key, const std::string &valueName,
+              const RegistryHive::Value *&value,
+              std::shared_ptr<const RegistryHive> &hive);
+
   rsjfw::wine::Prefix &pfx_;
 };
 
@@ -16,8 +16,17 @@ struct RobloxPackage {
 class RobloxAPI {
 public:
     static std::string getLatestVersionGUID(const std::string& channel = "LIVE");
+    // Channel name as clientsettings knows it ("production" is "LIVE")
+    static std::string normalizeChannel(const std::string& channel);
+    // Where version files come from: the configured mirror's setup/
+    // directory, or BASE_URL
     static std::vector<RobloxPackage> getPackageManifest(const std::string& versionGUID);
+    // rbxPkgManifest.txt format, also used for the copy kept with each install
+    static std::vector<RobloxPackage> parsePackageManifest(const std::string& text);
+    static std::string formatPackageManifest(const std::vector<RobloxPackage>& packages);
     
+    static std::string baseUrl();
+
     static const std::string BASE_URL;
 };
 
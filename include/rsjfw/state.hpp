@@ -25,7 +25,9 @@ enum class AppState {
 struct StudioInstance {
     int pid;
     std::string windowTitle;
-    long startTime;
+    long startTime;        // Unix time
+    bool running = true;
+    int exitCode = -1;     // Once exited; -1 if unknown, 128+n if killed by signal n
 };
 
 class State {
@@ -44,8 +46,10 @@ public:
     void setProgress(float progress);
     float getProgress() const;
     
-    // Multi-process tracking
-    void addStudioInstance(int pid);
+    // Multi-process tracking. startTime 0 means now.
+    void addStudioInstance(int pid, long startTime = 0);
+    // Keeps the instance (with its exit code) for display
+    void markStudioExited(int pid, int exitCode);
     void removeStudioInstance(int pid);
     std::vector<StudioInstance> getInstances() const;
     bool isStudioRunning() const;
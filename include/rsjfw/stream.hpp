@@ -0,0 +1,17 @@
+#ifndef RSJFW_STREAM_HPP
+#define RSJFW_STREAM_HPP
+
+#include <cstddef>
+#include <functional>
+
+namespace rsjfw {
+
+// Outcome of handing a chunk to a streaming consumer. Full means nothing was
+// taken and the same chunk should be offered again later.
+enum class SinkResult { Ok, Full, Abort };
+
+using ByteSink = std::function<SinkResult(const char *data, size_t len)>;
+
+} // namespace rsjfw
+
+#endif // RSJFW_STREAM_HPP
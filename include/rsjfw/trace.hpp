@@ -0,0 +1,86 @@
+#ifndef RSJFW_TRACE_HPP
+#define RSJFW_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace rsjfw {
+
+// Scoped-span tracing for finding where a slow launch or install spends its
+// time. Off by default (--trace or RSJFW_TRACE=1 turns it on); when off a
+// span costs one relaxed load. Each thread records into its own fixed ring,
+// so recording never takes a lock; a thread's ring is freed when it exits,
+// keeping only its spans. dump() writes everything recorded so far as a
+// Chrome trace_event file (chrome://tracing, ui.perfetto.dev).
+class Trace {
+public:
+  class Span {
+  public:
+    // `name` must outlive the process (a string literal); `detail` is copied
+    explicit Span(const char *name, const std::string &detail = "");
+    ~Span();
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+  private:
+    const char *name_;
+    std::string detail_;
+    uint64_t startUs_ = 0;
+  };
+
+  // A span that can end on a different thread than the one that started
+  // it, such as an output callback noticing that Studio is up. end() is
+  // thread-safe and only counts once; the span is reported on the thread
+  // that started it. Ends on destruction if nobody ended it.
+  class Interval {
+  public:
+    explicit Interval(const char *name, const std::string &detail = "");
+    ~Interval();
+    void end();
+
+    Interval(const Interval &) = delete;
+    Interval &operator=(const Interval &) = delete;
+
+  private:
+    const char *name_;
+    std::string detail_;
+    uint64_t startUs_ = 0;
+    int tid_ = 0;
+    std::atomic<bool> ended_{false};
+  };
+
+  static void enable(bool on);
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // Writes logs/trace-<timestamp>.json; returns an empty path when tracing is
+  // off or nothing was recorded
+  static std::filesystem::path dump();
+  // Logs the spans with the most total time, one line each
+  static void logSummary(size_t top = 10);
+  // Writes a dump whenever the process receives `sig` (main uses SIGUSR1),
+  // for a launch that hangs before any of the usual dump points
+  static void dumpOnSignal(int sig);
+
+private:
+  static void record(const char *name, const std::string &detail,
+                     uint64_t startUs, uint64_t endUs);
+  static uint64_t nowUs();
+
+  static std::atomic<bool> enabled_;
+};
+
+#define RSJFW_TRACE_CAT2(a, b) a##b
+#define RSJFW_TRACE_CAT(a, b) RSJFW_TRACE_CAT2(a, b)
+// RSJFW_TRACE("name") or RSJFW_TRACE("name", detail) times the rest of the
+// enclosing scope
+#define RSJFW_TRACE(...)                                                       \
+  rsjfw::Trace::Span RSJFW_TRACE_CAT(traceSpan_, __LINE__)(__VA_ARGS__)
+
+} // namespace rsjfw
+
+#endif // RSJFW_TRACE_HPP
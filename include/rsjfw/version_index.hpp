@@ -0,0 +1,38 @@
+#ifndef RSJFW_VERSION_INDEX_HPP
+#define RSJFW_VERSION_INDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace rsjfw {
+
+// Per-version record of every extracted file: which package it came from,
+// its MD5 and size. Stored as versions/<guid>/.rsjfw_index and used to share
+// identical files between installed versions.
+class VersionIndex {
+public:
+  struct Entry {
+    std::string package;
+    std::string md5;
+    uint64_t size = 0;
+    std::string path; // Relative to the version directory
+  };
+
+  bool load(const std::filesystem::path &versionDir);
+  bool save(const std::filesystem::path &versionDir) const;
+
+  void add(Entry entry) { entries_.push_back(std::move(entry)); }
+  const std::vector<Entry> &entries() const { return entries_; }
+  std::vector<Entry> &entries() { return entries_; }
+
+  static std::filesystem::path fileFor(const std::filesystem::path &versionDir);
+
+private:
+  std::vector<Entry> entries_;
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_VERSION_INDEX_HPP
@@ -30,6 +30,7 @@ public:
     void setEnv(const std::map<std::string, std::string>& env);
     void appendEnv(const std::string& key, const std::string& value);
     std::string getEnv(const std::string& key) const;
+    const std::map<std::string, std::string>& env() const { return env_; }
 
     // Runs a command within the Wineprefix
     // Returns true on success (exit code 0), false otherwise
@@ -37,6 +38,9 @@ public:
     // cwd: Optional working directory for the process
     bool runCommand(const std::string& exe, const std::vector<std::string>& args, std::function<void(const std::string&)> onOutput = nullptr, const std::string& cwd = "", bool wait = true);
 
+    // Called in the parent with the PID of every process runCommand starts
+    void setOnSpawn(std::function<void(int)> onSpawn) { onSpawn_ = std::move(onSpawn); }
+
     // Wrapper to run 'wine' or 'wine64' based on availability
     bool wine(const std::string& exe, const std::vector<std::string>& args, std::function<void(const std::string&)> onOutput = nullptr, const std::string& cwd = "", bool wait = true);
 
@@ -57,10 +61,23 @@ public:
     // Kill all processes in this prefix (wineserver -k)
     bool kill();
 
+    // Whether a wineserver currently owns this prefix (checks its lock file,
+    // no process is started)
+    bool serverRunning() const;
+
+    // Runs `fn` holding the wineserver's own lock, so no server can start
+    // (and rewrite the hives) meanwhile. False without calling `fn` when a
+    // server is running.
+    bool withServerStopped(const std::function<bool()>& fn) const;
+
 private:
+    // /tmp/.wine-<uid>/server-<dev>-<inode of the prefix>, "" if no prefix
+    std::string serverDir() const;
+
     std::string root_;
     std::string dir_;
     std::map<std::string, std::string> env_;
+    std::function<void(int)> onSpawn_;
     
     // Internal helper to construct full environment vector
     std::vector<std::string> buildEnv() const;
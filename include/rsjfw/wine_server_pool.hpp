@@ -0,0 +1,37 @@
+#ifndef RSJFW_WINE_SERVER_POOL_HPP
+#define RSJFW_WINE_SERVER_POOL_HPP
+
+#include <string>
+
+namespace rsjfw {
+
+namespace wine {
+class Prefix;
+}
+
+// With the "persistent_server" Wine option, keeps one warm wineserver
+// (`wineserver -p`) per prefix so launches, registry queries and other
+// short-lived Wine processes skip Wine's cold start. A server is only
+// replaced when the prefix's configuration fingerprint changes.
+class WineServerPool {
+public:
+  static bool enabled();
+
+  // Fingerprint of what a running server and its services were started
+  // with: Wine build, prefix, the config's environment, DXVK, GPU, debug
+  // and desktop settings
+  static std::string fingerprint(const wine::Prefix &pfx);
+
+  // Makes sure a warm server matching `pfx` is running, starting one (and
+  // wineboot, plus the shared desktop in desktop mode) when needed. With
+  // keepRunning a live server is reused even if its fingerprint differs.
+  // False when the option is off or the server could not be started.
+  static bool ensure(wine::Prefix &pfx, bool keepRunning = false);
+
+  // Stops the prefix's server and everything running in it
+  static void release(wine::Prefix &pfx);
+};
+
+} // namespace rsjfw
+
+#endif // RSJFW_WINE_SERVER_POOL_HPP
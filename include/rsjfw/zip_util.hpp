@@ -1,13 +1,38 @@
 #ifndef RSJFW_ZIP_UTIL_HPP
 #define RSJFW_ZIP_UTIL_HPP
 
+#include "rsjfw/stream.hpp"
+#include <cstdint>
+#include <functional>
 #include <string>
 
 namespace rsjfw {
 
 class ZipUtil {
 public:
-    static bool extract(const std::string& archivePath, const std::string& destPath);
+    // Regular file written by an extraction, hashed on the way to disk
+    struct ExtractedFile {
+        std::string path;
+        uint64_t size = 0;
+        std::string md5; // Empty if the data did not arrive in order
+    };
+    using FileCallback = std::function<void(const ExtractedFile& file)>;
+
+    // Produces the archive bytes into the sink, returns true once the whole
+    // archive has been delivered. Runs on its own thread. The sink never
+    // blocks; it answers Full while the extractor is behind.
+    using StreamSource = std::function<bool(const ByteSink& sink)>;
+
+    // Large zips are inflated on several threads, each with its own reader;
+    // everything else goes through a single sequential pass. onFile is never
+    // called concurrently.
+    static bool extract(const std::string& archivePath, const std::string& destPath,
+                        const FileCallback& onFile = nullptr);
+
+    // Extracts while the source is still producing, so the archive never has
+    // to exist on disk as a whole.
+    static bool extractStream(const StreamSource& source, const std::string& destPath,
+                              const FileCallback& onFile = nullptr);
 };
 
 } // namespace rsjfw
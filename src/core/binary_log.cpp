@@ -0,0 +1,603 @@
+#include "rsjfw/binary_log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rsjfw {
+
+namespace {
+
+constexpr char DATA_MAGIC[8] = {'R', 'S', 'J', 'F', 'W', 'L', 'G', '1'};
+constexpr char INDEX_MAGIC[8] = {'R', 'S', 'J', 'F', 'W', 'I', 'X', '1'};
+constexpr uint64_t DATA_START = sizeof(DATA_MAGIC);
+constexpr size_t RECORD_HEADER = 16;
+constexpr size_t INDEX_ENTRY = 41;
+constexpr uint32_t BLOCK_RECORDS = 1024;
+constexpr uint32_t BLOCK_BYTES = 256 * 1024;
+constexpr size_t MAX_MESSAGE = 1024 * 1024;
+constexpr size_t FLUSH_BYTES = 64 * 1024;
+constexpr uint64_t FLUSH_US = 100000;
+constexpr size_t SCAN_CHUNK = 1024 * 1024;
+
+uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+template <typename T> void putLE(std::string &out, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i)
+    out.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff));
+}
+
+template <typename T> T getLE(const char *p) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return static_cast<T>(v);
+}
+
+bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+std::string readAt(int fd, uint64_t offset, size_t len) {
+  std::string buf(len, '\0');
+  size_t got = 0;
+  while (got < len) {
+    ssize_t n = ::pread(fd, buf.data() + got, len - got, offset + got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    got += n;
+  }
+  buf.resize(got);
+  return buf;
+}
+
+uint64_t fileSize(int fd) {
+  struct stat st{};
+  return fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+// Size of the record at `p`, or 0 when it is torn or not a record
+uint32_t recordSize(const char *p, size_t avail) {
+  if (avail < RECORD_HEADER)
+    return 0;
+  uint32_t size = getLE<uint32_t>(p);
+  uint16_t channelLen = getLE<uint16_t>(p + 14);
+  if (size < RECORD_HEADER + channelLen ||
+      size > RECORD_HEADER + 0xffff + MAX_MESSAGE ||
+      static_cast<uint8_t>(p[12]) > static_cast<uint8_t>(LogLevel::ERROR))
+    return 0;
+  return size;
+}
+
+BinaryLogReader::Record parseRecord(const char *p, uint64_t offset) {
+  BinaryLogReader::Record r;
+  uint32_t size = getLE<uint32_t>(p);
+  uint16_t channelLen = getLE<uint16_t>(p + 14);
+  r.offset = offset;
+  r.timeUs = getLE<uint64_t>(p + 4);
+  r.level = static_cast<LogLevel>(p[12]);
+  r.source = static_cast<LogSource>(p[13]);
+  r.channel.assign(p + RECORD_HEADER, channelLen);
+  r.message.assign(p + RECORD_HEADER + channelLen,
+                   size - RECORD_HEADER - channelLen);
+  return r;
+}
+
+// Opens `path` and takes its writer lock. -1 on failure; `busy` says whether
+// another writer holds it
+int openLocked(const std::filesystem::path &path, bool &busy) {
+  busy = false;
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return -1;
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    busy = errno == EWOULDBLOCK;
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Removes "<stem>-<pid>" logs left by writers that found `path` busy, once
+// nobody writes them any more
+void removeOverflowLogs(const std::filesystem::path &path) {
+  std::string prefix = path.stem().string() + "-";
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(path.parent_path(), ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) != 0 ||
+        entry.path().extension() != path.extension())
+      continue;
+    bool busy = false;
+    int fd = openLocked(entry.path(), busy);
+    if (fd < 0)
+      continue;
+    std::filesystem::remove(entry.path().string() + ".idx", ec);
+    std::filesystem::remove(entry.path(), ec);
+    ::close(fd);
+  }
+}
+
+const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::DEBUG:
+    return "DEBUG";
+  case LogLevel::INFO:
+    return "INFO";
+  case LogLevel::WARNING:
+    return "WARN";
+  case LogLevel::ERROR:
+    return "ERROR";
+  }
+  return "UNKNOWN";
+}
+
+const char *sourceName(LogSource source) {
+  switch (source) {
+  case LogSource::Rsjfw:
+    return "rsjfw";
+  case LogSource::Wine:
+    return "wine";
+  case LogSource::Studio:
+    return "studio";
+  }
+  return "?";
+}
+
+} // namespace
+
+BinaryLogWriter::~BinaryLogWriter() { close(); }
+
+bool BinaryLogWriter::open(const std::filesystem::path &path) {
+  close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool busy = false;
+  path_ = path;
+  fd_ = openLocked(path_, busy);
+  if (busy) {
+    // Another session is still writing there; don't cut its log short
+    path_ = path.parent_path() / (path.stem().string() + "-" +
+                                  std::to_string(getpid()) +
+                                  path.extension().string());
+    fd_ = openLocked(path_, busy);
+  } else if (fd_ >= 0) {
+    removeOverflowLogs(path);
+  }
+
+  // Index first, so a reader never matches old entries to new data
+  std::filesystem::path idx = path_.string() + ".idx";
+  if (fd_ >= 0)
+    idxFd_ = ::open(idx.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0 || idxFd_ < 0 || ftruncate(fd_, 0) != 0 ||
+      !writeAll(idxFd_, INDEX_MAGIC, sizeof(INDEX_MAGIC)) ||
+      !writeAll(fd_, DATA_MAGIC, sizeof(DATA_MAGIC))) {
+    if (fd_ >= 0)
+      ::close(fd_);
+    if (idxFd_ >= 0)
+      ::close(idxFd_);
+    fd_ = idxFd_ = -1;
+    return false;
+  }
+  written_ = DATA_START;
+  buffer_.clear();
+  blockCount_ = 0;
+  records_ = 0;
+  lastFlushUs_ = nowUs();
+
+  // Writes out what a burst left in the buffer once output goes quiet
+  flusher_ = std::jthread([this](std::stop_token stop) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pending_.wait(lock, stop, [&] { return !buffer_.empty(); })) {
+      pending_.wait_for(lock, stop, std::chrono::microseconds(FLUSH_US),
+                        [&] { return buffer_.empty(); });
+      if (fd_ >= 0 && !buffer_.empty())
+        flushLocked();
+    }
+  });
+  return true;
+}
+
+void BinaryLogWriter::close() {
+  if (flusher_.joinable()) {
+    flusher_.request_stop();
+    flusher_.join();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0)
+    return;
+  closeBlockLocked();
+  ::close(fd_);
+  ::close(idxFd_);
+  fd_ = idxFd_ = -1;
+}
+
+void BinaryLogWriter::append(LogLevel level, LogSource source,
+                             std::string_view channel,
+                             std::string_view message) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0)
+    return;
+
+  channel = channel.substr(0, 0xffff);
+  message = message.substr(0, MAX_MESSAGE);
+  uint64_t ts = nowUs();
+  bool wasEmpty = buffer_.empty();
+  uint32_t size =
+      static_cast<uint32_t>(RECORD_HEADER + channel.size() + message.size());
+
+  if (blockCount_ == 0) {
+    blockOffset_ = written_ + buffer_.size();
+    blockBytes_ = 0;
+    blockFirstTs_ = ts;
+    blockMask_ = 0;
+  }
+
+  putLE(buffer_, size);
+  putLE(buffer_, ts);
+  buffer_.push_back(static_cast<char>(level));
+  buffer_.push_back(static_cast<char>(source));
+  putLE(buffer_, static_cast<uint16_t>(channel.size()));
+  buffer_.append(channel);
+  buffer_.append(message);
+
+  blockBytes_ += size;
+  ++blockCount_;
+  blockLastTs_ = ts;
+  blockMask_ |= BinaryLogReader::levelBit(level);
+  ++records_;
+
+  if (blockCount_ >= BLOCK_RECORDS || blockBytes_ >= BLOCK_BYTES)
+    closeBlockLocked();
+  else if (buffer_.size() >= FLUSH_BYTES || ts - lastFlushUs_ >= FLUSH_US)
+    flushLocked();
+  if (wasEmpty && !buffer_.empty())
+    pending_.notify_one();
+}
+
+void BinaryLogWriter::flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ >= 0)
+    flushLocked();
+}
+
+void BinaryLogWriter::flushLocked() {
+  if (!buffer_.empty() && writeAll(fd_, buffer_.data(), buffer_.size()))
+    written_ += buffer_.size();
+  buffer_.clear();
+  lastFlushUs_ = nowUs();
+}
+
+void BinaryLogWriter::closeBlockLocked() {
+  if (blockCount_ == 0)
+    return;
+  // Data first, so the index never points past what is on disk
+  flushLocked();
+
+  std::string entry;
+  putLE(entry, blockOffset_);
+  putLE(entry, blockBytes_);
+  putLE(entry, blockCount_);
+  putLE(entry, blockFirstTs_);
+  putLE(entry, blockLastTs_);
+  putLE(entry, records_ - blockCount_);
+  entry.push_back(static_cast<char>(blockMask_));
+  writeAll(idxFd_, entry.data(), entry.size());
+  blockCount_ = 0;
+}
+
+BinaryLogReader::~BinaryLogReader() { close(); }
+
+bool BinaryLogReader::open(const std::filesystem::path &path) {
+  close();
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0)
+    return false;
+  if (readAt(fd_, 0, sizeof(DATA_MAGIC)) !=
+      std::string(DATA_MAGIC, sizeof(DATA_MAGIC))) {
+    close();
+    return false;
+  }
+  struct stat st{};
+  fstat(fd_, &st);
+  ino_ = st.st_ino;
+  path_ = path;
+  refresh();
+  return true;
+}
+
+void BinaryLogReader::close() {
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  ino_ = 0;
+  firstHeader_.clear();
+  blocks_.clear();
+  indexedBlocks_ = 0;
+  indexedEnd_ = DATA_START;
+  idxRead_ = 0;
+}
+
+bool BinaryLogReader::reopenIfReplaced() {
+  struct stat st{};
+  if (::stat(path_.c_str(), &st) != 0 || st.st_ino == ino_)
+    return false;
+  int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  ::close(fd_);
+  fd_ = fd;
+  fstat(fd_, &st);
+  ino_ = st.st_ino;
+  return true;
+}
+
+bool BinaryLogReader::refresh() {
+  if (fd_ < 0)
+    return false;
+  bool restart = reopenIfReplaced();
+  uint64_t size = fileSize(fd_);
+  uint64_t oldEnd =
+      blocks_.empty() ? DATA_START : blocks_.back().offset + blocks_.back().bytes;
+
+  // Rewritten by a new session, which may already have grown past where
+  // this one ended: its first record differs
+  if (!restart && !firstHeader_.empty())
+    restart = readAt(fd_, DATA_START, RECORD_HEADER) != firstHeader_;
+  if (restart || size < oldEnd) {
+    blocks_.clear();
+    indexedBlocks_ = 0;
+    indexedEnd_ = DATA_START;
+    idxRead_ = 0;
+    firstHeader_.clear();
+    ++session_;
+    restart = true;
+  }
+
+  blocks_.resize(indexedBlocks_);
+  loadIndex(size);
+  scan(indexedEnd_, size);
+  if (firstHeader_.empty() && recordCount() > 0)
+    firstHeader_ = readAt(fd_, DATA_START, RECORD_HEADER);
+
+  uint64_t end =
+      blocks_.empty() ? DATA_START : blocks_.back().offset + blocks_.back().bytes;
+  return restart || end != oldEnd;
+}
+
+void BinaryLogReader::loadIndex(uint64_t dataSize) {
+  int idx = ::open((path_.string() + ".idx").c_str(), O_RDONLY | O_CLOEXEC);
+  if (idx < 0)
+    return;
+  if (idxRead_ == 0) {
+    if (readAt(idx, 0, sizeof(INDEX_MAGIC)) !=
+        std::string(INDEX_MAGIC, sizeof(INDEX_MAGIC))) {
+      ::close(idx);
+      return;
+    }
+    idxRead_ = sizeof(INDEX_MAGIC);
+  }
+
+  uint64_t size = fileSize(idx);
+  std::string data =
+      size > idxRead_ ? readAt(idx, idxRead_, size - idxRead_) : std::string();
+  ::close(idx);
+
+  for (size_t pos = 0; pos + INDEX_ENTRY <= data.size(); pos += INDEX_ENTRY) {
+    const char *p = data.data() + pos;
+    Block b;
+    b.offset = getLE<uint64_t>(p);
+    b.bytes = getLE<uint32_t>(p + 8);
+    b.count = getLE<uint32_t>(p + 12);
+    b.firstTs = getLE<uint64_t>(p + 16);
+    b.lastTs = getLE<uint64_t>(p + 24);
+    b.firstRecord = getLE<uint64_t>(p + 32);
+    b.levelMask = static_cast<uint8_t>(p[40]);
+    // Trust only entries that continue the covered range and fit the data
+    if (b.offset != indexedEnd_ || b.offset + b.bytes > dataSize ||
+        b.firstRecord != recordCount())
+      break;
+    blocks_.push_back(b);
+    ++indexedBlocks_;
+    indexedEnd_ += b.bytes;
+    idxRead_ += INDEX_ENTRY;
+  }
+}
+
+void BinaryLogReader::scan(uint64_t from, uint64_t to) {
+  uint64_t pos = from;
+  Block block;
+  auto finish = [&]() {
+    if (block.count > 0)
+      blocks_.push_back(block);
+    block = Block{};
+  };
+
+  while (pos < to) {
+    std::string chunk = readAt(fd_, pos, std::min<uint64_t>(SCAN_CHUNK, to - pos));
+    size_t used = 0;
+    while (true) {
+      uint32_t size = recordSize(chunk.data() + used, chunk.size() - used);
+      if (size == 0 || used + size > chunk.size())
+        break;
+      const char *p = chunk.data() + used;
+      if (block.count == 0) {
+        block.offset = pos + used;
+        block.firstTs = getLE<uint64_t>(p + 4);
+        block.firstRecord = recordCount();
+      }
+      block.bytes += size;
+      ++block.count;
+      block.lastTs = getLE<uint64_t>(p + 4);
+      block.levelMask |= levelBit(static_cast<LogLevel>(p[12]));
+      used += size;
+      if (block.count >= BLOCK_RECORDS || block.bytes >= BLOCK_BYTES) {
+        finish();
+      }
+    }
+
+    if (used == 0) {
+      // A record larger than the chunk, or a torn/garbage tail
+      std::string head = readAt(fd_, pos, RECORD_HEADER);
+      uint32_t size = recordSize(head.data(), head.size());
+      if (size == 0 || size <= chunk.size() || pos + size > to)
+        break;
+      chunk = readAt(fd_, pos, size);
+      if (chunk.size() != size)
+        break;
+      if (block.count == 0) {
+        block.offset = pos;
+        block.firstTs = getLE<uint64_t>(chunk.data() + 4);
+        block.firstRecord = recordCount();
+      }
+      block.bytes += size;
+      ++block.count;
+      block.lastTs = getLE<uint64_t>(chunk.data() + 4);
+      block.levelMask |= levelBit(static_cast<LogLevel>(chunk[12]));
+      used = size;
+    }
+    pos += used;
+  }
+  finish();
+}
+
+uint64_t BinaryLogReader::recordCount() const {
+  return blocks_.empty() ? 0 : blocks_.back().firstRecord + blocks_.back().count;
+}
+
+uint64_t BinaryLogReader::seekTime(uint64_t timeUs) const {
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), timeUs,
+      [](const Block &b, uint64_t t) { return b.lastTs < t; });
+  if (it == blocks_.end())
+    return blocks_.empty() ? DATA_START : blocks_.back().offset + blocks_.back().bytes;
+  return it->offset;
+}
+
+uint64_t BinaryLogReader::seekTail(uint64_t records) const {
+  uint64_t total = recordCount();
+  uint64_t target = total > records ? total - records : 0;
+  auto it = std::upper_bound(
+      blocks_.begin(), blocks_.end(), target,
+      [](uint64_t t, const Block &b) { return t < b.firstRecord; });
+  return it == blocks_.begin() ? DATA_START : std::prev(it)->offset;
+}
+
+std::vector<BinaryLogReader::Record>
+BinaryLogReader::read(uint64_t offset, size_t max, uint8_t levelMask,
+                      uint64_t *next) const {
+  std::vector<Record> out;
+  uint64_t cursor = offset;
+  auto it = std::upper_bound(
+      blocks_.begin(), blocks_.end(), offset,
+      [](uint64_t o, const Block &b) { return o < b.offset + b.bytes; });
+
+  for (; it != blocks_.end() && out.size() < max; ++it) {
+    cursor = it->offset + it->bytes;
+    if (!(it->levelMask & levelMask))
+      continue;
+
+    std::string data = readAt(fd_, it->offset, it->bytes);
+    for (size_t pos = 0; pos < data.size();) {
+      uint32_t size = recordSize(data.data() + pos, data.size() - pos);
+      if (size == 0 || pos + size > data.size())
+        break;
+      uint64_t at = it->offset + pos;
+      pos += size;
+      if (at < offset ||
+          !(levelBit(static_cast<LogLevel>(data[pos - size + 12])) & levelMask))
+        continue;
+      out.push_back(parseRecord(data.data() + pos - size, at));
+      if (out.size() == max) {
+        cursor = it->offset + pos;
+        break;
+      }
+    }
+  }
+
+  if (next)
+    *next = std::max(cursor, offset);
+  return out;
+}
+
+uint8_t BinaryLogReader::maskAtLeast(LogLevel level) {
+  uint8_t mask = 0;
+  for (int l = static_cast<int>(level); l <= static_cast<int>(LogLevel::ERROR); ++l)
+    mask |= levelBit(static_cast<LogLevel>(l));
+  return mask;
+}
+
+std::string BinaryLogReader::format(const Record &record) {
+  std::time_t secs = static_cast<std::time_t>(record.timeUs / 1000000);
+  std::tm tm{};
+  localtime_r(&secs, &tm);
+  char stamp[40];
+  size_t n = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+  snprintf(stamp + n, sizeof(stamp) - n, ".%03u",
+           static_cast<unsigned>(record.timeUs / 1000 % 1000));
+
+  std::string line = "[" + std::string(stamp) + "] [" +
+                     levelName(record.level) + "] [" +
+                     sourceName(record.source);
+  if (!record.channel.empty())
+    line += ":" + record.channel;
+  line += "] ";
+  line += record.message;
+  return line;
+}
+
+bool BinaryLogReader::toText(const std::filesystem::path &path,
+                             std::ostream &out, LogLevel minLevel,
+                             bool follow) {
+  BinaryLogReader reader;
+  if (!reader.open(path))
+    return false;
+
+  uint8_t mask = maskAtLeast(minLevel);
+  uint64_t offset = DATA_START;
+  uint64_t session = reader.session();
+  while (out) {
+    uint64_t next = offset;
+    auto records = reader.read(offset, 4096, mask, &next);
+    for (const auto &r : records)
+      out << format(r) << '\n';
+    offset = next;
+    if (!records.empty())
+      continue;
+    if (!follow)
+      break;
+
+    out.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    reader.refresh();
+    if (reader.session() != session) {
+      session = reader.session();
+      offset = DATA_START;
+    }
+  }
+  return static_cast<bool>(out);
+}
+
+} // namespace rsjfw
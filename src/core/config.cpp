@@ -130,6 +130,25 @@ void Config::load(const std::filesystem::path &path) {
       wine_.desktopMode = w.value("desktop_mode", false);
       wine_.multipleDesktops = w.value("multiple_desktops", false);
       wine_.desktopResolution = w.value("desktop_resolution", "1920x1080");
+      wine_.persistentServer = w.value("persistent_server", false);
+    }
+
+    if (j.contains("installer")) {
+      auto &in = j["installer"];
+      installer_.streamExtract = in.value("stream_extract", true);
+      installer_.maxTransfers = in.value("max_transfers", 16);
+      installer_.packageCacheMB = in.value("package_cache_mb", 4096);
+      installer_.dedupeVersions = in.value("dedupe_versions", true);
+      installer_.deltaUpdates = in.value("delta_updates", true);
+      installer_.downloadRetries = in.value("download_retries", 4);
+      installer_.downloadSegments = in.value("download_segments", 4);
+      installer_.bandwidthLimitKBps = in.value("bandwidth_limit_kbps", 0);
+      installer_.launchBeforeComplete =
+          in.value("launch_before_complete", false);
+      installer_.backgroundUpdates = in.value("background_updates", false);
+      installer_.mirror = in.value("mirror", "");
+      installer_.lanSharing = in.value("lan_sharing", false);
+      installer_.lanPort = in.value("lan_port", 0);
     }
 
     if (j.contains("fflags")) {
@@ -183,6 +202,21 @@ void Config::save() {
   j["wine"]["desktop_mode"] = wine_.desktopMode;
   j["wine"]["multiple_desktops"] = wine_.multipleDesktops;
   j["wine"]["desktop_resolution"] = wine_.desktopResolution;
+  j["wine"]["persistent_server"] = wine_.persistentServer;
+
+  j["installer"]["stream_extract"] = installer_.streamExtract;
+  j["installer"]["max_transfers"] = installer_.maxTransfers;
+  j["installer"]["package_cache_mb"] = installer_.packageCacheMB;
+  j["installer"]["dedupe_versions"] = installer_.dedupeVersions;
+  j["installer"]["delta_updates"] = installer_.deltaUpdates;
+  j["installer"]["download_retries"] = installer_.downloadRetries;
+  j["installer"]["download_segments"] = installer_.downloadSegments;
+  j["installer"]["bandwidth_limit_kbps"] = installer_.bandwidthLimitKBps;
+  j["installer"]["launch_before_complete"] = installer_.launchBeforeComplete;
+  j["installer"]["background_updates"] = installer_.backgroundUpdates;
+  j["installer"]["mirror"] = installer_.mirror;
+  j["installer"]["lan_sharing"] = installer_.lanSharing;
+  j["installer"]["lan_port"] = installer_.lanPort;
 
   j["fflags"] = json::object();
   for (const auto &[key, val] : fflags_) {
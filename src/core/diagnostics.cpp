@@ -6,6 +6,7 @@
 #include "rsjfw/logger.hpp"
 #include "rsjfw/path_manager.hpp"
 #include "rsjfw/state.hpp"
+#include "rsjfw/trace.hpp"
 #include <chrono>
 #include <filesystem>
 #include <fstream>
@@ -36,6 +37,7 @@ void Diagnostics::fixIssue(const std::string &name,
                            std::function<void(float, std::string)> progressCb) {
   // Provide a no-op callback if nullptr to prevent bad_function_call
   auto safeCb = progressCb ? progressCb : [](float, std::string) {};
+  RSJFW_TRACE("Diagnostics::fixIssue", name);
 
   for (const auto &check : results_) {
     if (check.first == name && check.second.fixable && check.second.fixAction) {
@@ -47,6 +49,7 @@ void Diagnostics::fixIssue(const std::string &name,
 }
 
 bool Diagnostics::runChecks() {
+  RSJFW_TRACE("Diagnostics::runChecks");
   results_.clear();
 
   checkRoot();
@@ -64,6 +67,7 @@ bool Diagnostics::runChecks() {
 }
 
 void Diagnostics::checkRoot() {
+  RSJFW_TRACE("Diagnostics::checkRoot");
   auto &pm = PathManager::instance();
   bool rootOk = std::filesystem::exists(pm.root());
   results_.push_back({"RSJFW Root",
@@ -77,6 +81,7 @@ void Diagnostics::checkRoot() {
 }
 
 void Diagnostics::checkConfig() {
+  RSJFW_TRACE("Diagnostics::checkConfig");
   auto &pm = PathManager::instance();
   bool configOk = std::filesystem::exists(pm.root() / "config.json");
   HealthStatus configStatus = {
@@ -95,6 +100,7 @@ void Diagnostics::checkConfig() {
 }
 
 void Diagnostics::checkWine() {
+  RSJFW_TRACE("Diagnostics::checkWine");
   auto &cfg = Config::instance().getGeneral();
   auto appState = State::instance().get();
   bool downloadingWine = (appState == AppState::DOWNLOADING_WINE);
@@ -204,6 +210,7 @@ void Diagnostics::checkWine() {
 }
 
 void Diagnostics::checkLayer() {
+  RSJFW_TRACE("Diagnostics::checkLayer");
   auto &pm = PathManager::instance();
   std::filesystem::path layer = pm.layerLib();
   bool layerOk = std::filesystem::exists(layer);
@@ -253,6 +260,7 @@ void Diagnostics::checkLayer() {
 }
 
 void Diagnostics::checkPrefix() {
+  RSJFW_TRACE("Diagnostics::checkPrefix");
   auto &pm = PathManager::instance();
   std::filesystem::path pfxMarker = pm.prefix() / ".rsjfw_setup_complete";
   bool pfxOk = std::filesystem::exists(pfxMarker) &&
@@ -275,6 +283,7 @@ void Diagnostics::checkPrefix() {
 }
 
 void Diagnostics::checkDesktop() {
+  RSJFW_TRACE("Diagnostics::checkDesktop");
   auto &pm = PathManager::instance();
   bool isLocal = pm.isLocalBuild();
   std::string desktopSuffix = isLocal ? "-local" : "";
@@ -345,6 +354,7 @@ void Diagnostics::checkDesktop() {
 }
 
 void Diagnostics::checkProtocol() {
+  RSJFW_TRACE("Diagnostics::checkProtocol");
   auto &pm = PathManager::instance();
   bool isLocal = pm.isLocalBuild();
   std::string desktopFilename =
@@ -377,6 +387,7 @@ void Diagnostics::checkProtocol() {
 }
 
 void Diagnostics::checkLegacy() {
+  RSJFW_TRACE("Diagnostics::checkLegacy");
   auto &pm = PathManager::instance();
   std::filesystem::path legacyRoot =
       std::filesystem::path(getenv("HOME")) / ".rsjfw";
@@ -424,6 +435,7 @@ void Diagnostics::checkLegacy() {
 }
 
 void Diagnostics::checkFlatpak() {
+  RSJFW_TRACE("Diagnostics::checkFlatpak");
   bool isFlatpak = std::filesystem::exists("/.flatpak-info");
 
   if (isFlatpak) {
@@ -475,6 +487,7 @@ void Diagnostics::checkFlatpak() {
 // ... (other checks remain same, just skip to checkSystem) ...
 
 void Diagnostics::checkSystem() {
+  RSJFW_TRACE("Diagnostics::checkSystem");
   // 1. Build Tools (Git, CMake, Make, G++)
   struct Tool {
     std::string name;
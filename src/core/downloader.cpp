@@ -1,13 +1,25 @@
 #include "rsjfw/downloader.hpp"
 #include "rsjfw/config.hpp"
+#include "rsjfw/file_clone.hpp"
 #include "rsjfw/http.hpp"
+#include "rsjfw/http_engine.hpp"
+#include "rsjfw/lan_peers.hpp"
 #include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/mirror.hpp"
+#include "rsjfw/package_cache.hpp"
 #include "rsjfw/path_manager.hpp"
 #include "rsjfw/task_runner.hpp"
+#include "rsjfw/trace.hpp"
+#include "rsjfw/version_index.hpp"
 #include "rsjfw/zip_util.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <condition_variable>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -15,8 +27,18 @@
 #include <nlohmann/json.hpp>
 #include <queue>
 #include <set>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 namespace rsjfw {
 
 Downloader::Downloader(const std::string &rootDir) {
@@ -44,7 +66,8 @@ std::vector<std::string> Downloader::getInstalledVersions() {
     return versions;
 
   for (const auto &entry : std::filesystem::directory_iterator(versionsDir_)) {
-    if (entry.is_directory()) {
+    // versions/current is a pointer, not an install
+    if (entry.is_directory() && !entry.is_symlink()) {
       std::string name = entry.path().filename().string();
       if (isVersionInstalled(name)) {
         versions.push_back(name);
@@ -66,222 +89,755 @@ bool Downloader::installLatest(ProgressCallback callback) {
     return false;
   }
 }
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Raised when the owner of background installs (e.g. the config window) exits
+static std::atomic<bool> backgroundCancelled{false};
+
+// Where each package lands inside the version directory
+static const std::unordered_map<std::string, std::string> &packageMap() {
+  static const std::unordered_map<std::string, std::string> map = {
+      {"ApplicationConfig.zip", "ApplicationConfig/"},
+      {"redist.zip", ""},
+      {"RobloxStudio.zip", ""},
+      {"Libraries.zip", ""},
+      {"content-avatar.zip", "content/avatar/"},
+      {"content-configs.zip", "content/configs/"},
+      {"content-fonts.zip", "content/fonts/"},
+      {"content-sky.zip", "content/sky/"},
+      {"content-sounds.zip", "content/sounds/"},
+      {"content-textures2.zip", "content/textures/"},
+      {"content-studio_svg_textures.zip", "content/studio_svg_textures/"},
+      {"content-models.zip", "content/models/"},
+      {"content-textures3.zip", "PlatformContent/pc/textures/"},
+      {"content-terrain.zip", "PlatformContent/pc/terrain/"},
+      {"content-platform-fonts.zip", "PlatformContent/pc/fonts/"},
+      {"content-platform-dictionaries.zip",
+       "PlatformContent/pc/shared_compression_dictionaries/"},
+      {"content-qt_translations.zip", "content/qt_translations/"},
+      {"content-api-docs.zip", "content/api_docs/"},
+      {"extracontent-scripts.zip", "ExtraContent/scripts/"},
+      {"extracontent-luapackages.zip", "ExtraContent/LuaPackages/"},
+      {"extracontent-translations.zip", "ExtraContent/translations/"},
+      {"extracontent-models.zip", "ExtraContent/models/"},
+      {"extracontent-textures.zip", "ExtraContent/textures/"},
+      {"studiocontent-models.zip", "StudioContent/models/"},
+      {"studiocontent-textures.zip", "StudioContent/textures/"},
+      {"shaders.zip", "shaders/"},
+      {"BuiltInPlugins.zip", "BuiltInPlugins/"},
+      {"BuiltInStandalonePlugins.zip", "BuiltInStandalonePlugins/"},
+      {"LibrariesQt5.zip", ""},
+      {"Plugins.zip", "Plugins/"},
+      {"RibbonConfig.zip", "RibbonConfig/"},
+      {"StudioFonts.zip", "StudioFonts/"},
+      {"ssl.zip", "ssl/"}};
+  return map;
+}
+
+static std::string packageSubDir(const std::string &packageName) {
+  std::string subDir = ".";
+  auto it = packageMap().find(packageName);
+  if (it != packageMap().end()) {
+    subDir = it->second;
+    std::replace(subDir.begin(), subDir.end(), '\\', '/');
+  }
+  return subDir;
+}
+
+// flock on versions/.<guid>.lock so only one process (prefetch timer, GUI,
+// CLI) installs a version at a time; released when the holder closes it
+struct VersionLock {
+  int fd = -1;
+  VersionLock() = default;
+  VersionLock(const VersionLock &) = delete;
+  VersionLock &operator=(const VersionLock &) = delete;
+  ~VersionLock() {
+    if (fd >= 0)
+      close(fd);
+  }
+};
+
+static bool lockVersion(const std::string &versionsDir,
+                        const std::string &versionGUID, bool wait,
+                        VersionLock &lock) {
+  std::error_code ec;
+  std::filesystem::create_directories(versionsDir, ec);
+  std::filesystem::path path =
+      std::filesystem::path(versionsDir) / ("." + versionGUID + ".lock");
+  lock.fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lock.fd < 0) {
+    LOG_ERROR("Failed to open install lock " + path.string() + ": " +
+              strerror(errno));
+    return false;
+  }
+  if (flock(lock.fd, LOCK_EX | LOCK_NB) == 0)
+    return true;
+  if (errno != EWOULDBLOCK || !wait)
+    return false;
+  LOG_INFO("Waiting for another install of " + versionGUID + " to finish");
+  while (flock(lock.fd, LOCK_EX) != 0) {
+    if (errno != EINTR)
+      return false;
+  }
+  return true;
+}
+
+// Files Studio or RSJFW rewrite after install (settings, FFlags). They may
+// be reflinked but never hard-linked, so a write stays in one version.
+static bool isMutableVersionFile(const std::string &relPath) {
+  std::filesystem::path p(relPath);
+  std::string ext = p.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return relPath.rfind("ClientSettings/", 0) == 0 || ext == ".xml" ||
+         ext == ".json" || ext == ".ini" || ext == ".cfg";
+}
+
+static std::filesystem::path packageMarker(const std::string &installDir,
+                                           const std::string &packageName) {
+  return std::filesystem::path(installDir) / ".rsjfw_packages" / packageName;
+}
+
+// A package counts as installed once its marker holds the manifest checksum
+static bool hasPackageMarker(const std::string &installDir,
+                             const RobloxPackage &pkg) {
+  std::ifstream ifs(packageMarker(installDir, pkg.name));
+  std::string checksum;
+  return std::getline(ifs, checksum) && checksum == pkg.checksum;
+}
+
+static void writePackageMarker(const std::string &installDir,
+                               const RobloxPackage &pkg) {
+  std::filesystem::path marker = packageMarker(installDir, pkg.name);
+  std::filesystem::create_directories(marker.parent_path());
+  std::ofstream(marker, std::ios::trunc) << pkg.checksum << "\n";
+}
+
+static std::vector<RobloxPackage>
+recordedManifest(const std::string &installDir) {
+  std::ifstream ifs(std::filesystem::path(installDir) / ".rsjfw_manifest");
+  if (!ifs)
+    return {};
+  std::stringstream buffer;
+  buffer << ifs.rdbuf();
+  return RobloxAPI::parsePackageManifest(buffer.str());
+}
+
 bool Downloader::isVersionInstalled(const std::string &versionGUID) {
   if (versionGUID.empty())
     return false;
   std::string installDir =
       (std::filesystem::path(versionsDir_) / versionGUID).string();
-  // Basic check: directory exists and has AppSettings.xml (indicates successful
-  // post-install)
-  return std::filesystem::exists(installDir) &&
-         std::filesystem::exists(std::filesystem::path(installDir) /
-                                 "AppSettings.xml");
+  // AppSettings.xml is written once Studio can boot; installs that track
+  // packages must also have a marker for every one of them
+  if (!std::filesystem::exists(std::filesystem::path(installDir) /
+                               "AppSettings.xml"))
+    return false;
+  if (!std::filesystem::exists(std::filesystem::path(installDir) /
+                               ".rsjfw_packages"))
+    return true;
+  for (const auto &pkg : recordedManifest(installDir))
+    if (!hasPackageMarker(installDir, pkg))
+      return false;
+  return true;
+}
+
+bool Downloader::isVersionLaunchable(const std::string &versionGUID) {
+  if (versionGUID.empty())
+    return false;
+  std::string installDir =
+      (std::filesystem::path(versionsDir_) / versionGUID).string();
+  if (!std::filesystem::exists(std::filesystem::path(installDir) /
+                               "AppSettings.xml"))
+    return false;
+  for (const auto &pkg : recordedManifest(installDir))
+    if (isCriticalPackage(pkg.name) && !hasPackageMarker(installDir, pkg))
+      return false;
+  return true;
 }
 
 bool Downloader::installVersion(const std::string &versionGUID,
                                 ProgressCallback callback) {
+  RSJFW_TRACE("Downloader::installVersion", versionGUID);
   try {
-    auto packages = RobloxAPI::getPackageManifest(versionGUID);
+    // Prefetch leaves a version alone while anyone else is installing it;
+    // everyone else waits and then finds it done
+    VersionLock lock;
+    if (!lockVersion(versionsDir_, versionGUID, !background_, lock)) {
+      if (background_) {
+        LOG_INFO("Prefetch: " + versionGUID +
+                 " is being installed by another process");
+        return true;
+      }
+      return false;
+    }
+
+    // Checked before the manifest fetch so launching an installed version
+    // needs no network
+    if (isVersionInstalled(versionGUID)) {
+      std::cout << "[RSJFW] Version " << versionGUID
+                << " already installed.\n";
+      setCurrentVersion(versionGUID);
+      if (callback)
+        callback("Already installed", 1.0f, 1, 1);
+      return true;
+    }
+
+    timings_ = {};
+    auto manifestStart = std::chrono::steady_clock::now();
+    auto packages = [&] {
+      RSJFW_TRACE("Downloader::manifest", versionGUID);
+      return RobloxAPI::getPackageManifest(versionGUID);
+    }();
+    timings_.manifest = secondsSince(manifestStart);
     std::cout << "[RSJFW] Found " << packages.size()
               << " packages to install.\n";
 
     std::string installDir =
         (std::filesystem::path(versionsDir_) / versionGUID).string();
+    VersionIndex index;
+    std::set<std::string> done;
     if (std::filesystem::exists(installDir)) {
-      std::cout << "[RSJFW] Version " << versionGUID << " already installed.\n";
-      if (callback)
-        callback("Already installed", 1.0f, packages.size(), packages.size());
-      return true;
+      if (!std::filesystem::exists(std::filesystem::path(installDir) /
+                                   ".rsjfw_manifest")) {
+        // Interrupted before package markers existed; nothing to trust
+        std::filesystem::remove_all(installDir);
+      } else {
+        // Keep every package that finished and made it into the index
+        index.load(installDir);
+        std::set<std::string> indexed;
+        for (const auto &e : index.entries())
+          indexed.insert(e.package);
+        for (const auto &pkg : packages)
+          if (hasPackageMarker(installDir, pkg) && indexed.count(pkg.name))
+            done.insert(pkg.name);
+        auto &entries = index.entries();
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&](const VersionIndex::Entry &e) {
+                                       return !done.count(e.package);
+                                     }),
+                      entries.end());
+        std::cout << "[RSJFW] Resuming install of " << versionGUID << " ("
+                  << done.size() << "/" << packages.size()
+                  << " packages present)\n";
+      }
     }
 
     std::filesystem::create_directories(installDir);
+    // Recorded up front so an interrupted install can be resumed
+    std::ofstream(std::filesystem::path(installDir) / ".rsjfw_manifest")
+        << RobloxAPI::formatPackageManifest(packages);
+
+    const auto &installerCfg = Config::instance().getInstaller();
+
+    std::set<size_t> reused;
+    if (installerCfg.deltaUpdates && done.empty())
+      reused = reuseUnchangedPackages(installDir, packages, index);
+    for (size_t i : reused)
+      writePackageMarker(installDir, packages[i]);
 
-    static const std::unordered_map<std::string, std::string> packageMap = {
-        {"ApplicationConfig.zip", "ApplicationConfig/"},
-        {"redist.zip", ""},
-        {"RobloxStudio.zip", ""},
-        {"Libraries.zip", ""},
-        {"content-avatar.zip", "content/avatar/"},
-        {"content-configs.zip", "content/configs/"},
-        {"content-fonts.zip", "content/fonts/"},
-        {"content-sky.zip", "content/sky/"},
-        {"content-sounds.zip", "content/sounds/"},
-        {"content-textures2.zip", "content/textures/"},
-        {"content-studio_svg_textures.zip", "content/studio_svg_textures/"},
-        {"content-models.zip", "content/models/"},
-        {"content-textures3.zip", "PlatformContent/pc/textures/"},
-        {"content-terrain.zip", "PlatformContent/pc/terrain/"},
-        {"content-platform-fonts.zip", "PlatformContent/pc/fonts/"},
-        {"content-platform-dictionaries.zip",
-         "PlatformContent/pc/shared_compression_dictionaries/"},
-        {"content-qt_translations.zip", "content/qt_translations/"},
-        {"content-api-docs.zip", "content/api_docs/"},
-        {"extracontent-scripts.zip", "ExtraContent/scripts/"},
-        {"extracontent-luapackages.zip", "ExtraContent/LuaPackages/"},
-        {"extracontent-translations.zip", "ExtraContent/translations/"},
-        {"extracontent-models.zip", "ExtraContent/models/"},
-        {"extracontent-textures.zip", "ExtraContent/textures/"},
-        {"studiocontent-models.zip", "StudioContent/models/"},
-        {"studiocontent-textures.zip", "StudioContent/textures/"},
-        {"shaders.zip", "shaders/"},
-        {"BuiltInPlugins.zip", "BuiltInPlugins/"},
-        {"BuiltInStandalonePlugins.zip", "BuiltInStandalonePlugins/"},
-        {"LibrariesQt5.zip", ""},
-        {"Plugins.zip", "Plugins/"},
-        {"RibbonConfig.zip", "RibbonConfig/"},
-        {"StudioFonts.zip", "StudioFonts/"},
-        {"ssl.zip", "ssl/"}};
-
-    std::mutex queueMutex;
-    std::condition_variable cv;
-    std::queue<size_t> packageQueue;
+    // The boot set goes first in its own order, then largest first so the
+    // long transfers overlap with everything else, deferrable ones last
+    std::vector<size_t> order;
     for (size_t i = 0; i < packages.size(); ++i)
-      packageQueue.push(i);
-
-    std::atomic<int> completedPackages{0};
-    std::atomic<bool> failed{false};
-    std::mutex callbackMutex;
-
-    const int numThreads = 4;
-    std::vector<std::jthread> workers;
-
-    for (int t = 0; t < numThreads; ++t) {
-      workers.emplace_back([&]() {
-        while (true) {
-          size_t pkgIdx;
-          {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            if (packageQueue.empty() || failed)
+      if (!reused.count(i) && !done.count(packages[i].name))
+        order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      size_t pa = bootPriority(packages[a].name);
+      size_t pb = bootPriority(packages[b].name);
+      if (pa != pb)
+        return pa < pb;
+      bool ca = isCriticalPackage(packages[a].name);
+      bool cb = isCriticalPackage(packages[b].name);
+      if (ca != cb)
+        return ca;
+      return packages[a].packedSize > packages[b].packedSize;
+    });
+
+    // In launch-before-complete mode only the boot set is installed before
+    // returning; the rest follows in the background
+    std::vector<size_t> now, later;
+    for (size_t i : order) {
+      if (installerCfg.launchBeforeComplete && !background_ &&
+          !isCriticalPackage(packages[i].name))
+        later.push_back(i);
+      else
+        now.push_back(i);
+    }
+
+    if (!installPackages(versionGUID, installDir, packages, now, index,
+                         callback, background_))
+      return false;
+    finalizeVersion(installDir, index);
+    if (later.empty())
+      setCurrentVersion(versionGUID);
+
+    if (!later.empty()) {
+      std::cout << "[RSJFW] " << later.size()
+                << " content packages will finish in the background\n";
+      Downloader self = *this;
+      TaskRunner::instance().run(
+          [self, versionGUID, installDir, packages, later]() mutable {
+            VersionLock bgLock;
+            if (!lockVersion(self.versionsDir_, versionGUID, true, bgLock))
               return;
-            pkgIdx = packageQueue.front();
-            packageQueue.pop();
-          }
+            // Another installer may have finished some of these meanwhile
+            std::vector<size_t> remaining;
+            for (size_t i : later)
+              if (!hasPackageMarker(installDir, packages[i]))
+                remaining.push_back(i);
+            VersionIndex bgIndex;
+            bgIndex.load(installDir);
+            if (self.installPackages(versionGUID, installDir, packages,
+                                     remaining, bgIndex, nullptr, true)) {
+              self.finalizeVersion(installDir, bgIndex);
+              self.setCurrentVersion(versionGUID);
+              LOG_INFO("Background content for " + versionGUID +
+                       " complete");
+            } else {
+              LOG_WARN("Background content for " + versionGUID +
+                       " failed; it resumes on the next install");
+            }
+          });
+    }
 
-          const auto &pkg = packages[pkgIdx];
+    if (callback)
+      callback("Done", 1.0f, packages.size(), packages.size());
+    std::cout << "[RSJFW] Successfully installed version " << versionGUID
+              << "\n";
+    return true;
 
-          {
-            std::lock_guard<std::mutex> lock(callbackMutex);
-            if (callback)
-              callback(pkg.name, 0.0f, completedPackages, packages.size());
-          }
+  } catch (const std::exception &e) {
+    std::cerr << "[RSJFW] Error installing version: " << e.what() << "\n";
+    return false;
+  }
+}
 
-          bool success =
-              downloadPackage(versionGUID, pkg, [&](size_t cur, size_t tot) {
-                if (failed)
-                  return;
-                std::lock_guard<std::mutex> lock(callbackMutex);
-                if (callback && tot > 0) {
-                  float itemProg = (float)cur / (float)tot;
-                  callback(pkg.name, itemProg, completedPackages,
-                           packages.size());
-                }
-              });
+bool Downloader::installPackages(const std::string &versionGUID,
+                                 const std::string &installDir,
+                                 const std::vector<RobloxPackage> &packages,
+                                 const std::vector<size_t> &order,
+                                 VersionIndex &index,
+                                 ProgressCallback callback, bool background) {
+  if (order.empty())
+    return true;
 
-          if (!success) {
-            failed = true;
-            return;
-          }
+  const auto &installerCfg = Config::instance().getInstaller();
+  std::mutex indexMutex;
+
+  std::mutex queueMutex;
+  std::queue<size_t> packageQueue;
+  for (size_t i : order)
+    packageQueue.push(i);
+
+  std::atomic<int> completedPackages{(int)(packages.size() - order.size())};
+  std::atomic<bool> failed{false};
+  std::mutex callbackMutex;
+  const bool streamExtract = installerCfg.streamExtract;
+  const bool preferPeers = !LanPeers::instance().peers().empty();
+  // Every worker keeps one transfer in flight; the engine multiplexes them
+  // over a handful of shared connections and admits as many as the
+  // throughput probe below allows
+  const int numThreads = std::max(
+      1, std::min<int>(installerCfg.maxTransfers, (int)packageQueue.size()));
+  // The limits below apply to this install's transfers only
+  auto group = std::make_shared<HttpEngine::Group>(background);
+  group->setBandwidthLimit(
+      (uint64_t)std::max(0, installerCfg.bandwidthLimitKBps) * 1024);
+  int allowed = std::min(numThreads, 4);
+  group->setMaxInFlight(allowed);
+
+  std::atomic<uint64_t> bytesIn{0};
+  // Worker time per phase in microseconds, folded into timings_ at the end
+  std::atomic<int64_t> downloadUs{0}, extractUs{0};
+  auto timed = [](std::atomic<int64_t> &total, auto &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    auto result = fn();
+    total += (int64_t)(secondsSince(start) * 1e6);
+    return result;
+  };
+  std::atomic<int> running{numThreads};
+  std::vector<std::jthread> workers;
+
+  auto work = [&]() {
+    while (true) {
+      size_t pkgIdx;
+      {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (background && backgroundCancelled)
+          failed = true;
+        if (packageQueue.empty() || failed)
+          return;
+        pkgIdx = packageQueue.front();
+        packageQueue.pop();
+      }
 
-          std::string subDir = ".";
-          auto it = packageMap.find(pkg.name);
-          if (it != packageMap.end()) {
-            subDir = it->second;
-            std::replace(subDir.begin(), subDir.end(), '\\', '/');
-          }
+      const auto &pkg = packages[pkgIdx];
+      RSJFW_TRACE("Downloader::package", pkg.name);
 
-          std::string pkgPath =
-              (std::filesystem::path(downloadsDir_) / pkg.checksum).string();
-          std::string destPath =
-              (std::filesystem::path(installDir) / subDir).string();
+      {
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        if (callback)
+          callback(pkg.name, 0.0f, completedPackages, packages.size());
+      }
 
-          std::filesystem::create_directories(destPath);
-          if (!ZipUtil::extract(pkgPath, destPath)) {
-            LOG_ERROR("Failed to extract " + pkg.name);
-            failed = true;
-            return;
-          }
+      auto progressCb = [&](size_t cur, size_t tot) {
+        if (failed)
+          return;
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        if (callback && tot > 0) {
+          float itemProg = (float)cur / (float)tot;
+          callback(pkg.name, itemProg, completedPackages, packages.size());
+        }
+      };
+      // Same, but also feeds the throughput probe
+      size_t seen = 0;
+      auto netProgressCb = [&](size_t cur, size_t tot) {
+        if (cur > seen)
+          bytesIn += cur - seen;
+        seen = cur;
+        progressCb(cur, tot);
+      };
+
+      std::string destPath =
+          (std::filesystem::path(installDir) / packageSubDir(pkg.name))
+              .string();
+      std::filesystem::create_directories(destPath);
+
+      // Each attempt re-extracts the whole package, so only the files
+      // of the one that succeeds are kept
+      std::vector<VersionIndex::Entry> files;
+      auto onFile = [&](const ZipUtil::ExtractedFile &f) {
+        files.push_back(
+            {pkg.name, f.md5, f.size,
+             std::filesystem::path(f.path)
+                 .lexically_normal()
+                 .lexically_relative(installDir)
+                 .generic_string()});
+      };
+
+      bool installed = false;
+      std::filesystem::path cached =
+          PackageCache::instance().lookup(pkg.checksum);
+      if (!cached.empty()) {
+        installed = timed(extractUs, [&] {
+          return ZipUtil::extract(cached.string(), destPath, onFile);
+        });
+        if (installed)
+          progressCb(pkg.packedSize, pkg.packedSize);
+        else
+          LOG_WARN("Cached " + pkg.name + " is unreadable, refetching");
+      }
 
-          // Post-extraction Zip Cleanup (As per user strategy)
-          std::filesystem::remove(pkgPath);
+      // Peers hand out whole zips, so with any around the package takes
+      // the download path and lands in the store for the next host
+      if (!installed && streamExtract && !preferPeers) {
+        files.clear();
+        installed = timed(downloadUs, [&] {
+          return streamPackage(versionGUID, pkg, destPath, netProgressCb,
+                               onFile);
+        });
+        if (!installed)
+          LOG_WARN("Streaming install of " + pkg.name +
+                   " failed, falling back to full download");
+      }
 
-          completedPackages++;
-          {
-            std::lock_guard<std::mutex> lock(callbackMutex);
-            if (callback)
-              callback(pkg.name, 1.0f, completedPackages, packages.size());
-          }
+      if (!installed) {
+        if (!timed(downloadUs, [&] {
+              return downloadPackage(versionGUID, pkg, netProgressCb);
+            })) {
+          failed = true;
+          return;
+        }
+
+        files.clear();
+        std::string pkgPath = packageFile(pkg);
+        if (!timed(extractUs, [&] {
+              return ZipUtil::extract(pkgPath, destPath, onFile);
+            })) {
+          LOG_ERROR("Failed to extract " + pkg.name);
+          failed = true;
+          return;
         }
-      });
+
+        // Without a package store the zip is only transient
+        if (!PackageCache::instance().enabled())
+          std::filesystem::remove(pkgPath);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        for (auto &f : files)
+          index.add(std::move(f));
+      }
+      writePackageMarker(installDir, pkg);
+
+      completedPackages++;
+      {
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        if (callback)
+          callback(pkg.name, 1.0f, completedPackages, packages.size());
+      }
     }
+  };
+
+  for (int t = 0; t < numThreads; ++t) {
+    workers.emplace_back([&]() {
+      HttpEngine::GroupScope scope(group);
+      // Background extraction runs at idle I/O and lowest CPU priority so a
+      // running Studio keeps the disk and the cores; the engine does the
+      // same for this group's downloads
+      if (background) {
+        syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0,
+                3 << 13 /* IOPRIO_CLASS_IDLE */);
+        setpriority(PRIO_PROCESS, 0, 19);
+      }
+      work();
+      running--;
+    });
+  }
 
-    // Wait for workers
-    workers.clear(); // std::jthread joins on destruction
+  // Hill-climb the number of admitted transfers: keep adding one while
+  // aggregate throughput improves, step back once it clearly drops
+  auto lastSample = std::chrono::steady_clock::now();
+  uint64_t lastBytes = 0;
+  double best = 0;
+  while (running > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    auto now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - lastSample).count();
+    if (dt < 2.0)
+      continue;
+
+    uint64_t total = bytesIn;
+    double rate = (total - lastBytes) / dt;
+    lastSample = now;
+    lastBytes = total;
+
+    if (rate > best * 1.1) {
+      best = rate;
+      if (allowed < numThreads)
+        group->setMaxInFlight(++allowed);
+    } else if (rate < best * 0.7 && allowed > 1) {
+      best = rate;
+      group->setMaxInFlight(--allowed);
+    }
+  }
 
-    if (failed)
-      return false;
+  // Wait for workers
+  workers.clear(); // std::jthread joins on destruction
+  timings_.download += downloadUs / 1e6;
+  timings_.extract += extractUs / 1e6;
+  timings_.bytesDownloaded += bytesIn;
 
-    std::vector<std::string> qtSearchPaths = {
-        (std::filesystem::path(installDir) / "Qt5").string(),
-        (std::filesystem::path(installDir) / "Plugins" / "Qt5").string()};
-
-    for (const auto &searchPath : qtSearchPaths) {
-      if (std::filesystem::exists(searchPath)) {
-        std::cout << "[RSJFW] Relocating Qt5 plugins from " << searchPath
-                  << " to root...\n";
-        for (const auto &entry :
-             std::filesystem::directory_iterator(searchPath)) {
-          std::filesystem::path target =
-              std::filesystem::path(installDir) / entry.path().filename();
-          if (std::filesystem::exists(target))
-            std::filesystem::remove_all(target);
-          std::filesystem::rename(entry.path(), target);
-        }
-        std::filesystem::remove(searchPath);
+  if (failed)
+    return false;
+
+  PackageCache::instance().trim();
+  return true;
+}
+
+void Downloader::finalizeVersion(const std::string &installDir,
+                                 VersionIndex &index) {
+  RSJFW_TRACE("Downloader::finalizeVersion");
+  auto qtStart = std::chrono::steady_clock::now();
+  std::vector<std::string> qtSearchPaths = {
+      (std::filesystem::path(installDir) / "Qt5").string(),
+      (std::filesystem::path(installDir) / "Plugins" / "Qt5").string()};
+
+  // Top-level name -> the directory it was relocated from; whatever the root
+  // held under that name before is gone
+  std::unordered_map<std::string, std::string> relocated;
+  for (const auto &searchPath : qtSearchPaths) {
+    if (std::filesystem::exists(searchPath)) {
+      std::cout << "[RSJFW] Relocating Qt5 plugins from " << searchPath
+                << " to root...\n";
+      std::string origin =
+          std::filesystem::path(searchPath)
+              .lexically_relative(installDir)
+              .generic_string() +
+          "/";
+      for (const auto &entry : std::filesystem::directory_iterator(searchPath)) {
+        std::filesystem::path target =
+            std::filesystem::path(installDir) / entry.path().filename();
+        // Only unlinks; a hard-linked file keeps its data for other versions
+        if (std::filesystem::exists(target))
+          std::filesystem::remove_all(target);
+        std::filesystem::rename(entry.path(), target);
+        relocated[entry.path().filename().string()] = origin;
       }
+      std::filesystem::remove(searchPath);
     }
+  }
 
-    // Create AppSettings.xml
-    std::filesystem::path appSettingsPath =
-        std::filesystem::path(installDir) / "AppSettings.xml";
-    std::ofstream ofs(appSettingsPath);
-    if (ofs) {
-      ofs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
-          << "<Settings>\r\n"
-          << "        <ContentFolder>content</ContentFolder>\r\n"
-          << "        <BaseUrl>http://www.roblox.com</BaseUrl>\r\n"
-          << "        <Channel>production</Channel>\r\n"
-          << "</Settings>\r\n";
+  timings_.qtRelocation += secondsSince(qtStart);
+
+  // Keep the index in step with the relocation above: moved entries lose
+  // their prefix, and entries for files that were replaced are dropped
+  std::vector<VersionIndex::Entry> kept;
+  for (auto &e : index.entries()) {
+    std::string origin;
+    for (const std::string prefix : {"Qt5/", "Plugins/Qt5/"}) {
+      if (e.path.rfind(prefix, 0) == 0) {
+        origin = prefix;
+        break;
+      }
     }
+    std::string rel = e.path.substr(origin.size());
+    auto it = relocated.find(rel.substr(0, rel.find('/')));
+    if (it == relocated.end() ? !origin.empty() : it->second != origin)
+      continue;
+    e.path = rel;
+    kept.push_back(std::move(e));
+  }
+  index.entries() = std::move(kept);
+
+  if (Config::instance().getInstaller().dedupeVersions)
+    dedupeVersion(installDir, index);
+  if (!index.save(installDir))
+    LOG_WARN("Could not write file index for " + installDir);
+
+  // Create AppSettings.xml
+  auto appSettingsStart = std::chrono::steady_clock::now();
+  std::filesystem::path appSettingsPath =
+      std::filesystem::path(installDir) / "AppSettings.xml";
+  if (std::filesystem::exists(appSettingsPath))
+    return;
+  std::ofstream ofs(appSettingsPath);
+  if (ofs) {
+    ofs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+        << "<Settings>\r\n"
+        << "        <ContentFolder>content</ContentFolder>\r\n"
+        << "        <BaseUrl>http://www.roblox.com</BaseUrl>\r\n"
+        << "        <Channel>production</Channel>\r\n"
+        << "</Settings>\r\n";
+  }
+  ofs.close();
+  timings_.appSettings += secondsSince(appSettingsStart);
+}
 
-    if (callback)
-      callback("Done", 1.0f, packages.size(), packages.size());
-    std::cout << "[RSJFW] Successfully installed version " << versionGUID
-              << "\n";
+bool Downloader::prefetchLatest() {
+  std::string latest;
+  try {
+    latest = getLatestVersionGUID();
+  } catch (const std::exception &e) {
+    LOG_WARN(std::string("Prefetch: could not check for updates: ") +
+             e.what());
+    return false;
+  }
+  if (latest.empty())
+    return false;
+
+  if (getCurrentVersion() == latest && isVersionInstalled(latest)) {
+    LOG_INFO("Prefetch: " + latest + " is already current");
     return true;
+  }
 
-  } catch (const std::exception &e) {
-    std::cerr << "[RSJFW] Error installing version: " << e.what() << "\n";
+  LOG_INFO("Prefetch: staging " + latest);
+  background_ = true;
+  bool ok = installVersion(latest);
+  background_ = false;
+  if (!ok)
+    LOG_WARN("Prefetch of " + latest + " did not finish");
+  return ok;
+}
+
+std::string Downloader::getCurrentVersion() {
+  std::error_code ec;
+  auto target = std::filesystem::read_symlink(
+      std::filesystem::path(versionsDir_) / "current", ec);
+  if (ec)
+    return "";
+  std::string version = target.filename().string();
+  return isVersionLaunchable(version) ? version : "";
+}
+
+bool Downloader::setCurrentVersion(const std::string &versionGUID) {
+  // Build the new link beside the old one and rename it over, so readers
+  // only ever see the old or the new target
+  std::filesystem::path current =
+      std::filesystem::path(versionsDir_) / "current";
+  std::filesystem::path tmp = std::filesystem::path(versionsDir_) /
+                              (".current." + std::to_string(getpid()));
+  std::error_code ec;
+  std::filesystem::remove(tmp, ec);
+  std::filesystem::create_symlink(versionGUID, tmp, ec);
+  if (!ec)
+    std::filesystem::rename(tmp, current, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+    LOG_WARN("Could not point versions/current at " + versionGUID);
     return false;
   }
+  return true;
+}
+
+void Downloader::cancelBackground() { backgroundCancelled = true; }
+
+const std::set<std::string> &Downloader::deferrablePackages() {
+  // Everything else may be read while Studio boots, so only packages known
+  // to be used later (docs, translations, the model library) are deferred
+  static const std::set<std::string> deferrable = {
+      "content-api-docs.zip", "content-qt_translations.zip",
+      "extracontent-translations.zip", "studiocontent-models.zip"};
+  return deferrable;
+}
+
+bool Downloader::isCriticalPackage(const std::string &name) {
+  return deferrablePackages().count(name) == 0;
+}
+
+size_t Downloader::bootPriority(const std::string &name) {
+  // What Studio reads first while starting, in that order
+  static const std::vector<std::string> bootOrder = {
+      "RobloxStudio.zip",      "Libraries.zip",       "LibrariesQt5.zip",
+      "redist.zip",            "shaders.zip",         "ssl.zip",
+      "ApplicationConfig.zip", "content-configs.zip", "content-fonts.zip",
+      "Plugins.zip"};
+  auto it = std::find(bootOrder.begin(), bootOrder.end(), name);
+  return it - bootOrder.begin();
+}
+
+bool Downloader::isKnownPackage(const std::string &name) {
+  return packageMap().count(name) > 0;
+}
+
+std::string Downloader::packageFile(const RobloxPackage &pkg) const {
+  auto &cache = PackageCache::instance();
+  if (cache.enabled())
+    return (PathManager::instance().packageCache() / pkg.checksum).string();
+  return (std::filesystem::path(downloadsDir_) / pkg.checksum).string();
 }
 
 bool Downloader::downloadPackage(
     const std::string &versionGUID, const RobloxPackage &pkg,
     std::function<void(size_t, size_t)> progressCb) {
-  std::string destPath =
-      (std::filesystem::path(downloadsDir_) / pkg.checksum).string();
+  RSJFW_TRACE("Downloader::downloadPackage", pkg.name);
+  std::string destPath = packageFile(pkg);
 
   if (std::filesystem::exists(destPath)) {
-    if (progressCb) {
-      size_t sz = std::filesystem::file_size(destPath);
-      progressCb(sz, sz);
+    if (Md5::sameHex(Md5::hashFile(destPath), pkg.checksum)) {
+      if (progressCb) {
+        size_t sz = std::filesystem::file_size(destPath);
+        progressCb(sz, sz);
+      }
+      return true;
     }
-    return true;
+    LOG_WARN("Stale or corrupt " + pkg.name + " on disk, downloading again");
+    std::filesystem::remove(destPath);
   }
 
-  std::string url = RobloxAPI::BASE_URL + versionGUID + "-" + pkg.name;
+  // Peers verify against the manifest checksum just like the CDN
+  if (LanPeers::instance().fetch(pkg.checksum, destPath, progressCb))
+    return true;
+
+  std::string url = RobloxAPI::baseUrl() + versionGUID + "-" + pkg.name;
   try {
-    return HTTP::download(url, destPath, progressCb);
+    return HTTP::download(url, destPath, progressCb, pkg.checksum);
   } catch (const std::exception &e) {
     std::cerr << "[RSJFW] Failed to download package " << pkg.name << ": "
               << e.what() << "\n";
@@ -289,6 +845,305 @@ bool Downloader::downloadPackage(
   }
 }
 
+bool Downloader::streamPackage(const std::string &versionGUID,
+                               const RobloxPackage &pkg,
+                               const std::string &destDir,
+                               std::function<void(size_t, size_t)> progressCb,
+                               const ZipUtil::FileCallback &onFile) {
+  RSJFW_TRACE("Downloader::streamPackage", pkg.name);
+  std::string url = RobloxAPI::baseUrl() + versionGUID + "-" + pkg.name;
+  auto &cache = PackageCache::instance();
+
+  // Tee the accepted bytes into the package store so later versions that
+  // ship the same checksum never hit the network
+  std::filesystem::path stagingPath;
+  int cacheFd = cache.enabled() ? cache.openStaging(pkg.checksum, stagingPath)
+                                : -1;
+  bool cacheOk = cacheFd >= 0;
+
+  // Remembered so a package that fails verification leaves nothing behind
+  std::vector<std::string> written;
+  auto record = [&](const ZipUtil::ExtractedFile &f) {
+    written.push_back(f.path);
+    if (onFile)
+      onFile(f);
+  };
+
+  Md5 md5;
+  bool ok = false;
+  // The source runs on the extractor's thread; keep the caller's group
+  auto group = HttpEngine::currentGroup();
+  try {
+    ok = ZipUtil::extractStream(
+        [&](const ByteSink &sink) {
+          HttpEngine::GroupScope scope(group);
+          return HTTP::stream(
+              url,
+              [&](const char *data, size_t len) {
+                SinkResult r = sink(data, len);
+                if (r == SinkResult::Ok) {
+                  md5.update(data, len);
+                  for (size_t off = 0; cacheOk && off < len;) {
+                    ssize_t n = write(cacheFd, data + off, len - off);
+                    if (n < 0 && errno == EINTR)
+                      continue;
+                    if (n <= 0)
+                      cacheOk = false;
+                    else
+                      off += static_cast<size_t>(n);
+                  }
+                }
+                return r;
+              },
+              progressCb);
+        },
+        destDir, record);
+  } catch (const std::exception &e) {
+    std::cerr << "[RSJFW] Failed to stream package " << pkg.name << ": "
+              << e.what() << "\n";
+  }
+
+  // The extractor may have stopped short of the end of the body, in which
+  // case the digest can't match either
+  if (ok && !Md5::sameHex(md5.hexdigest(), pkg.checksum)) {
+    LOG_WARN("Checksum mismatch on " + pkg.name);
+    ok = false;
+  }
+  if (!ok) {
+    std::error_code ec;
+    for (const auto &path : written)
+      std::filesystem::remove(path, ec);
+  }
+
+  if (cacheFd >= 0) {
+    if (close(cacheFd) != 0)
+      cacheOk = false;
+    if (ok && cacheOk)
+      cache.commit(pkg.checksum, stagingPath);
+    else
+      cache.discard(stagingPath);
+  }
+  return ok;
+}
+
+std::set<size_t>
+Downloader::reuseUnchangedPackages(const std::string &installDir,
+                                   const std::vector<RobloxPackage> &packages,
+                                   VersionIndex &index) {
+  std::set<size_t> reused;
+
+  // Base the delta on the most recently installed version that recorded
+  // both its manifest and its file list
+  std::filesystem::path baseDir;
+  std::filesystem::file_time_type newest{};
+  for (const auto &v : getInstalledVersions()) {
+    std::filesystem::path dir = std::filesystem::path(versionsDir_) / v;
+    std::error_code ec;
+    auto stamp = std::filesystem::last_write_time(dir / ".rsjfw_manifest", ec);
+    if (ec || !std::filesystem::exists(VersionIndex::fileFor(dir)))
+      continue;
+    if (baseDir.empty() || stamp > newest) {
+      baseDir = dir;
+      newest = stamp;
+    }
+  }
+  if (baseDir.empty())
+    return reused;
+
+  std::ifstream ifs(baseDir / ".rsjfw_manifest");
+  std::stringstream buffer;
+  buffer << ifs.rdbuf();
+  std::unordered_map<std::string, std::string> baseChecksums;
+  for (const auto &pkg : RobloxAPI::parsePackageManifest(buffer.str()))
+    baseChecksums[pkg.name] = pkg.checksum;
+
+  VersionIndex baseIndex;
+  if (!baseIndex.load(baseDir))
+    return reused;
+  std::unordered_map<std::string, std::vector<const VersionIndex::Entry *>>
+      baseFiles;
+  for (const auto &e : baseIndex.entries())
+    baseFiles[e.package].push_back(&e);
+
+  for (size_t i = 0; i < packages.size(); ++i) {
+    const auto &pkg = packages[i];
+    auto sum = baseChecksums.find(pkg.name);
+    auto files = baseFiles.find(pkg.name);
+    if (sum == baseChecksums.end() || sum->second != pkg.checksum ||
+        files == baseFiles.end())
+      continue;
+
+    bool ok = true;
+    for (const auto *e : files->second) {
+      std::filesystem::path src = baseDir / e->path;
+      std::error_code ec;
+      if (std::filesystem::file_size(src, ec) != e->size || ec ||
+          FileClone::clone(src, std::filesystem::path(installDir) / e->path,
+                           true, !isMutableVersionFile(e->path)) ==
+              FileClone::Method::None) {
+        ok = false;
+        break;
+      }
+    }
+    // A damaged base tree just means this package is fetched normally
+    if (!ok)
+      continue;
+
+    for (const auto *e : files->second)
+      index.add(*e);
+    reused.insert(i);
+  }
+
+  if (!reused.empty())
+    std::cout << "[RSJFW] Reused " << reused.size() << " of "
+              << packages.size() << " packages from "
+              << baseDir.filename().string() << "\n";
+  return reused;
+}
+
+int Downloader::verifyVersion(const std::string &versionGUID) {
+  std::filesystem::path dir = std::filesystem::path(versionsDir_) / versionGUID;
+  VersionIndex index;
+  if (!index.load(dir))
+    return -1;
+
+  std::vector<const VersionIndex::Entry *> files;
+  for (const auto &e : index.entries())
+    if (!e.md5.empty())
+      files.push_back(&e);
+  // Neighbours of similar size share a SIMD batch with little idle lane time
+  std::sort(files.begin(), files.end(),
+            [](const auto *a, const auto *b) { return a->size < b->size; });
+
+  std::atomic<size_t> next{0};
+  std::atomic<int> bad{0};
+  std::mutex outMutex;
+  auto report = [&](const VersionIndex::Entry &e, const std::string &what) {
+    std::lock_guard<std::mutex> lock(outMutex);
+    std::cout << "[RSJFW] " << what << ": " << e.path << "\n";
+    bad++;
+  };
+
+  const size_t batch = 4;
+  unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::jthread> workers;
+  for (unsigned t = 0; t < numThreads; ++t) {
+    workers.emplace_back([&]() {
+      while (true) {
+        size_t start = next.fetch_add(batch);
+        if (start >= files.size())
+          return;
+        size_t end = std::min(start + batch, files.size());
+
+        std::vector<const VersionIndex::Entry *> mapped;
+        std::vector<std::string_view> views;
+        for (size_t i = start; i < end; ++i) {
+          const auto &e = *files[i];
+          std::string path = (dir / e.path).string();
+          int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+          struct stat st;
+          if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0)
+              close(fd);
+            report(e, "Missing");
+            continue;
+          }
+          if ((uint64_t)st.st_size != e.size) {
+            close(fd);
+            report(e, "Size differs");
+            continue;
+          }
+          void *data = nullptr;
+          if (st.st_size > 0) {
+            data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+              close(fd);
+              report(e, "Unreadable");
+              continue;
+            }
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+          }
+          close(fd);
+          mapped.push_back(&e);
+          views.emplace_back(static_cast<const char *>(data), st.st_size);
+        }
+
+        auto digests = Md5::digestMany(views);
+        for (size_t i = 0; i < mapped.size(); ++i) {
+          if (!Md5::sameHex(Md5::toHex(digests[i]), mapped[i]->md5))
+            report(*mapped[i], "Modified");
+          if (!views[i].empty())
+            munmap(const_cast<char *>(views[i].data()), views[i].size());
+        }
+      }
+    });
+  }
+  workers.clear();
+
+  std::cout << "[RSJFW] Checked " << files.size() << " files in "
+            << versionGUID << ", " << bad << " problem(s)\n";
+  return bad;
+}
+
+void Downloader::dedupeVersion(const std::string &installDir,
+                               const VersionIndex &index) {
+  // Newest installs first so links point at the tree most likely to be kept
+  std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>>
+      others;
+  for (const auto &v : getInstalledVersions()) {
+    std::filesystem::path dir = std::filesystem::path(versionsDir_) / v;
+    std::error_code ec;
+    auto stamp = std::filesystem::last_write_time(VersionIndex::fileFor(dir), ec);
+    if (!ec && dir != std::filesystem::path(installDir))
+      others.emplace_back(stamp, dir);
+  }
+  if (others.empty())
+    return;
+  std::sort(others.begin(), others.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  std::unordered_map<std::string, std::filesystem::path> known;
+  for (const auto &[stamp, dir] : others) {
+    VersionIndex prev;
+    if (!prev.load(dir))
+      continue;
+    for (const auto &e : prev.entries()) {
+      if (e.md5.empty() || e.size == 0)
+        continue;
+      known.emplace(e.md5 + ":" + std::to_string(e.size), dir / e.path);
+    }
+  }
+
+  uint64_t saved = 0;
+  size_t linked = 0;
+  for (const auto &e : index.entries()) {
+    if (e.md5.empty() || e.size == 0)
+      continue;
+    auto it = known.find(e.md5 + ":" + std::to_string(e.size));
+    if (it == known.end())
+      continue;
+
+    std::filesystem::path target = std::filesystem::path(installDir) / e.path;
+    std::error_code ec;
+    if (std::filesystem::file_size(it->second, ec) != e.size || ec)
+      continue;
+    if (FileClone::sameFile(it->second, target))
+      continue;
+    // Only share storage; a plain copy would gain nothing over what is there
+    if (FileClone::clone(it->second, target, false,
+                         !isMutableVersionFile(e.path)) !=
+        FileClone::Method::None) {
+      saved += e.size;
+      linked++;
+    }
+  }
+
+  if (linked > 0)
+    LOG_INFO("Shared " + std::to_string(linked) + " files (" +
+             std::to_string(saved / (1024 * 1024)) +
+             " MiB) with other installed versions");
+}
+
 // Unified GitHub API support (v2.1)
 std::vector<Downloader::GitHubRelease>
 Downloader::fetchReleases(const std::string &repo) {
@@ -296,9 +1151,12 @@ Downloader::fetchReleases(const std::string &repo) {
   if (repo.empty() || repo == "SYSTEM" || repo == "CUSTOM_PATH")
     return releases;
 
-  std::string url = "https://api.github.com/repos/" + repo + "/releases";
+  std::string url = Mirror::enabled()
+                        ? Mirror::url("github/" + repo + "/releases.json")
+                        : "https://api.github.com/repos/" + repo + "/releases";
   try {
-    std::string response = HTTP::get(url);
+    // Unauthenticated GitHub allows 60 requests an hour, but 304s are free
+    std::string response = HTTP::getCached(url, std::chrono::minutes(10));
     auto j = nlohmann::json::parse(response);
     if (!j.is_array())
       return releases;
@@ -310,6 +1168,9 @@ Downloader::fetchReleases(const std::string &repo) {
         GitHubAsset ga;
         ga.name = asset["name"];
         ga.url = asset["browser_download_url"];
+        // Mirrors list assets relative to the repo directory
+        if (ga.url.find("://") == std::string::npos)
+          ga.url = Mirror::url("github/" + repo + "/" + ga.url);
         ga.size = asset["size"];
         release.assets.push_back(ga);
       }
@@ -330,9 +1191,17 @@ bool Downloader::validateRepo(const std::string &repo, std::string &outError) {
     return false;
   }
 
+  if (Mirror::enabled()) {
+    if (fetchReleases(repo).empty()) {
+      outError = "Repository not found in mirror";
+      return false;
+    }
+    return true;
+  }
+
   std::string url = "https://api.github.com/repos/" + repo;
   try {
-    std::string response = HTTP::get(url);
+    std::string response = HTTP::getCached(url);
     auto j = nlohmann::json::parse(response);
     if (j.contains("message") && j["message"] == "Not Found") {
       outError = "Repository not found";
@@ -453,10 +1322,69 @@ std::vector<Downloader::InstalledRoot> Downloader::getInstalledDxvkRoots() {
   return roots;
 }
 
+const std::vector<std::string> Downloader::WINE_ARCHIVES = {".tar.xz",
+                                                            ".tar.gz", ".tar"};
+const std::vector<std::string> Downloader::DXVK_ARCHIVES = {".tar.gz"};
+
+bool Downloader::resolveRelease(const std::string &repo,
+                                const std::string &version,
+                                const std::string &assetName,
+                                const std::vector<std::string> &preferences,
+                                GitHubRelease &release, GitHubAsset &asset) {
+  auto releases = fetchReleases(repo);
+  const GitHubRelease *targetRel = nullptr;
+  if (version == "latest" && !releases.empty()) {
+    targetRel = &releases[0];
+  } else {
+    for (const auto &r : releases) {
+      if (r.tag == version) {
+        targetRel = &r;
+        break;
+      }
+    }
+  }
+
+  if (!targetRel) {
+    LOG_ERROR("Version " + version + " not found in repo " + repo);
+    return false;
+  }
+  release = *targetRel;
+
+  if (!assetName.empty()) {
+    for (const auto &a : release.assets) {
+      if (a.name == assetName) {
+        asset = a;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Auto-pick asset in order of preference, skipping signatures/checksums
+  for (const auto &pref : preferences) {
+    for (const auto &a : release.assets) {
+      std::string lName = a.name;
+      for (auto &c : lName)
+        c = tolower(c);
+      if (lName.find(pref) != std::string::npos &&
+          lName.find(".sha512") == std::string::npos &&
+          lName.find(".sha256") == std::string::npos &&
+          lName.find(".asc") == std::string::npos &&
+          lName.find(".sig") == std::string::npos &&
+          lName.find(".sum") == std::string::npos) {
+        asset = a;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 bool Downloader::installWine(const std::string &repo,
                              const std::string &version,
                              const std::string &assetName,
                              ProgressCallback callback) {
+  RSJFW_TRACE("Downloader::installWine", repo + " " + version);
   auto &genCfg = Config::instance().getGeneral();
   std::filesystem::path wineDir = std::filesystem::path(rootDir_) / "wine";
 
@@ -474,53 +1402,11 @@ bool Downloader::installWine(const std::string &repo,
   } else if (repo.find("://") != std::string::npos) {
     url = repo;
   } else {
-    // Fetch from GitHub
-    auto releases = fetchReleases(repo);
-    Downloader::GitHubRelease *targetRel = nullptr;
-    if (version == "latest" && !releases.empty()) {
-      targetRel = &releases[0];
-    } else {
-      for (auto &r : releases) {
-        if (r.tag == version) {
-          targetRel = &r;
-          break;
-        }
-      }
-    }
-
-    if (!targetRel) {
-      LOG_ERROR("Version " + version + " not found in repo " + repo);
-      return false;
-    }
-
-    if (!assetName.empty()) {
-      for (auto &a : targetRel->assets) {
-        if (a.name == assetName) {
-          url = a.url;
-          break;
-        }
-      }
-    } else {
-      // Auto-pick asset: Prefer .tar.xz, then .tar.gz, then .tar
-      std::vector<std::string> preferences = {".tar.xz", ".tar.gz", ".tar"};
-      for (const auto &pref : preferences) {
-        for (auto &a : targetRel->assets) {
-          std::string lName = a.name;
-          for (auto &c : lName)
-            c = tolower(c);
-          if (lName.find(pref) != std::string::npos &&
-              lName.find(".sha512") == std::string::npos &&
-              lName.find(".asc") == std::string::npos &&
-              lName.find(".sig") == std::string::npos &&
-              lName.find(".sum") == std::string::npos) {
-            url = a.url;
-            break;
-          }
-        }
-        if (!url.empty())
-          break;
-      }
-    }
+    GitHubRelease release;
+    GitHubAsset asset;
+    if (resolveRelease(repo, version, assetName, WINE_ARCHIVES, release,
+                       asset))
+      url = asset.url;
   }
 
   if (url.empty()) {
@@ -529,73 +1415,13 @@ bool Downloader::installWine(const std::string &repo,
   }
 
   try {
-    std::string filename = url.substr(url.find_last_of('/') + 1);
-    if (filename.find('?') != std::string::npos)
-      filename = filename.substr(0, filename.find('?'));
-
-    std::filesystem::create_directories(wineDir);
-    std::filesystem::path destFile = wineDir / filename;
-
-    if (!std::filesystem::exists(destFile)) {
-      if (callback)
-        callback("Downloading " + filename + "...", 0.0f, 0, 1);
-      if (!HTTP::download(url, destFile.string(), [&](size_t cur, size_t tot) {
-            if (callback && tot > 0)
-              callback(filename, (float)cur / (float)tot, 0, 1);
-          })) {
-        throw std::runtime_error("Download failed");
-      }
-    }
-    if (callback)
-      callback("Extracting (this may take a moment)...", -1.0f, 0, 1);
-
-    std::set<std::filesystem::path> before;
-    for (const auto &entry : std::filesystem::directory_iterator(wineDir)) {
-      if (entry.is_directory())
-        before.insert(entry.path());
-    }
-
-    if (!ZipUtil::extract(destFile.string(), wineDir.string())) {
-      throw std::runtime_error("Failed to extract Wine archive");
-    }
-
-    // Find the extracted root
-    std::string extractedRoot = "";
-    for (const auto &entry : std::filesystem::directory_iterator(wineDir)) {
-      if (entry.is_directory() && before.find(entry.path()) == before.end()) {
-        std::filesystem::path bin = entry.path() / "bin/wine";
-        if (!std::filesystem::exists(bin))
-          bin = entry.path() / "files/bin/wine";
-
-        if (std::filesystem::exists(bin)) {
-          extractedRoot = entry.path().string();
-          break;
-        }
-      }
-    }
-
-    if (extractedRoot.empty()) {
-      // Fallback
-      for (const auto &entry : std::filesystem::directory_iterator(wineDir)) {
-        if (entry.is_directory()) {
-          std::filesystem::path bin = entry.path() / "bin/wine";
-          if (!std::filesystem::exists(bin))
-            bin = entry.path() / "files/bin/wine";
-          bool matches = entry.path().filename().string().find("wine-") !=
-                             std::string::npos ||
-                         entry.path().filename().string().find("kombucha-") !=
-                             std::string::npos ||
-                         entry.path().filename().string().find("GE-Proton") !=
-                             std::string::npos ||
-                         entry.path().filename().string().find(
-                             "proton-cachyos") != std::string::npos;
-          if (std::filesystem::exists(bin) && (matches || repo == "CUSTOM")) {
-            extractedRoot = entry.path().string();
-            break;
-          }
-        }
-      }
-    }
+    std::string extractedRoot = installArchive(
+        url, wineDir,
+        [](const std::filesystem::path &root) {
+          return std::filesystem::exists(root / "bin/wine") ||
+                 std::filesystem::exists(root / "files/bin/wine");
+        },
+        callback);
 
     if (!extractedRoot.empty()) {
       // Write Metadata
@@ -613,8 +1439,6 @@ bool Downloader::installWine(const std::string &repo,
 
       genCfg.wineSource.installedRoot = extractedRoot;
       Config::instance().save();
-      if (std::filesystem::exists(destFile))
-        std::filesystem::remove(destFile);
       if (callback)
         callback("Wine installed to " + extractedRoot, 1.0f, 1, 1);
       LOG_INFO("Successfully installed Wine to " + extractedRoot);
@@ -634,6 +1458,7 @@ bool Downloader::installDxvk(const std::string &repo,
                              const std::string &version,
                              const std::string &assetName,
                              ProgressCallback callback) {
+  RSJFW_TRACE("Downloader::installDxvk", repo + " " + version);
   auto &genCfg = Config::instance().getGeneral();
   std::filesystem::path dxvkDir = std::filesystem::path(rootDir_) / "dxvk";
 
@@ -651,48 +1476,11 @@ bool Downloader::installDxvk(const std::string &repo,
   } else if (repo.find("://") != std::string::npos) {
     url = repo;
   } else {
-    // Fetch from GitHub
-    auto releases = fetchReleases(repo);
-    Downloader::GitHubRelease *targetRel = nullptr;
-    if (version == "latest" && !releases.empty()) {
-      targetRel = &releases[0];
-    } else {
-      for (auto &r : releases) {
-        if (r.tag == version) {
-          targetRel = &r;
-          break;
-        }
-      }
-    }
-
-    if (!targetRel) {
-      LOG_ERROR("Version " + version + " not found in repo " + repo);
-      return false;
-    }
-
-    if (!assetName.empty()) {
-      for (auto &a : targetRel->assets) {
-        if (a.name == assetName) {
-          url = a.url;
-          break;
-        }
-      }
-    } else {
-      // Auto-pick asset: Prefer .tar.gz, avoid .sig/.asc/.sum
-      for (auto &a : targetRel->assets) {
-        std::string lName = a.name;
-        for (auto &c : lName)
-          c = tolower(c);
-        if (lName.find(".tar.gz") != std::string::npos &&
-            lName.find(".sig") == std::string::npos &&
-            lName.find(".asc") == std::string::npos &&
-            lName.find(".sum") == std::string::npos &&
-            lName.find(".sha256") == std::string::npos) {
-          url = a.url;
-          break;
-        }
-      }
-    }
+    GitHubRelease release;
+    GitHubAsset asset;
+    if (resolveRelease(repo, version, assetName, DXVK_ARCHIVES, release,
+                       asset))
+      url = asset.url;
   }
 
   if (url.empty()) {
@@ -702,60 +1490,13 @@ bool Downloader::installDxvk(const std::string &repo,
   }
 
   try {
-    std::string filename = url.substr(url.find_last_of('/') + 1);
-    std::filesystem::create_directories(dxvkDir);
-    std::filesystem::path destFile = dxvkDir / filename;
-
-    if (!std::filesystem::exists(destFile)) {
-      if (callback)
-        callback("Downloading " + filename + "...", 0.0f, 0, 1);
-      if (!HTTP::download(url, destFile.string(), [&](size_t cur, size_t tot) {
-            if (callback && tot > 0)
-              callback(filename, (float)cur / (float)tot, 0, 1);
-          })) {
-        throw std::runtime_error("Download failed");
-      }
-    }
-
-    if (callback)
-      callback("Extracting (this may take a moment)...", -1.0f, 0, 1);
-
-    // Track directories before extraction
-    std::set<std::filesystem::path> before;
-    for (const auto &entry : std::filesystem::directory_iterator(dxvkDir)) {
-      if (entry.is_directory())
-        before.insert(entry.path());
-    }
-
-    if (!ZipUtil::extract(destFile.string(), dxvkDir.string())) {
-      throw std::runtime_error("Failed to extract DXVK archive");
-    }
-
-    // Find the newly extracted root
-    std::string extractedRoot = "";
-    for (const auto &entry : std::filesystem::directory_iterator(dxvkDir)) {
-      if (entry.is_directory() && before.find(entry.path()) == before.end()) {
-        if (std::filesystem::exists(entry.path() / "x64") ||
-            std::filesystem::exists(entry.path() / "x86")) {
-          extractedRoot = entry.path().string();
-          break;
-        }
-      }
-    }
-
-    // Fallback: If no new directory found, look for ANY matching one (might
-    // happen if we re-extract over same folder)
-    if (extractedRoot.empty()) {
-      for (const auto &entry : std::filesystem::directory_iterator(dxvkDir)) {
-        if (entry.is_directory()) {
-          if (std::filesystem::exists(entry.path() / "x64") ||
-              std::filesystem::exists(entry.path() / "x86")) {
-            extractedRoot = entry.path().string();
-            break;
-          }
-        }
-      }
-    }
+    std::string extractedRoot = installArchive(
+        url, dxvkDir,
+        [](const std::filesystem::path &root) {
+          return std::filesystem::exists(root / "x64") ||
+                 std::filesystem::exists(root / "x86");
+        },
+        callback);
 
     if (!extractedRoot.empty()) {
       // Write Metadata
@@ -774,7 +1515,6 @@ bool Downloader::installDxvk(const std::string &repo,
       genCfg.dxvkSource.installedRoot =
           extractedRoot; // Standardize on dxvkRoot
       Config::instance().save();
-      std::filesystem::remove(destFile);
       LOG_INFO("Successfully installed DXVK to " + extractedRoot);
       if (callback)
         callback("DXVK installed to " + extractedRoot, 1.0f, 1, 1);
@@ -789,5 +1529,101 @@ bool Downloader::installDxvk(const std::string &repo,
   return false;
 }
 
+std::string Downloader::installArchive(
+    const std::string &url, const std::filesystem::path &parentDir,
+    const std::function<bool(const std::filesystem::path &)> &isRoot,
+    ProgressCallback callback) {
+  std::string filename = url.substr(url.find_last_of('/') + 1);
+  if (filename.find('?') != std::string::npos)
+    filename = filename.substr(0, filename.find('?'));
+
+  std::filesystem::create_directories(parentDir);
+  std::filesystem::path staging = parentDir / (".staging-" + filename);
+  std::filesystem::remove_all(staging);
+  std::filesystem::create_directories(staging);
+
+  auto progress = [&](size_t cur, size_t tot) {
+    if (callback && tot > 0)
+      callback(filename, (float)cur / (float)tot, 0, 1);
+  };
+
+  bool extracted = false;
+  if (Config::instance().getInstaller().streamExtract) {
+    if (callback)
+      callback("Downloading " + filename + "...", 0.0f, 0, 1);
+    extracted = ZipUtil::extractStream(
+        [&](const ByteSink &sink) { return HTTP::stream(url, sink, progress); },
+        staging.string());
+    if (!extracted) {
+      LOG_WARN("Streaming install of " + filename +
+               " failed, falling back to full download");
+      std::filesystem::remove_all(staging);
+      std::filesystem::create_directories(staging);
+    }
+  }
+
+  if (!extracted) {
+    std::filesystem::path destFile = parentDir / filename;
+    if (!std::filesystem::exists(destFile)) {
+      if (callback)
+        callback("Downloading " + filename + "...", 0.0f, 0, 1);
+      if (!HTTP::downloadSegmented(
+              url, destFile.string(),
+              Config::instance().getInstaller().downloadSegments, progress)) {
+        std::filesystem::remove_all(staging);
+        throw std::runtime_error("Download failed");
+      }
+    }
+    if (callback)
+      callback("Extracting (this may take a moment)...", -1.0f, 0, 1);
+    extracted = ZipUtil::extract(destFile.string(), staging.string());
+    std::filesystem::remove(destFile);
+    if (!extracted) {
+      std::filesystem::remove_all(staging);
+      throw std::runtime_error("Failed to extract " + filename);
+    }
+  }
+
+  // Release tarballs wrap everything in one directory named after the build;
+  // flat archives are named after the file instead
+  std::vector<std::filesystem::path> top;
+  for (const auto &entry : std::filesystem::directory_iterator(staging))
+    top.push_back(entry.path());
+
+  std::filesystem::path source = staging;
+  std::string name = filename;
+  for (const std::string ext : {".tar.xz", ".tar.gz", ".tar.zst", ".tgz",
+                                ".tar", ".zip"}) {
+    if (name.size() > ext.size() &&
+        name.compare(name.size() - ext.size(), ext.size(), ext) == 0) {
+      name.erase(name.size() - ext.size());
+      break;
+    }
+  }
+  if (top.size() == 1 && std::filesystem::is_directory(top[0])) {
+    source = top[0];
+    name = top[0].filename().string();
+  }
+
+  if (!isRoot(source)) {
+    LOG_ERROR(filename + " does not contain a usable root");
+    std::filesystem::remove_all(staging);
+    return "";
+  }
+
+  // Move any previous copy aside first so the target path never holds a
+  // half-replaced tree
+  std::filesystem::path target = parentDir / name;
+  std::filesystem::path previous = parentDir / (".old-" + name);
+  std::filesystem::remove_all(previous);
+  if (std::filesystem::exists(target))
+    std::filesystem::rename(target, previous);
+  std::filesystem::rename(source, target);
+  std::filesystem::remove_all(previous);
+  std::filesystem::remove_all(staging);
+
+  return target.string();
+}
+
 // DELETED fetchWineVersions and fetchDxvkVersions
 } // namespace rsjfw
@@ -1,4 +1,5 @@
 #include "rsjfw/dxvk.hpp"
+#include "rsjfw/file_clone.hpp"
 #include "rsjfw/logger.hpp"
 #include <filesystem>
 #include <cstdlib>
@@ -20,11 +21,13 @@ bool install(wine::Prefix& pfx, const std::string& dxvkRootDir) {
         fs::create_directories(destDir);
         for (const auto& entry : fs::directory_iterator(sourceDir)) {
             if (entry.path().extension() == ".dll") {
-                try {
-                    fs::copy_file(entry.path(), destDir / entry.path().filename(), fs::copy_options::overwrite_existing);
+                // Replaced by rename rather than rewritten: the old file may
+                // be hard-linked into a prefix template
+                if (FileClone::clone(entry.path(), destDir / entry.path().filename(), true, false) !=
+                    FileClone::Method::None) {
                     LOG_INFO("Installed " + entry.path().filename().string() + " to " + destDir.string());
-                } catch (const std::exception& e) {
-                    LOG_ERROR("Failed to copy DLL: " + std::string(e.what()));
+                } else {
+                    LOG_ERROR("Failed to copy DLL: " + entry.path().string());
                 }
             }
         }
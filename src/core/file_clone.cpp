@@ -0,0 +1,80 @@
+#include "rsjfw/file_clone.hpp"
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rsjfw {
+
+static bool reflink(const std::filesystem::path &src,
+                    const std::filesystem::path &dst) {
+  int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(in, &st) != 0) {
+    close(in);
+    return false;
+  }
+
+  int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                 st.st_mode & 07777);
+  if (out < 0) {
+    close(in);
+    return false;
+  }
+
+  bool ok = ioctl(out, FICLONE, in) == 0;
+  close(out);
+  close(in);
+  if (!ok)
+    unlink(dst.c_str());
+  return ok;
+}
+
+FileClone::Method FileClone::clone(const std::filesystem::path &src,
+                                   const std::filesystem::path &dst,
+                                   bool allowCopy, bool allowHardlink) {
+  if (allowHardlink && sameFile(src, dst))
+    return Method::Hardlink;
+
+  // Build next to the destination, then rename over it so readers never see
+  // a half-written file
+  std::filesystem::path tmp = dst;
+  tmp += ".rsjfw-clone";
+  std::error_code ec;
+  std::filesystem::remove(tmp, ec);
+  if (dst.has_parent_path())
+    std::filesystem::create_directories(dst.parent_path(), ec);
+
+  Method method = Method::None;
+  if (reflink(src, tmp)) {
+    method = Method::Reflink;
+  } else if (allowHardlink && link(src.c_str(), tmp.c_str()) == 0) {
+    method = Method::Hardlink;
+  } else if (allowCopy &&
+             std::filesystem::copy_file(src, tmp, ec) && !ec) {
+    method = Method::Copy;
+  }
+
+  if (method == Method::None)
+    return Method::None;
+
+  if (rename(tmp.c_str(), dst.c_str()) != 0) {
+    std::filesystem::remove(tmp, ec);
+    return Method::None;
+  }
+  return method;
+}
+
+bool FileClone::sameFile(const std::filesystem::path &a,
+                         const std::filesystem::path &b) {
+  struct stat sa, sb;
+  if (stat(a.c_str(), &sa) != 0 || stat(b.c_str(), &sb) != 0)
+    return false;
+  return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+} // namespace rsjfw
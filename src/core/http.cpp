@@ -1,99 +1,473 @@
 #include "rsjfw/http.hpp"
+#include "rsjfw/config.hpp"
+#include "rsjfw/http_engine.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/path_manager.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace rsjfw {
 
-size_t HTTP::writeCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    userp->append((char*)contents, size * nmemb);
-    return size * nmemb;
+std::string HTTP::get(const std::string& url) {
+    std::string response;
+
+    HttpEngine::Request req;
+    req.url = url;
+    req.failOnError = false; // Callers inspect API error bodies themselves
+    req.sink = [&](const char* data, size_t len) {
+        response.append(data, len);
+        return SinkResult::Ok;
+    };
+
+    auto res = HttpEngine::instance().perform(std::move(req));
+    if (!res.ok) {
+        throw std::runtime_error("cURL request failed: " + res.error);
+    }
+    return response;
 }
 
-std::string HTTP::get(const std::string& url) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize cURL");
+namespace {
+
+// Status and validators of the final response (redirects reset them)
+struct ResponseHeaders {
+    long status = 0;
+    std::string etag;
+    std::string lastModified;
+
+    void onLine(const std::string& line) {
+        if (line.rfind("HTTP/", 0) == 0) {
+            *this = {};
+            auto sp = line.find(' ');
+            if (sp != std::string::npos) status = std::strtol(line.c_str() + sp + 1, nullptr, 10);
+            return;
+        }
+        auto colon = line.find(':');
+        if (colon == std::string::npos) return;
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        if (name == "etag") etag = value;
+        else if (name == "last-modified") lastModified = value;
     }
 
-    std::string response;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36");
+    // Value usable in If-Range; weak ETags aren't allowed there
+    std::string validator() const {
+        if (!etag.empty() && etag.rfind("W/", 0) != 0) return etag;
+        return lastModified;
+    }
+};
+
+bool retriable(const HttpEngine::Response& res) {
+    if (res.code == CURLE_HTTP_RETURNED_ERROR)
+        return res.status == 408 || res.status == 429 || res.status >= 500;
+    return res.code != CURLE_OK && res.code != CURLE_FAILED_INIT &&
+           res.code != CURLE_UNSUPPORTED_PROTOCOL && res.code != CURLE_URL_MALFORMAT &&
+           res.code != CURLE_FILE_COULDNT_READ_FILE && res.code != CURLE_REMOTE_FILE_NOT_FOUND;
+}
+
+int attemptBudget() {
+    return 1 + std::max(0, Config::instance().getInstaller().downloadRetries);
+}
+
+void backoff(int attempt, const std::string& url) {
+    auto delay = std::chrono::seconds(std::min(30, 1 << std::min(attempt - 1, 5)));
+    LOG_WARN("Retrying " + url + " in " + std::to_string(delay.count()) + "s (attempt " +
+             std::to_string(attempt + 1) + ")");
+    std::this_thread::sleep_for(delay);
+}
+
+// <file>.part.meta remembers which resource a partial file belongs to
+std::string readMeta(const std::string& metaPath, const std::string& url) {
+    std::ifstream ifs(metaPath);
+    std::string metaUrl, validator;
+    if (!std::getline(ifs, metaUrl) || !std::getline(ifs, validator) || metaUrl != url) return "";
+    return validator;
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        curl_easy_cleanup(curl);
-        throw std::runtime_error("cURL request failed: " + std::string(curl_easy_strerror(res)));
+void writeMeta(const std::string& metaPath, const std::string& url, const std::string& validator) {
+    if (validator.empty()) {
+        std::filesystem::remove(metaPath);
+        return;
     }
+    std::ofstream(metaPath, std::ios::trunc) << url << "\n" << validator << "\n";
+}
 
-    curl_easy_cleanup(curl);
-    return response;
+bool hashPrefix(const std::string& path, uint64_t length, Md5& md5) {
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<char> buffer(1 << 20);
+    while (length > 0 && ifs) {
+        ifs.read(buffer.data(), std::min<uint64_t>(buffer.size(), length));
+        md5.update(buffer.data(), static_cast<size_t>(ifs.gcount()));
+        length -= ifs.gcount();
+    }
+    return length == 0;
 }
 
-struct ProgressData {
-    HTTP::ProgressCallback callback;
-};
+std::filesystem::path cacheEntryPath(const std::string& url) {
+    Md5 key;
+    key.update(url.data(), url.size());
+    return PathManager::instance().httpCache() / (key.hexdigest() + ".json");
+}
+
+void writeCacheEntry(const std::filesystem::path& path, const nlohmann::json& entry) {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    // Written aside and renamed so concurrent readers never see half an entry
+    std::filesystem::path tmp = path.string() + "." + std::to_string(getpid()) + "-" +
+                                std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream ofs(tmp, std::ios::trunc);
+        ofs << entry.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        if (!ofs) return;
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) std::filesystem::remove(tmp, ec);
+}
+
+} // namespace
+
+std::string HTTP::getCached(const std::string& url, std::chrono::seconds maxAge) {
+    std::filesystem::path entryPath = cacheEntryPath(url);
+    const int64_t now =
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
 
-size_t HTTP::fileWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    std::ofstream* ofs = static_cast<std::ofstream*>(userp);
-    size_t totalSize = size * nmemb;
-    ofs->write(static_cast<char*>(contents), totalSize);
-    return totalSize;
+    nlohmann::json entry;
+    {
+        std::ifstream ifs(entryPath);
+        if (ifs) entry = nlohmann::json::parse(ifs, nullptr, false);
+    }
+    bool cached = entry.is_object() && entry.value("url", "") == url && entry.contains("body");
+    if (cached && now - entry.value("fetched", int64_t(0)) < maxAge.count()) return entry["body"];
+
+    std::string body;
+    ResponseHeaders headers;
+    HttpEngine::Request req;
+    req.url = url;
+    req.failOnError = false;
+    if (cached) {
+        std::string etag = entry.value("etag", "");
+        std::string lastModified = entry.value("last_modified", "");
+        if (!etag.empty()) req.headers.push_back("If-None-Match: " + etag);
+        if (!lastModified.empty()) req.headers.push_back("If-Modified-Since: " + lastModified);
+    }
+    req.header = [&](const std::string& line) { headers.onLine(line); };
+    req.sink = [&](const char* data, size_t len) {
+        body.append(data, len);
+        return SinkResult::Ok;
+    };
+
+    auto res = HttpEngine::instance().perform(std::move(req));
+    if (cached) {
+        if (res.ok && res.status == 304) {
+            entry["fetched"] = now;
+            writeCacheEntry(entryPath, entry);
+            return entry["body"];
+        }
+        if (!res.ok || res.status == 403 || res.status == 429 || res.status >= 500) {
+            LOG_WARN("Serving cached " + url + " (" + (res.ok ? "HTTP " + std::to_string(res.status) : res.error) +
+                     ")");
+            return entry["body"];
+        }
+    }
+    if (!res.ok) {
+        throw std::runtime_error("cURL request failed: " + res.error);
+    }
+
+    if (res.status == 200) {
+        writeCacheEntry(entryPath, {{"url", url},
+                                    {"etag", headers.etag},
+                                    {"last_modified", headers.lastModified},
+                                    {"fetched", now},
+                                    {"body", body}});
+    }
+    return body;
 }
 
-int HTTP::progressCallback(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow) {
-    ProgressData* data = static_cast<ProgressData*>(clientp);
-    if (data && data->callback && dltotal > 0) {
-        data->callback(static_cast<size_t>(dlnow), static_cast<size_t>(dltotal));
+bool HTTP::download(const std::string& url, const std::string& filepath, ProgressCallback callback,
+                    const std::string& expectedMd5, bool retry) {
+    std::string partPath = filepath + ".part";
+    std::string metaPath = partPath + ".meta";
+    const int attempts = retry ? attemptBudget() : 1;
+
+    HttpEngine::Response res;
+    for (int attempt = 0; attempt < attempts; ++attempt) {
+        if (attempt > 0) backoff(attempt, url);
+
+        // Pick up where an earlier attempt, or an earlier run, left off
+        std::error_code ec;
+        std::string ifRange = readMeta(metaPath, url);
+        uint64_t offset = ifRange.empty() ? 0 : std::filesystem::file_size(partPath, ec);
+        if (ec) offset = 0;
+
+        Md5 md5;
+        if (offset > 0 && !expectedMd5.empty() && !hashPrefix(partPath, offset, md5)) {
+            offset = 0;
+            md5 = Md5();
+        }
+
+        std::ofstream ofs;
+        ResponseHeaders headers;
+        bool started = false;
+        bool sinkFailed = false;
+        uint64_t base = offset;
+
+        HttpEngine::Request req;
+        req.url = url;
+        if (offset > 0) {
+            req.range = std::to_string(offset) + "-";
+            req.headers.push_back("If-Range: " + ifRange);
+        }
+        req.header = [&](const std::string& line) { headers.onLine(line); };
+        if (callback) {
+            req.progress = [&](size_t cur, size_t tot) { callback(cur + base, tot + base); };
+        }
+        req.sink = [&](const char* data, size_t len) {
+            if (!started) {
+                started = true;
+                // A 200 means the resource changed (or ranges are unsupported)
+                bool resumed = offset > 0 && headers.status == 206;
+                if (!resumed) {
+                    base = 0;
+                    md5 = Md5();
+                }
+                ofs.open(partPath, std::ios::binary | (resumed ? std::ios::app : std::ios::trunc));
+                writeMeta(metaPath, url, headers.validator());
+            }
+            ofs.write(data, len);
+            if (!expectedMd5.empty()) md5.update(data, len);
+            if (!ofs) {
+                sinkFailed = true;
+                return SinkResult::Abort;
+            }
+            return SinkResult::Ok;
+        };
+
+        res = HttpEngine::instance().perform(std::move(req));
+        ofs.close();
+
+        if (res.ok) {
+            if (!started && offset == 0) std::ofstream(partPath, std::ios::trunc);
+
+            if (!expectedMd5.empty()) {
+                std::string actual = md5.hexdigest();
+                if (!Md5::sameHex(actual, expectedMd5)) {
+                    res.ok = false;
+                    res.error = "checksum mismatch (got " + actual + ", expected " + expectedMd5 + ")";
+                    std::filesystem::remove(partPath, ec);
+                    std::filesystem::remove(metaPath, ec);
+                    continue;
+                }
+            }
+
+            try {
+                if (std::filesystem::exists(filepath)) std::filesystem::remove(filepath);
+                std::filesystem::rename(partPath, filepath);
+                std::filesystem::remove(metaPath, ec);
+                return true;
+            } catch (...) {
+                return false;
+            }
+        }
+
+        if (res.status == 416) {
+            // Our partial file no longer lines up with the resource
+            std::filesystem::remove(partPath, ec);
+            std::filesystem::remove(metaPath, ec);
+            continue;
+        }
+        if (sinkFailed || !retriable(res)) break;
     }
-    return 0;
+
+    // The .part stays behind so the next call can resume it
+    std::cerr << "[RSJFW] Download of " << url << " failed: " << res.error << "\n";
+    return false;
 }
 
-bool HTTP::download(const std::string& url, const std::string& filepath, ProgressCallback callback) {
-    CURL* curl = curl_easy_init();
-    if (!curl) return false;
+// Below this, a single transfer finishes before extra connections pay off
+static constexpr curl_off_t kSegmentMinSize = 16 * 1024 * 1024;
+
+bool HTTP::downloadSegmented(const std::string& url, const std::string& filepath, int segments,
+                             ProgressCallback callback) {
+    ResponseHeaders probe;
+    bool acceptRanges = false;
+    HttpEngine::Request head;
+    head.url = url;
+    head.noBody = true;
+    head.header = [&](const std::string& line) {
+        if (line.rfind("HTTP/", 0) == 0) acceptRanges = false;
+        probe.onLine(line);
+        std::string lower = line;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.rfind("accept-ranges:", 0) == 0 && lower.find("bytes") != std::string::npos)
+            acceptRanges = true;
+    };
+    auto info = HttpEngine::instance().perform(std::move(head));
+
+    curl_off_t length = info.contentLength;
+    if (!info.ok || !acceptRanges || segments <= 1 || length < kSegmentMinSize) {
+        return download(url, filepath, callback);
+    }
 
     std::string partPath = filepath + ".part";
-    std::ofstream ofs(partPath, std::ios::binary);
-    if (!ofs) {
-        curl_easy_cleanup(curl);
+    int fd = open(partPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    // Reserve the whole file up front so segments land in contiguous extents
+    if (fallocate(fd, 0, 0, length) != 0 && ftruncate(fd, length) != 0) {
+        close(fd);
+        std::filesystem::remove(partPath);
         return false;
     }
 
-    ProgressData data{callback};
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fileWriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ofs);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36");
-    
-    if (callback) {
-        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-        curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progressCallback);
-        curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, &data);
-    }
-
-    CURLcode res = curl_easy_perform(curl);
-    ofs.close();
-    curl_easy_cleanup(curl);
-    
-    if (res == CURLE_OK) {
-        try {
-            if (std::filesystem::exists(filepath)) std::filesystem::remove(filepath);
-            std::filesystem::rename(partPath, filepath);
-            return true;
-        } catch (...) {
-            return false;
+    struct Segment {
+        curl_off_t next;
+        curl_off_t end; // Inclusive
+    };
+    std::vector<Segment> parts;
+    curl_off_t chunk = (length + segments - 1) / segments;
+    for (curl_off_t start = 0; start < length; start += chunk)
+        parts.push_back({start, std::min(start + chunk, length) - 1});
+
+    std::atomic<curl_off_t> received{0};
+    std::atomic<bool> mismatch{false};
+    std::mutex progressMutex;
+    const std::string validator = probe.validator();
+    const int attempts = attemptBudget();
+
+    std::string lastError;
+    for (int attempt = 0; attempt < attempts && !mismatch; ++attempt) {
+        std::vector<Segment*> pending;
+        for (auto& p : parts)
+            if (p.next <= p.end) pending.push_back(&p);
+        if (pending.empty()) break;
+        if (attempt > 0) backoff(attempt, url);
+
+        std::vector<std::future<HttpEngine::Response>> futures;
+        std::vector<std::unique_ptr<ResponseHeaders>> headers;
+        for (auto* seg : pending) {
+            headers.push_back(std::make_unique<ResponseHeaders>());
+            ResponseHeaders* h = headers.back().get();
+
+            HttpEngine::Request req;
+            req.url = url;
+            req.ownConnection = true;
+            req.range = std::to_string(seg->next) + "-" + std::to_string(seg->end);
+            if (!validator.empty()) req.headers.push_back("If-Range: " + validator);
+            req.header = [h](const std::string& line) { h->onLine(line); };
+            req.sink = [&, seg, h](const char* data, size_t len) {
+                // A full body instead of our slice means the file changed
+                if (mismatch || h->status != 206 || seg->next + (curl_off_t)len > seg->end + 1) {
+                    mismatch = true;
+                    return SinkResult::Abort;
+                }
+                size_t done = 0;
+                while (done < len) {
+                    ssize_t n = pwrite(fd, data + done, len - done, seg->next + done);
+                    if (n < 0) {
+                        if (errno == EINTR) continue;
+                        return SinkResult::Abort;
+                    }
+                    done += n;
+                }
+                seg->next += len;
+                curl_off_t total = received += len;
+                if (callback) {
+                    std::lock_guard<std::mutex> lock(progressMutex);
+                    callback(total, length);
+                }
+                return SinkResult::Ok;
+            };
+            futures.push_back(HttpEngine::instance().submit(std::move(req)));
+        }
+
+        for (auto& f : futures) {
+            auto res = f.get();
+            if (!res.ok) lastError = res.error;
         }
-    } else {
+    }
+
+    bool complete = !mismatch && std::all_of(parts.begin(), parts.end(),
+                                             [](const Segment& p) { return p.next > p.end; });
+    close(fd);
+
+    if (!complete) {
         std::filesystem::remove(partPath);
+        if (mismatch) {
+            LOG_WARN("Segmented download of " + url + " lost its range, retrying as one stream");
+            return download(url, filepath, callback);
+        }
+        std::cerr << "[RSJFW] Download of " << url << " failed: " << lastError << "\n";
         return false;
     }
+
+    std::error_code ec;
+    std::filesystem::remove(filepath, ec);
+    std::filesystem::rename(partPath, filepath, ec);
+    return !ec;
+}
+
+bool HTTP::stream(const std::string& url, ByteSink sink, ProgressCallback callback) {
+    const int attempts = attemptBudget();
+    uint64_t delivered = 0;
+    std::string validator;
+    bool sinkAborted = false;
+
+    HttpEngine::Response res;
+    for (int attempt = 0; attempt < attempts; ++attempt) {
+        if (attempt > 0) backoff(attempt, url);
+
+        ResponseHeaders headers;
+        bool started = false;
+        uint64_t base = delivered;
+
+        HttpEngine::Request req;
+        req.url = url;
+        if (delivered > 0) {
+            req.range = std::to_string(delivered) + "-";
+            req.headers.push_back("If-Range: " + validator);
+        }
+        req.header = [&](const std::string& line) { headers.onLine(line); };
+        if (callback) {
+            req.progress = [&](size_t cur, size_t tot) { callback(cur + base, tot + base); };
+        }
+        req.sink = [&](const char* data, size_t len) {
+            if (!started) {
+                started = true;
+                // Bytes already handed out can't be taken back, so only an
+                // exact continuation is acceptable
+                if (delivered > 0 && headers.status != 206) {
+                    sinkAborted = true;
+                    return SinkResult::Abort;
+                }
+                if (delivered == 0) validator = headers.validator();
+            }
+            SinkResult r = sink(data, len);
+            if (r == SinkResult::Ok) delivered += len;
+            if (r == SinkResult::Abort) sinkAborted = true;
+            return r;
+        };
+
+        res = HttpEngine::instance().perform(std::move(req));
+        if (res.ok) return true;
+        if (sinkAborted || !retriable(res) || (delivered > 0 && validator.empty())) break;
+    }
+
+    std::cerr << "[RSJFW] Stream of " << url << " failed: " << res.error << "\n";
+    return false;
 }
 
 } // namespace rsjfw
@@ -0,0 +1,338 @@
+#include "rsjfw/http_engine.hpp"
+#include <algorithm>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace rsjfw {
+
+static const char *USER_AGENT =
+    "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, "
+    "like Gecko) Chrome/120.0.0.0 Safari/537.36";
+
+static thread_local std::shared_ptr<HttpEngine::Group> currentGroup_;
+
+HttpEngine &HttpEngine::instance() {
+  static HttpEngine instance;
+  return instance;
+}
+
+HttpEngine::HttpEngine() {
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  share_ = curl_share_init();
+  curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lockShare);
+  curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlockShare);
+  curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+  multi_ = curl_multi_init();
+  curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, 8L);
+
+  worker_ = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+HttpEngine::~HttpEngine() {
+  worker_.request_stop();
+  curl_multi_wakeup(multi_);
+  if (worker_.joinable())
+    worker_.join();
+
+  curl_multi_cleanup(multi_);
+  curl_share_cleanup(share_);
+}
+
+void HttpEngine::lockShare(CURL *, curl_lock_data data, curl_lock_access,
+                           void *userp) {
+  static_cast<HttpEngine *>(userp)->shareLocks_[data].lock();
+}
+
+void HttpEngine::unlockShare(CURL *, curl_lock_data data, void *userp) {
+  static_cast<HttpEngine *>(userp)->shareLocks_[data].unlock();
+}
+
+std::future<HttpEngine::Response> HttpEngine::submit(Request req) {
+  auto t = std::make_unique<Transfer>();
+  t->engine = this;
+  t->req = std::move(req);
+  if (!t->req.group)
+    t->req.group = currentGroup_;
+  auto future = t->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(t));
+  }
+  curl_multi_wakeup(multi_);
+  return future;
+}
+
+void HttpEngine::setMaxInFlight(size_t limit) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxInFlight_ = std::max<size_t>(1, limit);
+  }
+  curl_multi_wakeup(multi_);
+}
+
+void HttpEngine::wake() { curl_multi_wakeup(multi_); }
+
+void HttpEngine::Group::setMaxInFlight(size_t limit) {
+  maxInFlight_ = limit;
+  HttpEngine::instance().wake();
+}
+
+void HttpEngine::Group::setBandwidthLimit(uint64_t bytesPerSecond) {
+  bandwidthLimit_ = bytesPerSecond;
+}
+
+bool HttpEngine::Group::takeTokens(size_t bytes) {
+  uint64_t limit = bandwidthLimit_;
+  if (limit == 0)
+    return true;
+
+  auto now = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double>(now - lastRefill_).count();
+  lastRefill_ = now;
+  // Allow at most a second of burst, but never less than one write chunk
+  double cap = std::max<double>(limit, CURL_MAX_WRITE_SIZE);
+  tokens_ = std::min(cap, tokens_ + elapsed * limit);
+  if (tokens_ <= 0)
+    return false;
+  tokens_ -= bytes;
+  return true;
+}
+
+HttpEngine::GroupScope::GroupScope(std::shared_ptr<Group> group)
+    : previous_(std::move(currentGroup_)) {
+  currentGroup_ = std::move(group);
+}
+
+HttpEngine::GroupScope::~GroupScope() { currentGroup_ = std::move(previous_); }
+
+std::shared_ptr<HttpEngine::Group> HttpEngine::currentGroup() {
+  return currentGroup_;
+}
+
+// Sinks write to disk on this thread, so a background group's writes are
+// issued at idle I/O priority and everyone else's at the default
+void HttpEngine::setIoIdle(bool idle) {
+  if (idle == ioIdle_)
+    return;
+  ioIdle_ = idle;
+  syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0,
+          idle ? 3 << 13 /* IOPRIO_CLASS_IDLE */
+               : 0 /* IOPRIO_CLASS_NONE: follow the CPU nice level */);
+}
+
+size_t HttpEngine::writeCallback(char *data, size_t size, size_t nmemb,
+                                 void *userp) {
+  auto *t = static_cast<Transfer *>(userp);
+  size_t total = size * nmemb;
+  Group *group = t->req.group.get();
+
+  // Over budget: pause like a full sink and let the loop retry shortly
+  if (group && !group->takeTokens(total)) {
+    t->paused = true;
+    return CURL_WRITEFUNC_PAUSE;
+  }
+  if (!t->req.sink)
+    return total;
+
+  t->engine->setIoIdle(group && group->background_);
+  switch (t->req.sink(data, total)) {
+  case SinkResult::Ok:
+    return total;
+  case SinkResult::Full:
+    // cURL hands the same chunk back once the transfer is unpaused
+    if (group && group->bandwidthLimit_ > 0)
+      group->tokens_ += total;
+    t->paused = true;
+    return CURL_WRITEFUNC_PAUSE;
+  case SinkResult::Abort:
+  default:
+    t->aborted = true;
+    return 0;
+  }
+}
+
+size_t HttpEngine::headerCallback(char *data, size_t size, size_t nmemb,
+                                  void *userp) {
+  auto *t = static_cast<Transfer *>(userp);
+  size_t total = size * nmemb;
+  if (t->req.header) {
+    std::string line(data, total);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+      line.pop_back();
+    t->req.header(line);
+  }
+  return total;
+}
+
+int HttpEngine::progressCallback(void *clientp, curl_off_t dltotal,
+                                 curl_off_t dlnow, curl_off_t, curl_off_t) {
+  auto *t = static_cast<Transfer *>(clientp);
+  if (t->req.progress && dltotal > 0)
+    t->req.progress(static_cast<size_t>(dlnow), static_cast<size_t>(dltotal));
+  return 0;
+}
+
+CURL *HttpEngine::createHandle(Transfer &t) {
+  CURL *easy = curl_easy_init();
+  if (!easy)
+    return nullptr;
+
+  curl_easy_setopt(easy, CURLOPT_URL, t.req.url.c_str());
+  curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+  curl_easy_setopt(easy, CURLOPT_PRIVATE, &t);
+  curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, t.errorBuf);
+  curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(easy, CURLOPT_USERAGENT, USER_AGENT);
+  if (t.req.ownConnection) {
+    // Servers throttle per connection, so parallel segments of one file must
+    // not end up as streams on the same one
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  } else {
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    // Wait for an existing connection to offer a free stream instead of
+    // opening a new one
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+  }
+  curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, writeCallback);
+  curl_easy_setopt(easy, CURLOPT_WRITEDATA, &t);
+  curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, headerCallback);
+  curl_easy_setopt(easy, CURLOPT_HEADERDATA, &t);
+
+  if (t.req.failOnError)
+    curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1L);
+  if (t.req.noBody)
+    curl_easy_setopt(easy, CURLOPT_NOBODY, 1L);
+  if (!t.req.range.empty())
+    curl_easy_setopt(easy, CURLOPT_RANGE, t.req.range.c_str());
+  if (t.req.connectTimeoutMs > 0)
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, t.req.connectTimeoutMs);
+
+  for (const auto &h : t.req.headers)
+    t.headerList = curl_slist_append(t.headerList, h.c_str());
+  if (t.headerList)
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, t.headerList);
+
+  if (t.req.progress) {
+    curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION, progressCallback);
+    curl_easy_setopt(easy, CURLOPT_XFERINFODATA, &t);
+  }
+
+  return easy;
+}
+
+void HttpEngine::attachPending() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = pending_.begin();
+       it != pending_.end() && active_.size() < maxInFlight_;) {
+    // A group at its own cap waits without holding up other requests
+    Group *group = (*it)->req.group.get();
+    size_t groupCap = group ? group->maxInFlight_.load() : 0;
+    if (groupCap > 0 && group->active_ >= groupCap) {
+      ++it;
+      continue;
+    }
+    auto t = std::move(*it);
+    it = pending_.erase(it);
+
+    CURL *easy = createHandle(*t);
+    if (!easy) {
+      Response res;
+      res.code = CURLE_FAILED_INIT;
+      res.error = "Failed to initialize cURL";
+      t->promise.set_value(res);
+      continue;
+    }
+    t->easy = easy;
+    if (group)
+      group->active_++;
+    curl_multi_add_handle(multi_, easy);
+    active_.emplace(easy, std::move(t));
+  }
+}
+
+void HttpEngine::resumePaused() {
+  for (auto &[easy, t] : active_) {
+    if (t->paused) {
+      t->paused = false;
+      // May re-enter writeCallback right away and pause again
+      curl_easy_pause(easy, CURLPAUSE_CONT);
+    }
+  }
+}
+
+void HttpEngine::finish(CURL *easy, CURLcode code) {
+  auto it = active_.find(easy);
+  if (it == active_.end())
+    return;
+  auto t = std::move(it->second);
+  active_.erase(it);
+  if (t->req.group)
+    t->req.group->active_--;
+
+  Response res;
+  res.code = code;
+  curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &res.status);
+  curl_easy_getinfo(easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                    &res.contentLength);
+  res.ok = (code == CURLE_OK) && !t->aborted;
+  if (!res.ok) {
+    res.error = t->aborted ? "Transfer aborted by consumer"
+                : t->errorBuf[0] ? std::string(t->errorBuf)
+                                 : std::string(curl_easy_strerror(code));
+  }
+
+  curl_multi_remove_handle(multi_, easy);
+  curl_easy_cleanup(easy);
+  curl_slist_free_all(t->headerList);
+  t->promise.set_value(res);
+}
+
+void HttpEngine::run(std::stop_token stop) {
+  while (!stop.stop_requested()) {
+    attachPending();
+    resumePaused();
+
+    int running = 0;
+    curl_multi_perform(multi_, &running);
+
+    int left = 0;
+    while (CURLMsg *msg = curl_multi_info_read(multi_, &left)) {
+      if (msg->msg == CURLMSG_DONE)
+        finish(msg->easy_handle, msg->data.result);
+    }
+
+    bool anyPaused = std::any_of(active_.begin(), active_.end(),
+                                 [](const auto &p) { return p.second->paused; });
+    curl_multi_poll(multi_, nullptr, 0, anyPaused ? 10 : 1000, nullptr);
+  }
+
+  // Fail anything still queued so no caller blocks on a dead engine
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &[easy, t] : active_) {
+    curl_multi_remove_handle(multi_, easy);
+    curl_easy_cleanup(easy);
+    curl_slist_free_all(t->headerList);
+    Response res;
+    res.code = CURLE_ABORTED_BY_CALLBACK;
+    res.error = "HTTP engine shut down";
+    t->promise.set_value(res);
+  }
+  active_.clear();
+  for (auto &t : pending_) {
+    Response res;
+    res.code = CURLE_ABORTED_BY_CALLBACK;
+    res.error = "HTTP engine shut down";
+    t->promise.set_value(res);
+  }
+  pending_.clear();
+}
+
+} // namespace rsjfw
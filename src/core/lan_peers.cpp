@@ -0,0 +1,372 @@
+#include "rsjfw/lan_peers.hpp"
+#include "rsjfw/config.hpp"
+#include "rsjfw/http.hpp"
+#include "rsjfw/http_engine.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/package_cache.hpp"
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rsjfw {
+
+namespace {
+
+constexpr const char *GROUP = "239.255.77.77";
+constexpr uint16_t GROUP_PORT = 47771;
+constexpr auto ANNOUNCE_EVERY = std::chrono::seconds(30);
+constexpr auto PEER_TTL = std::chrono::seconds(90);
+constexpr auto QUERY_EVERY = std::chrono::seconds(30);
+constexpr int WORKERS = 4;
+constexpr size_t MAX_QUEUED = 16;
+
+bool isChecksum(const std::string &s) {
+  return s.size() == 32 && std::all_of(s.begin(), s.end(), [](char c) {
+           return std::isxdigit(static_cast<unsigned char>(c));
+         });
+}
+
+bool sendAll(int fd, const std::string &data) {
+  size_t off = 0;
+  while (off < data.size()) {
+    ssize_t n = ::send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    off += n;
+  }
+  return true;
+}
+
+void reply(int fd, const std::string &status) {
+  sendAll(fd, "HTTP/1.1 " + status +
+                  "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+}
+
+} // namespace
+
+LanPeers &LanPeers::instance() {
+  static LanPeers instance;
+  return instance;
+}
+
+LanPeers::~LanPeers() { stop(); }
+
+bool LanPeers::running() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return server_.joinable();
+}
+
+bool LanPeers::start() {
+  const auto &cfg = Config::instance().getInstaller();
+  if (!cfg.lanSharing)
+    return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (server_.joinable())
+    return true;
+
+  // Package server on the configured port, or any free one
+  httpFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(httpFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(static_cast<uint16_t>(std::max(0, cfg.lanPort)));
+  socklen_t len = sizeof(addr);
+  if (httpFd_ < 0 || bind(httpFd_, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      ::listen(httpFd_, 16) != 0 ||
+      getsockname(httpFd_, (sockaddr *)&addr, &len) != 0) {
+    LOG_WARN("LAN sharing: could not open the package server");
+    if (httpFd_ >= 0)
+      close(httpFd_);
+    httpFd_ = -1;
+    return false;
+  }
+  port_ = ntohs(addr.sin_port);
+
+  // Announce socket, shared with every other instance on this host
+  udpFd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  setsockopt(udpFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(udpFd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  sockaddr_in group{};
+  group.sin_family = AF_INET;
+  group.sin_addr.s_addr = htonl(INADDR_ANY);
+  group.sin_port = htons(GROUP_PORT);
+  ip_mreq mreq{};
+  inet_pton(AF_INET, GROUP, &mreq.imr_multiaddr);
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  unsigned char ttl = 1, loop = 1;
+  if (udpFd_ < 0 || bind(udpFd_, (sockaddr *)&group, sizeof(group)) != 0 ||
+      setsockopt(udpFd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                 sizeof(mreq)) != 0) {
+    LOG_WARN("LAN sharing: could not join the announce group");
+    if (udpFd_ >= 0)
+      close(udpFd_);
+    udpFd_ = -1;
+  } else {
+    setsockopt(udpFd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(udpFd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  }
+
+  std::random_device rd;
+  std::ostringstream id;
+  id << std::hex << rd() << rd();
+  id_ = id.str();
+
+  for (int i = 0; i < WORKERS; ++i)
+    workers_.emplace_back([this](std::stop_token st) { work(st); });
+  server_ = std::jthread([this](std::stop_token st) { serve(st); });
+  if (udpFd_ >= 0)
+    listener_ = std::jthread([this](std::stop_token st) { listen(st); });
+  LOG_INFO("LAN sharing: serving the package store on port " +
+           std::to_string(port_));
+  return true;
+}
+
+void LanPeers::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!server_.joinable())
+      return;
+  }
+  server_.request_stop();
+  listener_.request_stop();
+  server_ = {};
+  listener_ = {};
+
+  // Cut off transfers in progress so the workers can be joined
+  for (auto &w : workers_)
+    w.request_stop();
+  {
+    std::lock_guard<std::mutex> lock(clientMutex_);
+    for (int fd : serving_)
+      shutdown(fd, SHUT_RDWR);
+    for (int fd : queued_)
+      close(fd);
+    queued_.clear();
+  }
+  workers_.clear();
+  close(httpFd_);
+  if (udpFd_ >= 0)
+    close(udpFd_);
+  httpFd_ = udpFd_ = -1;
+}
+
+void LanPeers::send(const std::string &message) {
+  sockaddr_in dst{};
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons(GROUP_PORT);
+  inet_pton(AF_INET, GROUP, &dst.sin_addr);
+  sendto(udpFd_, message.data(), message.size(), 0, (sockaddr *)&dst,
+         sizeof(dst));
+}
+
+void LanPeers::serve(std::stop_token stop) {
+  while (!stop.stop_requested()) {
+    pollfd pfd{httpFd_, POLLIN, 0};
+    if (poll(&pfd, 1, 500) <= 0)
+      continue;
+    int fd = accept4(httpFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    timeval timeout{30, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::lock_guard<std::mutex> lock(clientMutex_);
+    if (queued_.size() >= MAX_QUEUED) {
+      reply(fd, "503 Service Unavailable");
+      close(fd);
+      continue;
+    }
+    queued_.push_back(fd);
+    clientCv_.notify_one();
+  }
+}
+
+void LanPeers::work(std::stop_token stop) {
+  for (;;) {
+    int fd;
+    {
+      std::unique_lock<std::mutex> lock(clientMutex_);
+      if (!clientCv_.wait(lock, stop, [&] { return !queued_.empty(); }))
+        return;
+      fd = queued_.front();
+      queued_.pop_front();
+      serving_.insert(fd);
+    }
+    handleClient(fd);
+    std::lock_guard<std::mutex> lock(clientMutex_);
+    serving_.erase(fd);
+    close(fd);
+  }
+}
+
+void LanPeers::handleClient(int fd) {
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < 8192) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+      return;
+    request.append(buf, n);
+  }
+
+  std::istringstream line(request.substr(0, request.find("\r\n")));
+  std::string method, target;
+  line >> method >> target;
+  if (method != "GET" && method != "HEAD")
+    return reply(fd, "405 Method Not Allowed");
+
+  const std::string prefix = "/pkg/";
+  std::string checksum =
+      target.rfind(prefix, 0) == 0 ? target.substr(prefix.size()) : "";
+  if (!isChecksum(checksum))
+    return reply(fd, "404 Not Found");
+
+  std::filesystem::path path = PackageCache::instance().lookup(checksum);
+  int file = path.empty() ? -1 : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st{};
+  if (file < 0 || fstat(file, &st) != 0) {
+    if (file >= 0)
+      close(file);
+    return reply(fd, "404 Not Found");
+  }
+
+  bool ok = sendAll(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/zip"
+                        "\r\nContent-Length: " +
+                            std::to_string(st.st_size) +
+                            "\r\nConnection: close\r\n\r\n");
+  off_t offset = 0;
+  while (ok && method == "GET" && offset < st.st_size) {
+    ssize_t n = sendfile(fd, file, &offset, st.st_size - offset);
+    ok = n > 0;
+  }
+  close(file);
+}
+
+void LanPeers::listen(std::stop_token stop) {
+  send("RSJFW1 announce " + id_ + " " + std::to_string(port_));
+  // Ask right away, so peers are usually known before an install asks
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lastQuery_ = std::chrono::steady_clock::now();
+  }
+  send("RSJFW1 query " + id_);
+  auto lastAnnounce = std::chrono::steady_clock::now();
+
+  while (!stop.stop_requested()) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastAnnounce >= ANNOUNCE_EVERY) {
+      send("RSJFW1 announce " + id_ + " " + std::to_string(port_));
+      lastAnnounce = now;
+    }
+
+    pollfd pfd{udpFd_, POLLIN, 0};
+    if (poll(&pfd, 1, 500) <= 0)
+      continue;
+    char buf[256];
+    sockaddr_in from{};
+    socklen_t fromLen = sizeof(from);
+    ssize_t n = recvfrom(udpFd_, buf, sizeof(buf) - 1, 0, (sockaddr *)&from,
+                         &fromLen);
+    if (n <= 0)
+      continue;
+
+    std::istringstream msg(std::string(buf, n));
+    std::string magic, kind, id;
+    int port = 0;
+    msg >> magic >> kind >> id >> port;
+    if (magic != "RSJFW1" || id == id_)
+      continue;
+
+    if (kind == "query") {
+      send("RSJFW1 announce " + id_ + " " + std::to_string(port_));
+      lastAnnounce = now;
+    } else if (kind == "announce" && port > 0 && port < 65536) {
+      char ip[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+      std::string peer =
+          "http://" + std::string(ip) + ":" + std::to_string(port) + "/";
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!peers_.count(peer))
+        LOG_INFO("LAN sharing: found peer " + peer);
+      peers_[peer] = now;
+      peerCv_.notify_all();
+    }
+  }
+}
+
+std::vector<std::string> LanPeers::peers(std::chrono::milliseconds wait) {
+  if (!start())
+    return {};
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto now = std::chrono::steady_clock::now();
+  std::erase_if(peers_, [&](const auto &p) { return now - p.second > PEER_TTL; });
+
+  if (peers_.empty() && udpFd_ >= 0) {
+    if (now - lastQuery_ >= QUERY_EVERY) {
+      lastQuery_ = now;
+      send("RSJFW1 query " + id_);
+    }
+    // Answers to a recent query may still be on their way; an older one
+    // that went unanswered costs nothing
+    peerCv_.wait_until(lock, lastQuery_ + wait,
+                       [&] { return !peers_.empty(); });
+  }
+
+  std::vector<std::string> result;
+  for (const auto &p : peers_)
+    result.push_back(p.first);
+  return result;
+}
+
+void LanPeers::forget(const std::string &peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  peers_.erase(peer);
+}
+
+bool LanPeers::fetch(const std::string &checksum, const std::string &destPath,
+                     ProgressCallback progressCb) {
+  for (const auto &peer : peers()) {
+    std::string url = peer + "pkg/" + checksum;
+
+    // A cheap probe first: a gone peer or a miss must not go through the
+    // download retry/backoff loop
+    HttpEngine::Request probe;
+    probe.url = url;
+    probe.noBody = true;
+    probe.failOnError = false;
+    probe.connectTimeoutMs = 1000;
+    auto res = HttpEngine::instance().perform(std::move(probe));
+    if (!res.ok) {
+      forget(peer);
+      continue;
+    }
+    if (res.status != 200)
+      continue;
+
+    // One attempt per peer: bad bytes or a dropped transfer move on to the
+    // next peer or the CDN instead of waiting out the retry backoff
+    if (HTTP::download(url, destPath, progressCb, checksum, false)) {
+      LOG_INFO("LAN sharing: got " + checksum + " from " + peer);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace rsjfw
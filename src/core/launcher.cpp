@@ -1,18 +1,26 @@
 #include "rsjfw/launcher.hpp"
+#include "rsjfw/binary_log.hpp"
 #include "rsjfw/config.hpp"
 #include "rsjfw/diagnostics.hpp"
 #include "rsjfw/downloader.hpp"
 #include "rsjfw/dxvk.hpp"
 #include "rsjfw/http.hpp"
 #include "rsjfw/logger.hpp"
+#include "rsjfw/path_manager.hpp"
+#include "rsjfw/prefix_template.hpp"
+#include "rsjfw/process.hpp"
+#include "rsjfw/process_supervisor.hpp"
 #include "rsjfw/registry.hpp"
+#include "rsjfw/trace.hpp"
 #include "rsjfw/wine.hpp"
+#include "rsjfw/wine_server_pool.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <optional>
 #include <random>
 #include <signal.h>
 #include <sys/wait.h>
@@ -21,6 +29,59 @@
 
 namespace rsjfw {
 
+// Splits a Wine debug line ("0024:fixme:d3d:func ...", optionally led by
+// +pid/+timestamp fields) into level and channel; anything else is Studio's
+// own output, where "[FLog::Warning]" style tags carry the level.
+static void classifyOutput(const std::string &line, LogSource &source,
+                           LogLevel &level, std::string &channel) {
+  static const std::pair<const char *, LogLevel> wineClasses[] = {
+      {"err", LogLevel::ERROR},
+      {"warn", LogLevel::WARNING},
+      {"fixme", LogLevel::WARNING},
+      {"trace", LogLevel::DEBUG}};
+
+  size_t pos = 0;
+  for (int field = 0; field < 4; ++field) {
+    size_t colon = line.find(':', pos);
+    if (colon == std::string::npos)
+      break;
+    std::string token = line.substr(pos, colon - pos);
+    for (const auto &[name, lvl] : wineClasses) {
+      if (token == name) {
+        size_t end = line.find(':', colon + 1);
+        if (end == std::string::npos)
+          break;
+        source = LogSource::Wine;
+        level = lvl;
+        channel = line.substr(colon + 1, end - colon - 1);
+        return;
+      }
+    }
+    // Only numeric prefixes (pid, tid, timestamp) may precede the class
+    if (token.empty() || token.find_first_not_of("0123456789abcdefABCDEF.") !=
+                             std::string::npos)
+      break;
+    pos = colon + 1;
+  }
+
+  source = LogSource::Studio;
+  level = LogLevel::INFO;
+  channel.clear();
+  size_t tag = line.find("[FLog::");
+  if (tag == std::string::npos)
+    tag = line.find("[DFLog::");
+  if (tag != std::string::npos) {
+    size_t start = line.find("::", tag) + 2;
+    size_t end = line.find(']', start);
+    if (end != std::string::npos)
+      channel = line.substr(start, end - start);
+    if (channel.find("Error") != std::string::npos)
+      level = LogLevel::ERROR;
+    else if (channel.find("Warning") != std::string::npos)
+      level = LogLevel::WARNING;
+  }
+}
+
 Launcher::Launcher(const std::string &rootDir) : rootDir_(rootDir) {
   versionsDir_ = (std::filesystem::path(rootDir) / "versions").string();
   prefixDir_ = (std::filesystem::path(rootDir) / "prefix").string();
@@ -29,7 +90,24 @@ Launcher::Launcher(const std::string &rootDir) : rootDir_(rootDir) {
   std::filesystem::create_directories(prefixDir_);
 }
 
+// A fresh Credential Manager key for a prefix
+static rsjfw::wine::Prefix::RegistryEntry newEncryptionKey() {
+  LOG_INFO("Generating Wine Credential Manager EncryptionKey...");
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<> dis(0, 255);
+
+  std::stringstream ss;
+  for (int i = 0; i < 8; ++i) {
+    ss << std::hex << std::setfill('0') << std::setw(2) << dis(gen)
+       << (i < 7 ? "," : "");
+  }
+  return {"HKEY_CURRENT_USER\\Software\\Wine\\Credential Manager",
+          "EncryptionKey", ss.str(), "REG_BINARY"};
+}
+
 bool Launcher::setupPrefix(ProgressCb progressCb) {
+  RSJFW_TRACE("Launcher::setupPrefix");
   if (progressCb)
     progressCb(0.0f, "Initializing Wine Prefix...");
   auto &genCfg = Config::instance().getGeneral();
@@ -62,6 +140,25 @@ bool Launcher::setupPrefix(ProgressCb progressCb) {
     return true;
   }
 
+  std::string key = templateKey(pfx, isProton);
+  bool cloned = false;
+  if (!std::filesystem::exists(std::filesystem::path(winePrefix) /
+                               "system.reg") &&
+      PrefixTemplate::exists(key)) {
+    if (progressCb)
+      progressCb(-1.0f, "Cloning Prefix Template...");
+    cloned = PrefixTemplate::instantiate(key, winePrefix);
+    // The template's user.reg holds the Credential Manager key of the prefix
+    // it was captured from; every prefix gets its own
+    if (cloned && pfx.registryApply({newEncryptionKey()})) {
+      std::ofstream(marker).close();
+      if (progressCb)
+        progressCb(1.0f, "Prefix Ready.");
+      return true;
+    }
+    LOG_WARN("Prefix template unusable, setting up from scratch.");
+  }
+
   LOG_INFO("Setting up Wine prefix registry...");
   if (progressCb)
     progressCb(-1.0f, "Applying Registry Keys...");
@@ -90,25 +187,13 @@ bool Launcher::setupPrefix(ProgressCb progressCb) {
     progressCb(-1.0f, "Checking Credentials...");
   Registry reg(pfx);
   bool keyExists =
+      !cloned &&
       reg.exists("HKCU\\Software\\Wine\\Credential Manager", "EncryptionKey");
 
   if (!keyExists) {
-    LOG_INFO("Generating Wine Credential Manager EncryptionKey...");
     if (progressCb)
       progressCb(-1.0f, "Generating Encryption Key...");
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
-
-    std::stringstream ss;
-    for (int i = 0; i < 8; ++i) {
-      ss << std::hex << std::setfill('0') << std::setw(2) << dis(gen)
-         << (i < 7 ? "," : "");
-    }
-
-    entries.push_back({"HKEY_CURRENT_USER\\Software\\Wine\\Credential Manager",
-                       "EncryptionKey", ss.str(), "REG_BINARY"});
+    entries.push_back(newEncryptionKey());
   }
 
   if (!pfx.registryApply(entries)) {
@@ -117,6 +202,8 @@ bool Launcher::setupPrefix(ProgressCb progressCb) {
   }
 
   std::ofstream(marker).close();
+  // Studio has not run here yet; setupDxvk snapshots it as the template
+  std::ofstream(std::filesystem::path(winePrefix) / ".rsjfw_pristine").close();
   if (progressCb)
     progressCb(1.0f, "Registry Setup Complete.");
   return true;
@@ -150,9 +237,12 @@ bool Launcher::openWineConfiguration() {
 // Installs DXVK globally into the prefix
 bool Launcher::setupDxvk(const std::string &versionGUID,
                          ProgressCb progressCb) {
+  RSJFW_TRACE("Launcher::setupDxvk");
   bool useDxvk = Config::instance().getGeneral().dxvk;
-  if (!useDxvk)
+  if (!useDxvk) {
+    captureTemplate();
     return true;
+  }
 
   auto &genCfg = Config::instance().getGeneral();
   std::string dxvkRoot = "";
@@ -204,16 +294,65 @@ bool Launcher::setupDxvk(const std::string &versionGUID,
   }
 
   rsjfw::wine::Prefix pfx(genCfg.wineRoot, prefixDir_);
-  bool dxvkInstallSuccess = rsjfw::dxvk::install(pfx, dxvkRoot);
+  bool dxvkInstallSuccess = [&] {
+    RSJFW_TRACE("dxvk::install", dxvkRoot);
+    return rsjfw::dxvk::install(pfx, dxvkRoot);
+  }();
   if (!dxvkInstallSuccess) {
     LOG_ERROR("Failed to install DXVK.");
     return false;
   }
 
   LOG_INFO("DXVK setup complete.");
+  captureTemplate();
   return true;
 }
 
+std::string Launcher::templateKey(const rsjfw::wine::Prefix &pfx,
+                                  bool isProton) {
+  auto &genCfg = Config::instance().getGeneral();
+  std::string dxvk;
+  if (genCfg.dxvk) {
+    if (genCfg.dxvkSource.repo == "CUSTOM_PATH")
+      dxvk = genCfg.dxvkCustomPath;
+    else if (!genCfg.dxvkSource.installedRoot.empty())
+      dxvk = genCfg.dxvkSource.installedRoot;
+    else
+      dxvk = genCfg.dxvkSource.repo + "@" + genCfg.dxvkSource.version;
+  }
+  return PrefixTemplate::key(pfx, isProton, dxvk);
+}
+
+void Launcher::captureTemplate() {
+  auto &genCfg = Config::instance().getGeneral();
+  bool isProton = (genCfg.wineSource.repo.find("proton") != std::string::npos ||
+                   genCfg.wineSource.repo == "GE-PROTON" ||
+                   genCfg.wineSource.repo == "CACHY-PROTON");
+  std::string winePrefix =
+      isProton ? (std::filesystem::path(compatDataDir_) / "pfx").string()
+               : prefixDir_;
+  std::filesystem::path pristine =
+      std::filesystem::path(winePrefix) / ".rsjfw_pristine";
+  if (!std::filesystem::exists(pristine))
+    return;
+
+  rsjfw::wine::Prefix pfx(genCfg.wineRoot, winePrefix);
+  std::string key = templateKey(pfx, isProton);
+  if (PrefixTemplate::exists(key))
+    return;
+
+  // The setup's own wineserver would linger a few seconds after its last
+  // client before saving the hives; nothing runs in the prefix yet, so have
+  // it save and exit now rather than hold up the first launch
+  if (pfx.serverRunning()) {
+    pfx.runCommand(pfx.bin("wineserver"), {"-k"});
+    for (int i = 0; i < 40 && pfx.serverRunning(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(25));
+  }
+  if (PrefixTemplate::capture(pfx, key))
+    PrefixTemplate::prune(key);
+}
+
 // Finds the latest installed version and launches it
 bool Launcher::launchLatest(const std::vector<std::string> &extraArgs,
                             ProgressCb progressCb, OutputCb outputCb,
@@ -282,6 +421,7 @@ std::string Launcher::findStudioExecutable(const std::string &versionDir) {
 
 bool Launcher::setupFFlags(const std::string &versionGUID,
                            ProgressCb progressCb) {
+  RSJFW_TRACE("Launcher::setupFFlags");
   LOG_INFO("Setting up FFlags for " + versionGUID);
   std::filesystem::path settingsDir =
       std::filesystem::path(versionsDir_) / versionGUID / "ClientSettings";
@@ -291,12 +431,21 @@ bool Launcher::setupFFlags(const std::string &versionGUID,
 
   nlohmann::json fflags = Config::instance().getFFlags();
 
-  std::ofstream file(jsonPath);
-  if (file.is_open()) {
+  // Replaced rather than rewritten, in case the old file shares its inode
+  // with another version
+  std::filesystem::path tmp = jsonPath;
+  tmp += ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::trunc);
+    if (!file.is_open())
+      return false;
     file << fflags.dump(4);
-    return true;
+    if (!file)
+      return false;
   }
-  return false;
+  std::error_code ec;
+  std::filesystem::rename(tmp, jsonPath, ec);
+  return !ec;
 }
 
 bool Launcher::launchVersion(const std::string &versionGUID,
@@ -317,6 +466,9 @@ bool Launcher::launchVersion(const std::string &versionGUID,
 bool Launcher::runWine(const std::string &executablePath,
                        const std::vector<std::string> &args, OutputCb outputCb,
                        bool wait) {
+  // Everything up to handing Studio to Wine; Studio's own runtime is not
+  // part of the span
+  std::optional<Trace::Span> prepare(std::in_place, "Launcher::prepareWine");
   auto &genCfg = Config::instance().getGeneral();
 
   if (genCfg.wineSource.installedRoot.empty() &&
@@ -416,6 +568,15 @@ bool Launcher::runWine(const std::string &executablePath,
 
   configureEnvironment(pfx, isProton);
 
+  // A prefix cloned with hard links shares files with its template; a new
+  // Wine build would update them in place, so it gets private copies first
+  std::error_code pristineEc;
+  std::filesystem::remove(std::filesystem::path(winePrefix) / ".rsjfw_pristine",
+                          pristineEc);
+  std::string clonedFrom = PrefixTemplate::clonedFrom(winePrefix);
+  if (!clonedFrom.empty() && clonedFrom != templateKey(pfx, isProton))
+    PrefixTemplate::detach(winePrefix);
+
   bool isProtocol = false;
   for (const auto &arg : args) {
     if (arg.find("roblox-studio:") != std::string::npos ||
@@ -424,8 +585,15 @@ bool Launcher::runWine(const std::string &executablePath,
     }
   }
 
+  // With a warm server only the previous Studio goes; the server stays. A
+  // protocol link lands in the running session, so its server is never
+  // restarted under it.
+  bool warm = WineServerPool::ensure(pfx, isProtocol);
   if (!isProtocol) {
-    pfx.kill();
+    if (warm)
+      Process::killStudioInPrefix(winePrefix);
+    else
+      pfx.kill();
   }
 
   auto &wineCfg = Config::instance().getWine();
@@ -490,24 +658,31 @@ bool Launcher::runWine(const std::string &executablePath,
   std::cout << "[RSJFW] Launching: " << executablePath
             << (target == "explorer" ? " (Desktop Mode)" : "") << "\n";
 
-  std::string logDir = std::string(getenv("HOME")) + "/.local/share/rsjfw/logs";
-  std::filesystem::create_directories(logDir);
-  std::string logPath = logDir + "/studio_latest.log";
-
-  std::shared_ptr<std::ofstream> logFile =
-      std::make_shared<std::ofstream>(logPath);
+  // Structured, so the Troubleshooting viewer can seek in huge Wine debug
+  // output; `rsjfw log text` turns it back into plain text
+  std::filesystem::path logPath =
+      PathManager::instance().logs() / "studio_latest.rlog";
+  auto studioLog = std::make_shared<BinaryLogWriter>();
+  if (!studioLog->open(logPath))
+    LOG_WARN("Could not open " + logPath.string());
+  else if (studioLog->path() != logPath)
+    LOG_WARN("Another session is writing " + logPath.filename().string() +
+             "; logging to " + studioLog->path().string());
 
   std::string studioCwd =
       std::filesystem::path(executablePath).parent_path().string();
+  prepare.reset();
 
+  // Detached launches are ours to reap; otherwise pfx.wine waits itself
+  pfx.setOnSpawn([wait](int pid) {
+    ProcessSupervisor::instance().watch(pid, !wait);
+    ProcessSupervisor::announceLaunch(pid);
+  });
   return pfx.wine(
       target, launchArgs,
-      [logFile, outputCb](const std::string &line) {
+      [studioLog, outputCb](const std::string &line) {
         std::cout << line;
 
-        if (logFile && logFile->is_open())
-          *logFile << line;
-
         if (outputCb)
           outputCb(line);
 
@@ -515,6 +690,11 @@ bool Launcher::runWine(const std::string &executablePath,
         if (!rawLine.empty() && rawLine.back() == '\n')
           rawLine.pop_back();
         if (!rawLine.empty()) {
+          LogSource source;
+          LogLevel level;
+          std::string channel;
+          classifyOutput(rawLine, source, level, channel);
+          studioLog->append(level, source, channel, rawLine);
           LOG_INFO("[WINE] " + rawLine);
         }
 
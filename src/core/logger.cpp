@@ -1,52 +1,254 @@
 #include "rsjfw/logger.hpp"
+#include <cerrno>
+#include <climits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 namespace rsjfw {
 
+namespace {
+
+constexpr size_t kBatch = 512;
+constexpr size_t kMaxIov = IOV_MAX > 1024 ? 1024 : IOV_MAX;
+const char kNewline = '\n';
+
+// writev that survives short writes and EINTR
+void writevAll(int fd, std::vector<iovec>& iov) {
+    size_t i = 0;
+    while (fd >= 0 && i < iov.size()) {
+        ssize_t n = ::writev(fd, iov.data() + i, static_cast<int>(iov.size() - i));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        size_t left = static_cast<size_t>(n);
+        while (i < iov.size() && left >= iov[i].iov_len) left -= iov[i++].iov_len;
+        if (i < iov.size()) {
+            iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + left;
+            iov[i].iov_len -= left;
+        }
+    }
+    iov.clear();
+}
+
+void writeAll(int fd, const std::string& s) {
+    std::vector<iovec> iov{{const_cast<char*>(s.data()), s.size()}};
+    writevAll(fd, iov);
+}
+
+} // namespace
+
 Logger& Logger::instance() {
     static Logger instance;
     return instance;
 }
 
+Logger::Logger() : ring_(new Slot[kCapacity]) {
+    for (size_t i = 0; i < kCapacity; ++i) ring_[i].seq.store(i, std::memory_order_relaxed);
+    writer_ = std::thread([this]() { writerLoop(); });
+}
+
 void Logger::init(const std::filesystem::path& logPath, bool verbose) {
-    std::lock_guard<std::mutex> lock(mutex_);
     verbose_ = verbose;
 
     if (logPath.has_parent_path()) {
-        std::filesystem::create_directories(logPath.parent_path());
+        std::error_code ec;
+        std::filesystem::create_directories(logPath.parent_path(), ec);
     }
 
-    logFile_.open(logPath, std::ios::out | std::ios::app);
-    if (!logFile_.is_open()) {
+    int fd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
         std::cerr << "[ERROR] Failed to open log file: " << logPath << std::endl;
-    } else {
-        logFile_ << "\n=== RSJFW Session Started: " << getTimestamp() << " ===\n";
+        return;
+    }
+    writeAll(fd, "\n=== RSJFW Session Started: " + getTimestamp() + " ===\n");
+    int old = logFd_.exchange(fd);
+    if (old >= 0) {
+        flush();
+        ::close(old);
     }
 }
 
 Logger::~Logger() {
-    if (logFile_.is_open()) {
-        logFile_.close();
+    stopping_ = true;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeCv_.notify_one();
     }
+    if (writer_.joinable()) writer_.join();
+
+    int fd = logFd_.exchange(-1);
+    if (fd >= 0) ::close(fd);
 }
 
 void Logger::log(LogLevel level, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    std::string timestamp = getTimestamp();
-    std::string levelStr = getLevelString(level);
-    std::string formattedMsg = "[" + timestamp + "] [" + levelStr + "] " + message;
-
-    if (logFile_.is_open()) {
-        logFile_ << formattedMsg << std::endl;
+    log(level, std::string(message));
+}
+
+void Logger::log(LogLevel level, std::string&& message) {
+    if (!wants(level)) return;
+
+    bool block = level >= LogLevel::WARNING || policy_ == OverflowPolicy::Block;
+    if (!push({level, std::time(nullptr), std::move(message)}, block)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
 
-    if (verbose_ || level == LogLevel::WARNING || level == LogLevel::ERROR) {
-        if (level == LogLevel::ERROR) {
-            std::cerr << formattedMsg << std::endl;
+    if (level == LogLevel::ERROR) flush();
+}
+
+bool Logger::push(Record&& record, bool block) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &ring_[pos % kCapacity];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // Full
+            if (!block || stopping_) return false;
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex_);
+                wakeCv_.notify_one();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            pos = tail_.load(std::memory_order_relaxed);
         } else {
-            std::cout << formattedMsg << std::endl;
+            pos = tail_.load(std::memory_order_relaxed);
         }
     }
+
+    slot->record = std::move(record);
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the fence in writerLoop: either the writer sees this record
+    // before sleeping or we see it idle and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerIdle_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeCv_.notify_one();
+    }
+    return true;
+}
+
+void Logger::flush() {
+    if (std::this_thread::get_id() == writer_.get_id()) return;
+    size_t target = tail_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    wakeCv_.notify_one();
+    while (written_.load(std::memory_order_acquire) < target && !stopping_)
+        writtenCv_.wait_for(lock, std::chrono::milliseconds(50));
+}
+
+void Logger::writerLoop() {
+    for (;;) {
+        if (drain() > 0) continue;
+        if (stopping_) {
+            if (drain() == 0) return;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        writerIdle_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        size_t head = head_.load(std::memory_order_relaxed);
+        bool pending = ring_[head % kCapacity].seq.load(std::memory_order_acquire) == head + 1;
+        if (!pending && !stopping_) wakeCv_.wait_for(lock, std::chrono::milliseconds(250));
+        writerIdle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+size_t Logger::drain() {
+    static thread_local std::vector<Record> batch(kBatch);
+    size_t n = 0;
+    size_t head = head_.load(std::memory_order_relaxed);
+    while (n < kBatch) {
+        Slot& slot = ring_[head % kCapacity];
+        if (slot.seq.load(std::memory_order_acquire) != head + 1) break;
+        batch[n++] = std::move(slot.record);
+        slot.seq.store(head + kCapacity, std::memory_order_release);
+        ++head;
+    }
+    head_.store(head, std::memory_order_release);
+
+    uint64_t dropped = n < kBatch ? dropped_.exchange(0, std::memory_order_relaxed) : 0;
+    if (dropped > 0) {
+        batch[n++] = {LogLevel::WARNING, std::time(nullptr),
+                      std::to_string(dropped) + " log messages dropped (queue full)"};
+    }
+    if (n == 0) return 0;
+
+    writeBatch(batch.data(), n);
+    for (size_t i = 0; i < n; ++i) batch[i].message.clear();
+
+    written_.store(head, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+    }
+    writtenCv_.notify_all();
+    return n;
+}
+
+void Logger::writeBatch(Record* records, size_t count) {
+    std::vector<iovec> fileIov;
+    // The console goes through the streams so it stays in order with
+    // everything else printed there and follows a redirected rdbuf
+    std::string outText, errText;
+    std::string prefixes[4];
+    const int fd = logFd_.load(std::memory_order_relaxed);
+    const bool verbose = verbose_.load(std::memory_order_relaxed);
+
+    auto flushAll = [&]() {
+        writevAll(fd, fileIov);
+    };
+    auto add = [](std::vector<iovec>& iov, const std::string& prefix, const std::string& msg) {
+        iov.push_back({const_cast<char*>(prefix.data()), prefix.size()});
+        iov.push_back({const_cast<char*>(msg.data()), msg.size()});
+        iov.push_back({const_cast<char*>(&kNewline), 1});
+    };
+    auto addText = [](std::string& text, const std::string& prefix, const std::string& msg) {
+        text.append(prefix).append(msg).push_back(kNewline);
+    };
+
+    time_t prefixSecond = -1;
+    for (size_t i = 0; i < count; ++i) {
+        const Record& r = records[i];
+        // Prefixes are rebuilt once per second, after the lines that still
+        // point at the old ones are out
+        if (r.time != prefixSecond) {
+            flushAll();
+            if (r.time != cachedSecond_) {
+                std::tm tm{};
+                localtime_r(&r.time, &tm);
+                char buf[32];
+                std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+                cachedStamp_ = buf;
+                cachedSecond_ = r.time;
+            }
+            for (int l = 0; l < 4; ++l)
+                prefixes[l] = "[" + cachedStamp_ + "] [" + getLevelString(static_cast<LogLevel>(l)) + "] ";
+            prefixSecond = r.time;
+        }
+
+        const std::string& prefix = prefixes[static_cast<int>(r.level)];
+        add(fileIov, prefix, r.message);
+        if (r.level == LogLevel::ERROR)
+            addText(errText, prefix, r.message);
+        else if (verbose || r.level == LogLevel::WARNING)
+            addText(outText, prefix, r.message);
+
+        if (fileIov.size() + 3 > kMaxIov)
+            flushAll();
+    }
+    flushAll();
+
+    if (!outText.empty()) std::cout.write(outText.data(), outText.size()).flush();
+    if (!errText.empty()) std::cerr.write(errText.data(), errText.size()).flush();
 }
 
 std::string Logger::getTimestamp() {
@@ -0,0 +1,270 @@
+#include "rsjfw/md5.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rsjfw {
+
+namespace {
+
+constexpr uint32_t K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+constexpr uint32_t S[64] = {7,  12, 17, 22, 7,  12, 17, 22, 7,  12, 17, 22,
+                            7,  12, 17, 22, 5,  9,  14, 20, 5,  9,  14, 20,
+                            5,  9,  14, 20, 5,  9,  14, 20, 4,  11, 16, 23,
+                            4,  11, 16, 23, 4,  11, 16, 23, 4,  11, 16, 23,
+                            6,  10, 15, 21, 6,  10, 15, 21, 6,  10, 15, 21,
+                            6,  10, 15, 21};
+
+inline uint32_t rotl(uint32_t x, uint32_t c) { return (x << c) | (x >> (32 - c)); }
+
+} // namespace
+
+Md5::Md5() {
+  state_[0] = 0x67452301;
+  state_[1] = 0xefcdab89;
+  state_[2] = 0x98badcfe;
+  state_[3] = 0x10325476;
+}
+
+void Md5::transform(const uint8_t block[64]) {
+  uint32_t m[16];
+  for (int i = 0; i < 16; ++i) {
+    m[i] = uint32_t(block[i * 4]) | (uint32_t(block[i * 4 + 1]) << 8) |
+           (uint32_t(block[i * 4 + 2]) << 16) |
+           (uint32_t(block[i * 4 + 3]) << 24);
+  }
+
+  uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+  for (uint32_t i = 0; i < 64; ++i) {
+    uint32_t f, g;
+    if (i < 16) {
+      f = (b & c) | (~b & d);
+      g = i;
+    } else if (i < 32) {
+      f = (d & b) | (~d & c);
+      g = (5 * i + 1) % 16;
+    } else if (i < 48) {
+      f = b ^ c ^ d;
+      g = (3 * i + 5) % 16;
+    } else {
+      f = c ^ (b | ~d);
+      g = (7 * i) % 16;
+    }
+    uint32_t tmp = d;
+    d = c;
+    c = b;
+    b = b + rotl(a + f + K[i] + m[g], S[i]);
+    a = tmp;
+  }
+
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+}
+
+void Md5::update(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  length_ += len;
+
+  if (buffered_ > 0) {
+    size_t take = std::min(len, sizeof(buffer_) - buffered_);
+    std::memcpy(buffer_ + buffered_, p, take);
+    buffered_ += take;
+    p += take;
+    len -= take;
+    if (buffered_ < sizeof(buffer_))
+      return;
+    transform(buffer_);
+    buffered_ = 0;
+  }
+
+  while (len >= 64) {
+    transform(p);
+    p += 64;
+    len -= 64;
+  }
+
+  if (len > 0) {
+    std::memcpy(buffer_, p, len);
+    buffered_ = len;
+  }
+}
+
+Md5::Digest Md5::finish() {
+  uint64_t bits = length_ * 8;
+  uint8_t pad[72] = {0x80};
+  size_t padLen = (buffered_ < 56) ? 56 - buffered_ : 120 - buffered_;
+  update(pad, padLen);
+
+  uint8_t lenBytes[8];
+  for (int i = 0; i < 8; ++i)
+    lenBytes[i] = static_cast<uint8_t>(bits >> (8 * i));
+  update(lenBytes, 8);
+
+  Digest out;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j)
+      out[i * 4 + j] = static_cast<uint8_t>(state_[i] >> (8 * j));
+  }
+  return out;
+}
+
+std::string Md5::hexdigest() { return toHex(finish()); }
+
+std::string Md5::toHex(const Digest &digest) {
+  static const char *hex = "0123456789abcdef";
+  std::string out;
+  out.reserve(32);
+  for (uint8_t byte : digest) {
+    out.push_back(hex[byte >> 4]);
+    out.push_back(hex[byte & 0xf]);
+  }
+  return out;
+}
+
+bool Md5::sameHex(const std::string &a, const std::string &b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+#if defined(__SSE2__)
+namespace {
+
+inline __m128i rotl4(__m128i x, int c) {
+  return _mm_or_si128(_mm_slli_epi32(x, c), _mm_srli_epi32(x, 32 - c));
+}
+
+// One MD5 compression per lane; lane j reads its 64 bytes from blocks[j]
+void transform4(__m128i state[4], const uint8_t *const blocks[4]) {
+  __m128i m[16];
+  for (int i = 0; i < 16; ++i) {
+    uint32_t w[4];
+    for (int j = 0; j < 4; ++j) {
+      const uint8_t *b = blocks[j] + i * 4;
+      w[j] = uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) |
+             (uint32_t(b[3]) << 24);
+    }
+    m[i] = _mm_set_epi32(w[3], w[2], w[1], w[0]);
+  }
+
+  const __m128i ones = _mm_set1_epi32(-1);
+  __m128i a = state[0], b = state[1], c = state[2], d = state[3];
+  for (uint32_t i = 0; i < 64; ++i) {
+    __m128i f;
+    uint32_t g;
+    if (i < 16) {
+      f = _mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d));
+      g = i;
+    } else if (i < 32) {
+      f = _mm_or_si128(_mm_and_si128(d, b), _mm_andnot_si128(d, c));
+      g = (5 * i + 1) % 16;
+    } else if (i < 48) {
+      f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+      g = (3 * i + 5) % 16;
+    } else {
+      f = _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, ones)));
+      g = (7 * i) % 16;
+    }
+    __m128i sum = _mm_add_epi32(_mm_add_epi32(a, f),
+                                _mm_add_epi32(_mm_set1_epi32(K[i]), m[g]));
+    __m128i tmp = d;
+    d = c;
+    c = b;
+    b = _mm_add_epi32(b, rotl4(sum, S[i]));
+    a = tmp;
+  }
+
+  state[0] = _mm_add_epi32(state[0], a);
+  state[1] = _mm_add_epi32(state[1], b);
+  state[2] = _mm_add_epi32(state[2], c);
+  state[3] = _mm_add_epi32(state[3], d);
+}
+
+} // namespace
+#endif
+
+std::vector<Md5::Digest>
+Md5::digestMany(const std::vector<std::string_view> &inputs) {
+  std::vector<Digest> out(inputs.size());
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + 4 <= inputs.size(); i += 4) {
+    Md5 lanes[4];
+    size_t common = SIZE_MAX;
+    for (int j = 0; j < 4; ++j)
+      common = std::min(common, inputs[i + j].size() / 64);
+
+    // Run the blocks every lane has in lockstep, then let each lane finish
+    // its own tail on the scalar path
+    __m128i state[4];
+    for (int k = 0; k < 4; ++k)
+      state[k] = _mm_set1_epi32(static_cast<int>(lanes[0].state_[k]));
+    for (size_t blk = 0; blk < common; ++blk) {
+      const uint8_t *blocks[4];
+      for (int j = 0; j < 4; ++j)
+        blocks[j] =
+            reinterpret_cast<const uint8_t *>(inputs[i + j].data()) + blk * 64;
+      transform4(state, blocks);
+    }
+
+    alignas(16) uint32_t words[4][4];
+    for (int k = 0; k < 4; ++k)
+      _mm_store_si128(reinterpret_cast<__m128i *>(words[k]), state[k]);
+    for (int j = 0; j < 4; ++j) {
+      for (int k = 0; k < 4; ++k)
+        lanes[j].state_[k] = words[k][j];
+      lanes[j].length_ = common * 64;
+      lanes[j].update(inputs[i + j].data() + common * 64,
+                      inputs[i + j].size() - common * 64);
+      out[i + j] = lanes[j].finish();
+    }
+  }
+#endif
+
+  for (; i < inputs.size(); ++i) {
+    Md5 md5;
+    md5.update(inputs[i].data(), inputs[i].size());
+    out[i] = md5.finish();
+  }
+  return out;
+}
+
+std::string Md5::hashFile(const std::string &path) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs)
+    return "";
+
+  Md5 md5;
+  std::vector<char> buffer(1 << 20);
+  while (ifs) {
+    ifs.read(buffer.data(), buffer.size());
+    md5.update(buffer.data(), static_cast<size_t>(ifs.gcount()));
+  }
+  if (ifs.bad())
+    return "";
+  return md5.hexdigest();
+}
+
+} // namespace rsjfw
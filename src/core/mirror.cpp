@@ -0,0 +1,216 @@
+#include "rsjfw/mirror.hpp"
+#include "rsjfw/config.hpp"
+#include "rsjfw/downloader.hpp"
+#include "rsjfw/file_clone.hpp"
+#include "rsjfw/http.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/package_cache.hpp"
+#include "rsjfw/path_manager.hpp"
+#include "rsjfw/roblox_api.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+namespace rsjfw {
+
+namespace {
+
+nlohmann::json readJson(const std::filesystem::path &path,
+                        nlohmann::json fallback) {
+  std::ifstream ifs(path);
+  if (!ifs)
+    return fallback;
+  auto j = nlohmann::json::parse(ifs, nullptr, false);
+  return j.is_discarded() || j.type() != fallback.type() ? fallback : j;
+}
+
+bool writeJson(const std::filesystem::path &path, const nlohmann::json &j) {
+  std::filesystem::create_directories(path.parent_path());
+  std::filesystem::path tmp = path.string() + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::trunc);
+    ofs << j.dump(2);
+    if (!ofs)
+      return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+// Brings one Roblox package into setup/, preferring the local package store
+bool syncPackage(const std::filesystem::path &dst, const std::string &url,
+                 const RobloxPackage &pkg) {
+  if (std::filesystem::exists(dst) &&
+      Md5::sameHex(Md5::hashFile(dst.string()), pkg.checksum))
+    return true;
+
+  std::filesystem::path cached = PackageCache::instance().lookup(pkg.checksum);
+  if (!cached.empty() &&
+      FileClone::clone(cached, dst) != FileClone::Method::None)
+    return true;
+
+  return HTTP::download(url, dst.string(), nullptr, pkg.checksum);
+}
+
+bool syncVersion(const std::filesystem::path &dir,
+                 const std::string &versionGUID, nlohmann::json &index) {
+  Downloader downloader(PathManager::instance().root().string());
+  std::string guid = versionGUID;
+  if (guid.empty())
+    guid = downloader.getLatestVersionGUID();
+
+  std::string manifestText =
+      HTTP::get(RobloxAPI::baseUrl() + guid + "-rbxPkgManifest.txt");
+  auto packages = RobloxAPI::parsePackageManifest(manifestText);
+  if (packages.empty()) {
+    LOG_ERROR("No package manifest for " + guid);
+    return false;
+  }
+
+  std::filesystem::path setup = dir / "setup";
+  std::filesystem::create_directories(setup);
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < packages.size(); ++i) {
+    const auto &pkg = packages[i];
+    std::cout << "[RSJFW] Mirroring " << guid << " " << pkg.name << " ("
+              << i + 1 << "/" << packages.size() << ")\n";
+    if (!syncPackage(setup / (guid + "-" + pkg.name),
+                     RobloxAPI::baseUrl() + guid + "-" + pkg.name, pkg)) {
+      LOG_ERROR("Failed to mirror " + pkg.name + " of " + guid);
+      return false;
+    }
+    bytes += pkg.packedSize;
+  }
+
+  // The manifest goes last, so its presence means the version is complete
+  std::ofstream(setup / (guid + "-rbxPkgManifest.txt"), std::ios::trunc)
+      << manifestText;
+
+  index["roblox"]["versions"][guid] = {{"packages", packages.size()},
+                                       {"bytes", bytes}};
+  if (versionGUID.empty()) {
+    std::string channel = RobloxAPI::normalizeChannel(
+        Config::instance().getGeneral().channel);
+    if (!writeJson(dir / "clientsettings" / (channel + ".json"),
+                   {{"version", guid}, {"clientVersionUpload", guid}}))
+      return false;
+    index["roblox"]["channels"][channel] = guid;
+  }
+  return true;
+}
+
+bool syncRelease(const std::filesystem::path &dir,
+                 const Mirror::ReleaseSource &source, nlohmann::json &index) {
+  Downloader downloader(PathManager::instance().root().string());
+  Downloader::GitHubRelease release;
+  Downloader::GitHubAsset asset;
+  if (!downloader.resolveRelease(source.repo, source.version, source.asset,
+                                 source.isWine ? Downloader::WINE_ARCHIVES
+                                               : Downloader::DXVK_ARCHIVES,
+                                 release, asset)) {
+    LOG_ERROR("No asset to mirror for " + source.repo + " " + source.version);
+    return false;
+  }
+
+  std::filesystem::path repoDir = dir / "github" / source.repo;
+  std::string relative = "download/" + release.tag + "/" + asset.name;
+  std::filesystem::path dst = repoDir / relative;
+  std::error_code ec;
+  if (std::filesystem::file_size(dst, ec) != asset.size) {
+    std::cout << "[RSJFW] Mirroring " << source.repo << " " << asset.name
+              << "\n";
+    std::filesystem::create_directories(dst.parent_path());
+    int segments = Config::instance().getInstaller().downloadSegments;
+    if (!HTTP::downloadSegmented(asset.url, dst.string(), segments)) {
+      LOG_ERROR("Failed to mirror " + asset.url);
+      return false;
+    }
+  }
+
+  // Newest first, like the GitHub API, so "latest" keeps resolving
+  nlohmann::json releases =
+      readJson(repoDir / "releases.json", nlohmann::json::array());
+  nlohmann::json *entry = nullptr;
+  for (auto &r : releases)
+    if (r.value("tag_name", "") == release.tag)
+      entry = &r;
+  if (!entry) {
+    nlohmann::json fresh = {{"tag_name", release.tag},
+                            {"assets", nlohmann::json::array()}};
+    if (source.version == "latest")
+      releases.insert(releases.begin(), fresh);
+    else
+      releases.push_back(fresh);
+    for (auto &r : releases)
+      if (r["tag_name"] == release.tag)
+        entry = &r;
+  }
+  bool listed = false;
+  for (const auto &a : (*entry)["assets"])
+    listed = listed || a.value("name", "") == asset.name;
+  if (!listed)
+    (*entry)["assets"].push_back({{"name", asset.name},
+                                  {"browser_download_url", relative},
+                                  {"size", asset.size}});
+  if (!writeJson(repoDir / "releases.json", releases))
+    return false;
+
+  auto &tags = index["releases"][source.repo];
+  if (std::find(tags.begin(), tags.end(), release.tag) == tags.end())
+    tags.push_back(release.tag);
+  return true;
+}
+
+} // namespace
+
+bool Mirror::enabled() {
+  return !Config::instance().getInstaller().mirror.empty();
+}
+
+std::string Mirror::base() {
+  std::string base = Config::instance().getInstaller().mirror;
+  if (base.empty())
+    return "";
+  if (base.find("://") == std::string::npos)
+    base = "file://" + std::filesystem::absolute(base).string();
+  if (base.back() != '/')
+    base += '/';
+  return base;
+}
+
+std::string Mirror::url(const std::string &relative) {
+  return base() + relative;
+}
+
+bool Mirror::sync(const std::filesystem::path &dir,
+                  const std::string &versionGUID,
+                  const std::vector<ReleaseSource> &releases) {
+  try {
+    std::filesystem::create_directories(dir);
+    nlohmann::json index =
+        readJson(dir / "index.json", nlohmann::json::object());
+
+    bool ok = syncVersion(dir, versionGUID, index);
+    for (const auto &source : releases)
+      ok = syncRelease(dir, source, index) && ok;
+
+    index["format"] = 1;
+    index["updated"] = std::chrono::duration_cast<std::chrono::seconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+    if (!writeJson(dir / "index.json", index)) {
+      LOG_ERROR("Could not write mirror index in " + dir.string());
+      return false;
+    }
+    return ok;
+  } catch (const std::exception &e) {
+    LOG_ERROR(std::string("Mirror sync failed: ") + e.what());
+    return false;
+  }
+}
+
+} // namespace rsjfw
@@ -0,0 +1,148 @@
+#include "rsjfw/package_cache.hpp"
+#include "rsjfw/config.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/path_manager.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace rsjfw {
+
+PackageCache &PackageCache::instance() {
+  static PackageCache instance;
+  return instance;
+}
+
+std::filesystem::path PackageCache::dir() const {
+  return PathManager::instance().packageCache();
+}
+
+std::filesystem::path
+PackageCache::entryPath(const std::string &checksum) const {
+  return dir() / checksum;
+}
+
+uint64_t PackageCache::capBytes() const {
+  int mb = Config::instance().getInstaller().packageCacheMB;
+  return mb > 0 ? static_cast<uint64_t>(mb) * 1024 * 1024 : 0;
+}
+
+bool PackageCache::enabled() const { return capBytes() > 0; }
+
+std::filesystem::path PackageCache::lookup(const std::string &checksum) {
+  if (!enabled() || checksum.empty())
+    return {};
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::filesystem::path p = entryPath(checksum);
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(p, ec))
+    return {};
+
+  // mtime doubles as the LRU timestamp
+  std::filesystem::last_write_time(
+      p, std::filesystem::file_time_type::clock::now(), ec);
+  return p;
+}
+
+int PackageCache::openStaging(const std::string &checksum,
+                              std::filesystem::path &path) {
+  static std::atomic<unsigned> counter{0};
+  std::error_code ec;
+  std::filesystem::create_directories(dir(), ec);
+  for (int attempt = 0; attempt < 8; ++attempt) {
+    path = dir() / (checksum + "." + std::to_string(getpid()) + "." +
+                    std::to_string(counter++) + ".stream");
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd >= 0 || errno != EEXIST)
+      return fd;
+  }
+  return -1;
+}
+
+bool PackageCache::commit(const std::string &checksum,
+                          const std::filesystem::path &staging) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::error_code ec;
+  std::filesystem::rename(staging, entryPath(checksum), ec);
+  if (ec) {
+    LOG_WARN("Failed to commit cached package " + checksum + ": " +
+             ec.message());
+    std::filesystem::remove(staging, ec);
+    return false;
+  }
+  return true;
+}
+
+void PackageCache::discard(const std::filesystem::path &staging) {
+  std::error_code ec;
+  std::filesystem::remove(staging, ec);
+}
+
+uint64_t PackageCache::totalBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t total = 0;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir(), ec)) {
+    if (entry.is_regular_file(ec))
+      total += entry.file_size(ec);
+  }
+  return total;
+}
+
+void PackageCache::trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t cap = capBytes();
+
+  struct Entry {
+    std::filesystem::path path;
+    std::filesystem::file_time_type used;
+    uint64_t size;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+
+  // Staging files of installers that died are swept after a day
+  auto staleBefore = std::filesystem::file_time_type::clock::now() -
+                     std::chrono::hours(24);
+  std::vector<std::filesystem::path> stale;
+
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir(), ec)) {
+    if (!entry.is_regular_file(ec))
+      continue;
+    auto ext = entry.path().extension();
+    if (ext == ".stream" && entry.last_write_time(ec) < staleBefore)
+      stale.push_back(entry.path());
+    if (ext == ".part" || ext == ".meta" || ext == ".stream")
+      continue;
+    Entry e{entry.path(), entry.last_write_time(ec), entry.file_size(ec)};
+    total += e.size;
+    entries.push_back(e);
+  }
+
+  for (const auto &path : stale)
+    std::filesystem::remove(path, ec);
+
+  if (total <= cap)
+    return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+
+  for (const auto &e : entries) {
+    if (total <= cap)
+      break;
+    if (std::filesystem::remove(e.path, ec)) {
+      total -= e.size;
+      LOG_DEBUG("Evicted cached package " + e.path.filename().string());
+    }
+  }
+}
+
+} // namespace rsjfw
@@ -23,6 +23,9 @@ void PathManager::init(const std::string& rootOverride) {
     downloadsDir_ = rootDir_ / "downloads";
     wineDir_ = rootDir_ / "wine";
     dxvkDir_ = rootDir_ / "dxvk";
+    packageCacheDir_ = rootDir_ / "cache" / "packages";
+    httpCacheDir_ = rootDir_ / "cache" / "http";
+    prefixTemplatesDir_ = rootDir_ / "cache" / "prefixes";
     inboxDir_ = rootDir_ / "inbox";
     lockFilePath_ = rootDir_ / "rsjfw.lock";
 
@@ -33,6 +36,8 @@ void PathManager::init(const std::string& rootOverride) {
     std::filesystem::create_directories(downloadsDir_);
     std::filesystem::create_directories(wineDir_);
     std::filesystem::create_directories(dxvkDir_);
+    std::filesystem::create_directories(packageCacheDir_);
+    std::filesystem::create_directories(httpCacheDir_);
     std::filesystem::create_directories(inboxDir_);
 
     // Legacy Migration: ~/.rsjfw -> XDG
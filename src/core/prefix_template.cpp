@@ -0,0 +1,334 @@
+#include "rsjfw/prefix_template.hpp"
+#include "rsjfw/file_clone.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/path_manager.hpp"
+#include "rsjfw/trace.hpp"
+#include "rsjfw/wine.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace rsjfw {
+
+// Written into cloned prefixes; holds the template key
+static const char *kClonedMarker = ".rsjfw_template";
+
+static std::string lower(std::string s) {
+  for (auto &c : s)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+static std::string findInPath(const std::string &name) {
+  if (name.find('/') != std::string::npos)
+    return name;
+  const char *path = std::getenv("PATH");
+  std::string dirs = path ? path : "/usr/bin:/bin";
+  size_t start = 0;
+  while (start <= dirs.size()) {
+    size_t end = dirs.find(':', start);
+    if (end == std::string::npos)
+      end = dirs.size();
+    fs::path candidate = fs::path(dirs.substr(start, end - start)) / name;
+    if (access(candidate.c_str(), X_OK) == 0)
+      return candidate.string();
+    start = end + 1;
+  }
+  return name;
+}
+
+// RSJFW's own bookkeeping and leftovers of interrupted writes stay out of
+// templates
+static bool skipped(const fs::path &name) {
+  std::string n = name.string();
+  auto endsWith = [&](const char *suffix) {
+    size_t len = std::char_traits<char>::length(suffix);
+    return n.size() >= len && n.compare(n.size() - len, len, suffix) == 0;
+  };
+  return n.rfind(".rsjfw_", 0) == 0 || n == "rsjfw_batch.reg" ||
+         endsWith(".rsjfw-tmp") || endsWith(".rsjfw-clone");
+}
+
+// The only files a clone shares with its template: PE images outside the
+// per-user and scratch trees, which Wine replaces but never edits. Anything
+// else (the hives, win.ini, system.ini, .update-timestamp, ...) can be
+// rewritten in place and gets a private copy.
+static bool isShared(const fs::path &rel) {
+  std::vector<std::string> parts;
+  for (const auto &p : rel)
+    parts.push_back(lower(p.string()));
+  if (parts.size() <= 2 || parts[0] != "drive_c" || parts[1] == "users" ||
+      parts[1] == "programdata" ||
+      (parts[1] == "windows" && parts[2] == "temp"))
+    return false;
+  static const char *kImages[] = {".dll", ".exe", ".drv", ".sys", ".ocx",
+                                  ".cpl", ".acm", ".ax",  ".tlb", ".ds"};
+  std::string ext = lower(rel.extension().string());
+  return std::find(std::begin(kImages), std::end(kImages), ext) !=
+         std::end(kImages);
+}
+
+struct CloneStats {
+  size_t reflinked = 0, linked = 0, copied = 0;
+};
+
+// Shared files may be hard-linked; those links are made read-only, so even
+// `wineboot -u` fails loudly rather than writing through into the template.
+// Without `copyShared` a shared file that can't be linked fails the tree.
+static bool copyTree(const fs::path &src, const fs::path &dst,
+                     bool copyShared, CloneStats &stats) {
+  std::error_code ec;
+  fs::create_directories(dst, ec);
+  fs::recursive_directory_iterator it(
+      src, fs::directory_options::skip_permission_denied, ec);
+  if (ec)
+    return false;
+
+  for (; it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (ec)
+      return false;
+    const fs::path &path = it->path();
+    if (skipped(path.filename())) {
+      if (it->is_directory(ec) && !it->is_symlink(ec))
+        it.disable_recursion_pending();
+      continue;
+    }
+    fs::path rel = path.lexically_relative(src);
+    fs::path target = dst / rel;
+
+    // Wine links dosdevices and the user shell folders; keep them as links
+    auto status = it->symlink_status(ec);
+    if (fs::is_symlink(status)) {
+      fs::remove(target, ec);
+      fs::copy_symlink(path, target, ec);
+      if (ec) {
+        LOG_WARN("Prefix template: cannot copy link " + path.string());
+        return false;
+      }
+    } else if (fs::is_directory(status)) {
+      fs::create_directories(target, ec);
+    } else if (fs::is_regular_file(status)) {
+      bool shared = isShared(rel);
+      switch (FileClone::clone(path, target, copyShared || !shared, shared)) {
+      case FileClone::Method::Reflink:
+        ++stats.reflinked;
+        break;
+      case FileClone::Method::Hardlink:
+        ++stats.linked;
+        fs::permissions(target,
+                        fs::perms::owner_write | fs::perms::group_write |
+                            fs::perms::others_write,
+                        fs::perm_options::remove, ec);
+        continue;
+      case FileClone::Method::Copy:
+        ++stats.copied;
+        break;
+      case FileClone::Method::None:
+        LOG_WARN("Prefix template: cannot copy " + path.string());
+        return false;
+      }
+      // A private copy of a read-only shared file is writable again
+      fs::permissions(target, fs::perms::owner_write, fs::perm_options::add,
+                      ec);
+    }
+  }
+  return true;
+}
+
+std::string PrefixTemplate::key(const wine::Prefix &pfx, bool proton,
+                                const std::string &dxvk) {
+  std::string wineserver = findInPath(pfx.bin("wineserver"));
+  struct stat st{};
+  std::string build = wineserver;
+  if (stat(wineserver.c_str(), &st) == 0)
+    build += "|" + std::to_string(st.st_size) + "|" +
+             std::to_string(st.st_mtim.tv_sec);
+
+  std::string id = "v1|" + build + (proton ? "|proton|" : "|wine|") + dxvk;
+  Md5 md5;
+  md5.update(id.data(), id.size());
+  return md5.hexdigest().substr(0, 16);
+}
+
+fs::path PrefixTemplate::dir(const std::string &key) {
+  return PathManager::instance().prefixTemplates() / key;
+}
+
+bool PrefixTemplate::exists(const std::string &key) {
+  std::error_code ec;
+  return fs::exists(dir(key) / "system.reg", ec) &&
+         fs::is_directory(dir(key) / "drive_c", ec);
+}
+
+bool PrefixTemplate::capture(const wine::Prefix &pfx, const std::string &key) {
+  if (exists(key))
+    return true;
+  fs::path prefixDir = pfx.dir();
+  if (!fs::exists(prefixDir / "system.reg") ||
+      !fs::exists(prefixDir / "user.reg"))
+    return false;
+  if (pfx.serverRunning()) {
+    LOG_DEBUG("Prefix template: wineserver still running, not capturing");
+    return false;
+  }
+
+  RSJFW_TRACE("PrefixTemplate::capture", key);
+  fs::path target = dir(key);
+  fs::path partial = target;
+  partial += ".partial-" + std::to_string(getpid());
+  std::error_code ec;
+  fs::remove_all(partial, ec);
+
+  // Runs on the first launch, so only links and the few small mutable files
+  // are affordable; a tree that would need a full copy isn't captured
+  CloneStats stats;
+  if (!copyTree(prefixDir, partial, false, stats)) {
+    fs::remove_all(partial, ec);
+    return false;
+  }
+  // The prefix now shares files with the template, like a clone of it
+  if (stats.linked > 0)
+    std::ofstream(prefixDir / kClonedMarker) << key << "\n";
+  fs::rename(partial, target, ec);
+  if (ec) {
+    // Someone else captured it first
+    fs::remove_all(partial, ec);
+    return exists(key);
+  }
+  LOG_INFO("Captured prefix template " + key + " (" +
+           std::to_string(stats.reflinked) + " reflinked, " +
+           std::to_string(stats.linked) + " hard-linked, " +
+           std::to_string(stats.copied) + " copied)");
+  return true;
+}
+
+void PrefixTemplate::prune(const std::string &keep, size_t max) {
+  std::error_code ec;
+  std::vector<std::pair<fs::file_time_type, fs::path>> others;
+  for (const auto &entry :
+       fs::directory_iterator(PathManager::instance().prefixTemplates(), ec)) {
+    std::string name = entry.path().filename().string();
+    size_t partial = name.find(".partial-");
+    if (partial != std::string::npos) {
+      // Left by a capture that died
+      pid_t pid = std::atoi(name.c_str() + partial + 9);
+      if (pid <= 0 || (::kill(pid, 0) != 0 && errno == ESRCH))
+        fs::remove_all(entry.path(), ec);
+    } else if (name != keep && entry.is_directory(ec)) {
+      others.emplace_back(fs::last_write_time(entry.path(), ec), entry.path());
+    }
+  }
+  if (others.size() + 1 <= max)
+    return;
+  std::sort(others.begin(), others.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+  // Clones keep their hard-linked files; only the template copy goes
+  for (size_t i = max > 0 ? max - 1 : 0; i < others.size(); ++i) {
+    LOG_INFO("Removing unused prefix template " +
+             others[i].second.filename().string());
+    fs::remove_all(others[i].second, ec);
+  }
+}
+
+bool PrefixTemplate::instantiate(const std::string &key,
+                                 const fs::path &prefixDir) {
+  if (!exists(key) || fs::exists(prefixDir / "system.reg"))
+    return false;
+
+  RSJFW_TRACE("PrefixTemplate::instantiate", key);
+  // Built next to the prefix, then moved in with the hives last, so an
+  // interrupted clone never looks like a prefix
+  fs::path staging = prefixDir;
+  staging += ".rsjfw-clone";
+  std::error_code ec;
+  fs::remove_all(staging, ec);
+
+  CloneStats stats;
+  if (!copyTree(dir(key), staging, true, stats)) {
+    fs::remove_all(staging, ec);
+    return false;
+  }
+  if (stats.linked > 0)
+    std::ofstream(staging / kClonedMarker) << key << "\n";
+
+  fs::create_directories(prefixDir, ec);
+  std::vector<fs::path> entries, hives;
+  for (const auto &entry : fs::directory_iterator(staging, ec))
+    (entry.path().extension() == ".reg" ? hives : entries)
+        .push_back(entry.path());
+  for (const auto &entry : entries) {
+    fs::path target = prefixDir / entry.filename();
+    fs::remove_all(target, ec);
+    fs::rename(entry, target, ec);
+    if (ec)
+      break;
+  }
+  for (const auto &hive : hives) {
+    if (ec)
+      break;
+    fs::rename(hive, prefixDir / hive.filename(), ec);
+  }
+  fs::remove_all(staging, ec);
+  if (!fs::exists(prefixDir / "system.reg")) {
+    LOG_WARN("Prefix template: failed to move clone into " +
+             prefixDir.string());
+    return false;
+  }
+
+  // Most recently used templates survive prune()
+  fs::last_write_time(dir(key), fs::file_time_type::clock::now(), ec);
+  LOG_INFO("Prefix created from template " + key + " (" +
+           std::to_string(stats.reflinked) + " reflinked, " +
+           std::to_string(stats.linked) + " hard-linked, " +
+           std::to_string(stats.copied) + " copied)");
+  return true;
+}
+
+std::string PrefixTemplate::clonedFrom(const fs::path &prefixDir) {
+  std::ifstream in(prefixDir / kClonedMarker);
+  std::string key;
+  if (in)
+    std::getline(in, key);
+  return key;
+}
+
+bool PrefixTemplate::detach(const fs::path &prefixDir) {
+  RSJFW_TRACE("PrefixTemplate::detach");
+  std::error_code ec;
+  size_t detached = 0;
+  fs::recursive_directory_iterator it(
+      prefixDir, fs::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    struct stat st{};
+    if (lstat(it->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_nlink < 2)
+      continue;
+    if (FileClone::clone(it->path(), it->path(), true, false) ==
+        FileClone::Method::None) {
+      LOG_WARN("Prefix template: cannot detach " + it->path().string());
+      return false;
+    }
+    // Shared files were read-only; the new Wine build updates its copies
+    fs::permissions(it->path(), fs::perms::owner_write, fs::perm_options::add,
+                    ec);
+    ++detached;
+  }
+  if (ec)
+    return false;
+  fs::remove(prefixDir / kClonedMarker, ec);
+  LOG_INFO("Detached prefix from its template (" + std::to_string(detached) +
+           " files)");
+  return true;
+}
+
+} // namespace rsjfw
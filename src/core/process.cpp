@@ -1,69 +1,228 @@
 #include "rsjfw/process.hpp"
-#include <filesystem>
-#include <fstream>
-#include <iostream>
 #include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 #include <unistd.h>
+#include <fcntl.h>
+#include <climits>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <algorithm>
 
 namespace rsjfw {
 
+namespace {
+
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// /proc stays open so per-process files are opened relative to it
+int procFd() {
+    static const int fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return fd;
+}
+
+// Numeric entries of /proc, read straight from getdents64
+std::vector<int> listPids() {
+    std::vector<int> pids;
+    int fd = openat(procFd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return pids;
+
+    alignas(LinuxDirent64) char buf[32768];
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<LinuxDirent64*>(buf + off);
+            off += d->d_reclen;
+            int pid = 0;
+            const char* c = d->d_name;
+            for (; *c >= '0' && *c <= '9'; ++c) pid = pid * 10 + (*c - '0');
+            if (*c == '\0' && c != d->d_name) pids.push_back(pid);
+        }
+    }
+    close(fd);
+    return pids;
+}
+
+// Reads /proc/<pid>/<file> with pread into one per-thread buffer. The view
+// is valid until the next call on the same thread and is NUL-terminated.
+std::string_view readProc(int pid, const char* file) {
+    thread_local std::vector<char> buf(16384);
+    char path[64];
+    snprintf(path, sizeof(path), "%d/%s", pid, file);
+    int fd = openat(procFd(), path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {};
+
+    size_t len = 0;
+    for (;;) {
+        size_t room = buf.size() - len - 1;
+        ssize_t n = pread(fd, buf.data() + len, room, static_cast<off_t>(len));
+        if (n <= 0) break;
+        len += static_cast<size_t>(n);
+        // /proc files fill the whole request unless they are done
+        if (static_cast<size_t>(n) < room) break;
+        buf.resize(buf.size() * 2);
+    }
+    close(fd);
+    buf[len] = '\0';
+    return std::string_view(buf.data(), len);
+}
+
+// Field 22 of /proc/<pid>/stat, in clock ticks since boot; 0 if gone
+unsigned long long startTimeOf(int pid) {
+    std::string_view stat = readProc(pid, "stat");
+    // The name in field 2 may contain spaces, so count from the last ')'
+    size_t i = stat.rfind(')');
+    if (i == std::string_view::npos) return 0;
+    int field = 2;
+    for (++i; i < stat.size() && field < 22; ++i) {
+        if (stat[i] == ' ') ++field;
+    }
+    if (field != 22) return 0;
+    return std::strtoull(stat.data() + i, nullptr, 10);
+}
+
+// What a scan learns about a process. Keyed by PID, and only trusted while
+// the start time and exe still match: a reused PID has a new start time, an
+// exec() a new exe.
+struct CachedProcess {
+    unsigned long long startTime = 0;
+    std::string exe;
+    bool prefixRead = false;
+    std::optional<std::string> prefix;
+};
+
+std::mutex cacheMutex;
+std::unordered_map<int, CachedProcess> cache;
+
+// Called with cacheMutex held
+CachedProcess* cached(int pid, const std::string& exe) {
+    unsigned long long start = startTimeOf(pid);
+    if (start == 0) {
+        cache.erase(pid);
+        return nullptr;
+    }
+    auto it = cache.find(pid);
+    if (it != cache.end() && it->second.startTime == start && it->second.exe == exe) {
+        return &it->second;
+    }
+    CachedProcess& entry = cache[pid];
+    entry = CachedProcess{};
+    entry.startTime = start;
+    entry.exe = exe;
+    return &entry;
+}
+
+// Drops entries for PIDs that no longer exist; called with cacheMutex held
+void prune(const std::vector<int>& live) {
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (std::binary_search(live.begin(), live.end(), it->first)) ++it;
+        else it = cache.erase(it);
+    }
+}
+
+} // namespace
+
 std::vector<ProcessInfo> Process::findByName(const std::string& name) {
     std::vector<ProcessInfo> found;
-    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
-        if (!entry.is_directory()) continue;
-        
-        std::string dirname = entry.path().filename().string();
-        if (!std::all_of(dirname.begin(), dirname.end(), ::isdigit)) continue;
-        
-        int pid = std::stoi(dirname);
+    std::vector<int> pids = listPids();
+    std::sort(pids.begin(), pids.end());
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (int pid : pids) {
         auto exe = getProcessExe(pid);
-        if (exe && exe->find(name) != std::string::npos) {
-            ProcessInfo info;
-            info.pid = pid;
-            info.name = name;
-            info.exe = *exe;
-            info.winePrefix = getProcessPrefix(pid).value_or("");
-            found.push_back(info);
+        if (!exe || exe->find(name) == std::string::npos) continue;
+
+        CachedProcess* entry = cached(pid, *exe);
+        if (!entry) continue;
+        if (!entry->prefixRead) {
+            entry->prefix = getProcessPrefix(pid);
+            entry->prefixRead = true;
         }
+        ProcessInfo info;
+        info.pid = pid;
+        info.name = name;
+        info.exe = *exe;
+        info.winePrefix = entry->prefix.value_or("");
+        found.push_back(info);
     }
+    prune(pids);
     return found;
 }
 
 std::vector<ProcessInfo> Process::findStudioInPrefix(const std::string& prefixDir) {
     std::vector<ProcessInfo> found;
-    std::filesystem::path targetPrefix = std::filesystem::absolute(prefixDir);
-
-    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
-        if (!entry.is_directory()) continue;
-        
-        std::string dirname = entry.path().filename().string();
-        if (!std::all_of(dirname.begin(), dirname.end(), ::isdigit)) continue;
-        
-        int pid = std::stoi(dirname);
+    struct stat target{};
+    if (stat(prefixDir.c_str(), &target) != 0) return found;
+
+    std::vector<int> pids = listPids();
+    std::sort(pids.begin(), pids.end());
+
+    std::unordered_map<std::string, bool> prefixes; // path -> is the target
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (int pid : pids) {
         auto exe = getProcessExe(pid);
         if (!exe || (exe->find("RobloxStudio") == std::string::npos && exe->find("wine") == std::string::npos)) continue;
 
-        auto prefix = getProcessPrefix(pid);
-        if (prefix) {
-             std::filesystem::path p(*prefix);
-             if (std::filesystem::exists(p) && std::filesystem::equivalent(p, targetPrefix)) {
-                 ProcessInfo info;
-                 info.pid = pid;
-                 info.exe = *exe;
-                 info.winePrefix = *prefix;
-                 found.push_back(info);
-             }
+        CachedProcess* entry = cached(pid, *exe);
+        if (!entry) continue;
+        if (!entry->prefixRead) {
+            entry->prefix = getProcessPrefix(pid);
+            entry->prefixRead = true;
+        }
+        if (!entry->prefix) continue;
+        // Stat'ed once per scan rather than cached with the process: a
+        // prefix deleted and set up again has a new inode
+        auto it = prefixes.find(*entry->prefix);
+        if (it == prefixes.end()) {
+            struct stat st{};
+            bool same = stat(entry->prefix->c_str(), &st) == 0 &&
+                        st.st_dev == target.st_dev && st.st_ino == target.st_ino;
+            it = prefixes.emplace(*entry->prefix, same).first;
         }
+        if (!it->second) continue;
+        // The preloader runs every Wine process, the wineserver included
+        if (exe->find("RobloxStudio") == std::string::npos && !isStudio(pid)) continue;
+
+        ProcessInfo info;
+        info.pid = pid;
+        info.exe = *exe;
+        info.winePrefix = *entry->prefix;
+        found.push_back(info);
+    }
+    prune(pids);
+    return found;
+}
+
+std::vector<int> Process::findStudio() {
+    std::vector<int> found;
+    for (int pid : listPids()) {
+        if (isStudio(pid)) found.push_back(pid);
     }
     return found;
 }
 
+bool Process::isStudio(int pid) {
+    // comm is cut at 15 characters: "RobloxStudioBet". Wine renames the
+    // process after start, so this is never cached.
+    return readProc(pid, "comm").rfind("RobloxStudioBet", 0) == 0;
+}
+
 bool Process::kill(int pid, bool force) {
     return ::kill(pid, force ? SIGKILL : SIGTERM) == 0;
 }
 
-bool Process::killAllInPrefix(const std::string& prefixDir) {
+bool Process::killStudioInPrefix(const std::string& prefixDir) {
     auto procs = findStudioInPrefix(prefixDir);
     bool allSuccess = true;
     for (const auto& p : procs) {
@@ -73,33 +232,33 @@ bool Process::killAllInPrefix(const std::string& prefixDir) {
 }
 
 std::optional<std::string> Process::getProcessPrefix(int pid) {
-    std::filesystem::path envPath = std::filesystem::path("/proc") / std::to_string(pid) / "environ";
-    std::ifstream ifs(envPath, std::ios::binary);
-    if (!ifs) return std::nullopt;
-
-    std::string env;
-    char c;
-    while (ifs.get(c)) {
-        if (c == '\0') {
-            if (env.find("WINEPREFIX=") == 0) {
-                return env.substr(11);
-            }
-            env.clear();
-        } else {
-            env += c;
+    static constexpr char key[] = "WINEPREFIX=";
+    constexpr size_t keyLen = sizeof(key) - 1;
+
+    std::string_view env = readProc(pid, "environ");
+    const char* begin = env.data();
+    const char* end = begin + env.size();
+    for (const char* p = begin; p < end;) {
+        auto* hit = static_cast<const char*>(memmem(p, static_cast<size_t>(end - p), key, keyLen));
+        if (!hit) break;
+        // Only at the start of a variable, not inside another one's value
+        if (hit == begin || hit[-1] == '\0') {
+            const char* value = hit + keyLen;
+            auto* stop = static_cast<const char*>(memchr(value, '\0', static_cast<size_t>(end - value)));
+            return std::string(value, stop ? stop : end);
         }
+        p = hit + 1;
     }
     return std::nullopt;
 }
 
 std::optional<std::string> Process::getProcessExe(int pid) {
-    try {
-        std::filesystem::path exePath = std::filesystem::path("/proc") / std::to_string(pid) / "exe";
-        if (std::filesystem::exists(exePath)) {
-            return std::filesystem::read_symlink(exePath).string();
-        }
-    } catch (...) {}
-    return std::nullopt;
+    char path[32];
+    snprintf(path, sizeof(path), "%d/exe", pid);
+    char target[PATH_MAX];
+    ssize_t n = readlinkat(procFd(), path, target, sizeof(target));
+    if (n <= 0) return std::nullopt;
+    return std::string(target, static_cast<size_t>(n));
 }
 
 } // namespace rsjfw
@@ -0,0 +1,385 @@
+#include "rsjfw/process_supervisor.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/path_manager.hpp"
+#include "rsjfw/process.hpp"
+#include "rsjfw/state.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+namespace rsjfw {
+
+namespace {
+
+// New descendants show up in the first seconds after a launch; after that
+// the tree is walked rarely
+constexpr auto kBusyPeriod = std::chrono::seconds(30);
+constexpr int kBusyScanMs = 500;
+constexpr int kIdleScanMs = 5000;
+
+// epoll tags besides PIDs: 0 is the wake eventfd
+constexpr uint64_t kAnnounceTag = ~0ull;
+constexpr const char *kLaunchFile = ".studio-launch";
+
+int pidfdOpen(int pid) {
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+std::vector<int> childrenOf(int pid) {
+  std::vector<int> children;
+  std::string taskDir = "/proc/" + std::to_string(pid) + "/task";
+  DIR *dir = opendir(taskDir.c_str());
+  if (!dir)
+    return children;
+  while (dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+      continue;
+    std::ifstream in(taskDir + "/" + entry->d_name + "/children");
+    int child;
+    while (in >> child)
+      children.push_back(child);
+  }
+  closedir(dir);
+  return children;
+}
+
+// Start time as Unix time, 0 if unknown
+long startTimeOf(int pid) {
+  static const long bootTime = [] {
+    std::ifstream stat("/proc/stat");
+    std::string key;
+    long value = 0;
+    while (stat >> key) {
+      if (key == "btime") {
+        stat >> value;
+        break;
+      }
+      stat.ignore(4096, '\n');
+    }
+    return value;
+  }();
+  static const long ticks = sysconf(_SC_CLK_TCK);
+
+  std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+  std::string line;
+  if (!bootTime || ticks <= 0 || !std::getline(in, line))
+    return 0;
+  // Field 22; the name in field 2 may contain spaces, so count from ')'
+  size_t close = line.rfind(')');
+  if (close == std::string::npos)
+    return 0;
+  std::istringstream fields(line.substr(close + 2));
+  std::string field;
+  for (int i = 3; i < 22 && fields >> field; ++i) {
+  }
+  unsigned long long start = 0;
+  if (!(fields >> start))
+    return 0;
+  return bootTime + static_cast<long>(start / ticks);
+}
+
+int exitCodeOf(const siginfo_t &info) {
+  if (info.si_pid == 0)
+    return -1;
+  return info.si_code == CLD_EXITED ? info.si_status : 128 + info.si_status;
+}
+
+} // namespace
+
+ProcessSupervisor &ProcessSupervisor::instance() {
+  static ProcessSupervisor instance;
+  return instance;
+}
+
+ProcessSupervisor::~ProcessSupervisor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  if (thread_.joinable()) {
+    wake();
+    thread_.join();
+  }
+  for (auto &[pid, t] : tracked_)
+    if (t.pidfd >= 0)
+      close(t.pidfd);
+  if (epollFd_ >= 0)
+    close(epollFd_);
+  if (wakeFd_ >= 0)
+    close(wakeFd_);
+  if (inotifyFd_ >= 0)
+    close(inotifyFd_);
+}
+
+void ProcessSupervisor::watch(int pid, bool reap) {
+  if (pid <= 0)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    start();
+    pending_.emplace_back(pid, reap);
+    lastWatch_ = std::chrono::steady_clock::now();
+  }
+  wake();
+}
+
+void ProcessSupervisor::adoptRunning() {
+  std::vector<int> studio = Process::findStudio();
+  if (studio.empty())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    start();
+    for (int pid : studio)
+      pending_.emplace_back(pid, false);
+  }
+  wake();
+}
+
+void ProcessSupervisor::announceLaunch(int pid) {
+  std::filesystem::path file = PathManager::instance().root() / kLaunchFile;
+  std::filesystem::path tmp = file;
+  tmp += "." + std::to_string(getpid());
+  std::ofstream(tmp) << pid << "\n";
+  // Renamed into place so a follower only ever sees a whole PID
+  std::error_code ec;
+  std::filesystem::rename(tmp, file, ec);
+}
+
+void ProcessSupervisor::followLaunches() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  start();
+  if (inotifyFd_ >= 0 || epollFd_ < 0)
+    return;
+  inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd_ < 0 ||
+      inotify_add_watch(inotifyFd_, PathManager::instance().root().c_str(),
+                        IN_MOVED_TO) < 0) {
+    LOG_WARN("Process supervisor: cannot follow launches: " +
+             std::string(strerror(errno)));
+    if (inotifyFd_ >= 0)
+      close(inotifyFd_);
+    inotifyFd_ = -1;
+    return;
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = kAnnounceTag;
+  epoll_ctl(epollFd_, EPOLL_CTL_ADD, inotifyFd_, &ev);
+}
+
+// On the loop thread
+void ProcessSupervisor::readAnnouncements() {
+  alignas(inotify_event) char buf[4096];
+  bool announced = false;
+  ssize_t n;
+  while ((n = read(inotifyFd_, buf, sizeof(buf))) > 0) {
+    for (ssize_t off = 0; off < n;) {
+      auto *ev = reinterpret_cast<inotify_event *>(buf + off);
+      off += sizeof(inotify_event) + ev->len;
+      if (ev->len && std::strcmp(ev->name, kLaunchFile) == 0)
+        announced = true;
+    }
+  }
+  if (!announced)
+    return;
+
+  int pid = 0;
+  std::ifstream(PathManager::instance().root() / kLaunchFile) >> pid;
+  if (pid <= 0)
+    return;
+  track(pid, false);
+  std::lock_guard<std::mutex> lock(mutex_);
+  lastWatch_ = std::chrono::steady_clock::now();
+}
+
+// Called with mutex_ held
+void ProcessSupervisor::start() {
+  if (thread_.joinable() || stopping_)
+    return;
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (epollFd_ < 0 || wakeFd_ < 0) {
+    LOG_ERROR("Process supervisor: " + std::string(strerror(errno)));
+    return;
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = 0; // PID 0 is never tracked
+  epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+  thread_ = std::thread([this]() { loop(); });
+}
+
+void ProcessSupervisor::wake() {
+  if (wakeFd_ >= 0) {
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd_, &one, sizeof(one));
+    (void)n;
+  }
+}
+
+void ProcessSupervisor::loop() {
+  auto nextScan = std::chrono::steady_clock::now();
+  epoll_event events[16];
+
+  for (;;) {
+    std::vector<std::pair<int, bool>> pending;
+    std::chrono::steady_clock::time_point lastWatch;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_)
+        return;
+      pending.swap(pending_);
+      lastWatch = lastWatch_;
+    }
+    for (auto [pid, reap] : pending)
+      track(pid, reap);
+
+    auto now = std::chrono::steady_clock::now();
+    int interval = now - lastWatch < kBusyPeriod ? kBusyScanMs : kIdleScanMs;
+    if (!pidfdSupported_)
+      interval = std::min(interval, 1000);
+    if (!pending.empty() || now >= nextScan) {
+      discover();
+      nextScan = now + std::chrono::milliseconds(interval);
+    }
+
+    int timeout = -1;
+    if (!tracked_.empty())
+      timeout = std::max<int>(
+          0, std::chrono::duration_cast<std::chrono::milliseconds>(nextScan -
+                                                                   now)
+                 .count());
+    int n = epoll_wait(epollFd_, events, 16, timeout);
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.u64 == 0) {
+        uint64_t count;
+        ssize_t r = read(wakeFd_, &count, sizeof(count));
+        (void)r;
+      } else if (events[i].data.u64 == kAnnounceTag) {
+        readAnnouncements();
+        nextScan = std::chrono::steady_clock::now();
+      } else {
+        exited(static_cast<int>(events[i].data.u64));
+      }
+    }
+  }
+}
+
+void ProcessSupervisor::track(int pid, bool reap) {
+  auto it = tracked_.find(pid);
+  if (it != tracked_.end()) {
+    it->second.reap = it->second.reap || reap;
+    return;
+  }
+
+  Tracked t;
+  t.reap = reap;
+  if (pidfdSupported_) {
+    t.pidfd = pidfdOpen(pid);
+    if (t.pidfd < 0) {
+      if (errno != ENOSYS)
+        return; // Already gone
+      LOG_DEBUG("pidfd_open unavailable, checking processes on each scan");
+      pidfdSupported_ = false;
+    } else {
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.u64 = static_cast<uint64_t>(pid);
+      epoll_ctl(epollFd_, EPOLL_CTL_ADD, t.pidfd, &ev);
+    }
+  }
+  if (!pidfdSupported_ && ::kill(pid, 0) != 0)
+    return;
+
+  tracked_.emplace(pid, t);
+}
+
+void ProcessSupervisor::discover() {
+  std::vector<int> queue;
+  for (const auto &[pid, t] : tracked_)
+    queue.push_back(pid);
+  for (size_t i = 0; i < queue.size(); ++i) {
+    for (int child : childrenOf(queue[i])) {
+      if (tracked_.count(child))
+        continue;
+      track(child, false);
+      if (tracked_.count(child))
+        queue.push_back(child);
+    }
+  }
+
+  // The loader only becomes Studio once Wine has started the exe
+  std::vector<int> gone;
+  for (auto &[pid, t] : tracked_) {
+    if (!pidfdSupported_) {
+      siginfo_t info{};
+      bool dead = t.reap ? waitid(P_PID, pid, &info,
+                                  WEXITED | WNOHANG | WNOWAIT) == 0 &&
+                               info.si_pid == pid
+                         : ::kill(pid, 0) != 0;
+      if (dead) {
+        gone.push_back(pid);
+        continue;
+      }
+    }
+    if (!t.studio && Process::isStudio(pid)) {
+      t.studio = true;
+      LOG_INFO("Studio running (pid " + std::to_string(pid) + ")");
+      State::instance().addStudioInstance(pid, startTimeOf(pid));
+    }
+  }
+  for (int pid : gone)
+    exited(pid);
+}
+
+void ProcessSupervisor::exited(int pid) {
+  auto it = tracked_.find(pid);
+  if (it == tracked_.end())
+    return;
+  Tracked t = it->second;
+  tracked_.erase(it);
+
+  // Only our own children have a status to collect; WNOWAIT leaves it for
+  // a caller that is waiting on the process itself
+  siginfo_t info{};
+  int flags = WEXITED | WNOHANG | (t.reap ? 0 : WNOWAIT);
+  int code = -1;
+  if (t.pidfd >= 0) {
+    if (waitid(static_cast<idtype_t>(P_PIDFD), static_cast<id_t>(t.pidfd),
+               &info, flags) == 0)
+      code = exitCodeOf(info);
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, t.pidfd, nullptr);
+    close(t.pidfd);
+  } else if (waitid(P_PID, static_cast<id_t>(pid), &info, flags) == 0) {
+    code = exitCodeOf(info);
+  }
+
+  if (t.studio) {
+    LOG_INFO("Studio (pid " + std::to_string(pid) + ") exited" +
+             (code >= 0 ? " with code " + std::to_string(code) : ""));
+    State::instance().markStudioExited(pid, code);
+  }
+}
+
+} // namespace rsjfw
@@ -1,12 +1,632 @@
 #include "rsjfw/registry.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/trace.hpp"
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace rsjfw {
 
+namespace {
+
+std::string lower(std::string s) {
+  for (auto &c : s)
+    if (c >= 'A' && c <= 'Z')
+      c = static_cast<char>(c - 'A' + 'a');
+  return s;
+}
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+void appendUtf8(std::string &out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xc0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xe0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  }
+}
+
+std::u16string toUtf16(const std::string &s) {
+  std::u16string out;
+  for (size_t i = 0; i < s.size();) {
+    auto c = static_cast<unsigned char>(s[i]);
+    uint32_t cp = c;
+    size_t len = 1;
+    if (c >= 0xf0 && i + 3 < s.size()) {
+      cp = ((c & 0x07) << 18) | ((s[i + 1] & 0x3f) << 12) |
+           ((s[i + 2] & 0x3f) << 6) | (s[i + 3] & 0x3f);
+      len = 4;
+    } else if (c >= 0xe0 && i + 2 < s.size()) {
+      cp = ((c & 0x0f) << 12) | ((s[i + 1] & 0x3f) << 6) | (s[i + 2] & 0x3f);
+      len = 3;
+    } else if (c >= 0xc0 && i + 1 < s.size()) {
+      cp = ((c & 0x1f) << 6) | (s[i + 1] & 0x3f);
+      len = 2;
+    }
+    i += len;
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      out += static_cast<char16_t>(0xd800 | (cp >> 10));
+      out += static_cast<char16_t>(0xdc00 | (cp & 0x3ff));
+    } else {
+      out += static_cast<char16_t>(cp);
+    }
+  }
+  return out;
+}
+
+// Wine's escaping (server/unicode.c dump_strW): the hives store UTF-16
+// code units, with anything outside printable ASCII as \x escapes
+std::string escape(const std::string &s, const char *special) {
+  std::u16string w = toUtf16(s);
+  std::string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < w.size(); ++i) {
+    char16_t c = w[i];
+    switch (c) {
+    case '\n':
+      out += "\\n";
+      continue;
+    case '\r':
+      out += "\\r";
+      continue;
+    case '\t':
+      out += "\\t";
+      continue;
+    case '\\':
+      out += "\\\\";
+      continue;
+    }
+    if (c < 128 && std::strchr(special, static_cast<char>(c)) && c != 0) {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < ' ' || c >= 127) {
+      char buf[16];
+      bool hexNext = i + 1 < w.size() && w[i + 1] < 128 &&
+                     hexDigit(static_cast<char>(w[i + 1])) >= 0;
+      std::snprintf(buf, sizeof(buf), hexNext ? "\\x%04x" : "\\x%x",
+                    static_cast<unsigned>(c));
+      out += buf;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  return out;
+}
+
+// Reads an escaped string starting at `pos` up to the unescaped `end`
+// character; `pos` is left just past it. False if `end` never appears.
+bool unescape(const std::string &s, size_t &pos, char end, std::string &out) {
+  std::u16string w;
+  while (pos < s.size() && s[pos] != end) {
+    char c = s[pos++];
+    if (c != '\\') {
+      // Raw bytes (UTF-8 from other writers) pass through as-is
+      if (static_cast<unsigned char>(c) >= 0x80) {
+        std::string raw(1, c);
+        while (pos < s.size() &&
+               (static_cast<unsigned char>(s[pos]) & 0xc0) == 0x80)
+          raw += s[pos++];
+        w += toUtf16(raw);
+      } else {
+        w += static_cast<char16_t>(c);
+      }
+      continue;
+    }
+    if (pos >= s.size())
+      break;
+    c = s[pos++];
+    switch (c) {
+    case 'a': w += u'\a'; break;
+    case 'b': w += u'\b'; break;
+    case 'e': w += u'\x1b'; break;
+    case 'f': w += u'\f'; break;
+    case 'n': w += u'\n'; break;
+    case 'r': w += u'\r'; break;
+    case 't': w += u'\t'; break;
+    case 'v': w += u'\v'; break;
+    case 'x': {
+      unsigned v = 0;
+      int n = 0;
+      while (n < 4 && pos < s.size() && hexDigit(s[pos]) >= 0) {
+        v = v * 16 + hexDigit(s[pos++]);
+        ++n;
+      }
+      w += static_cast<char16_t>(v);
+      break;
+    }
+    default:
+      if (c >= '0' && c <= '7') {
+        unsigned v = c - '0';
+        for (int n = 1; n < 3 && pos < s.size() && s[pos] >= '0' && s[pos] <= '7';
+             ++n)
+          v = v * 8 + (s[pos++] - '0');
+        w += static_cast<char16_t>(v);
+      } else {
+        w += static_cast<char16_t>(c);
+      }
+    }
+  }
+  if (pos >= s.size())
+    return false;
+  ++pos;
+
+  out.clear();
+  for (size_t i = 0; i < w.size(); ++i) {
+    uint32_t cp = w[i];
+    if (cp >= 0xd800 && cp < 0xdc00 && i + 1 < w.size() && w[i + 1] >= 0xdc00 &&
+        w[i + 1] < 0xe000)
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (w[++i] - 0xdc00);
+    appendUtf8(out, cp);
+  }
+  return true;
+}
+
+bool parseHex(const std::string &s, std::vector<unsigned char> &out) {
+  out.clear();
+  int hi = -1;
+  for (char c : s) {
+    if (c == ',' || c == ' ' || c == '\t' || c == '\\' || c == '\n' ||
+        c == '\r') {
+      if (hi >= 0)
+        out.push_back(static_cast<unsigned char>(hi));
+      hi = -1;
+      continue;
+    }
+    int d = hexDigit(c);
+    if (d < 0)
+      return false;
+    if (hi < 0) {
+      hi = d;
+    } else {
+      out.push_back(static_cast<unsigned char>(hi * 16 + d));
+      hi = -1;
+    }
+  }
+  if (hi >= 0)
+    out.push_back(static_cast<unsigned char>(hi));
+  return true;
+}
+
+// Fills the typed fields of `v` from the text after '='
+void decodeValue(RegistryHive::Value &v) {
+  const std::string &t = v.raw;
+  v.type = 0;
+  if (t.empty())
+    return;
+  size_t pos = 0;
+  if (t[0] == '"') {
+    pos = 1;
+    if (unescape(t, pos, '"', v.str))
+      v.type = RegistryHive::SZ;
+  } else if (t.compare(0, 4, "str:") == 0 || t.compare(0, 4, "str(") == 0) {
+    uint32_t type = RegistryHive::SZ;
+    pos = 3;
+    if (t[3] == '(') {
+      type = static_cast<uint32_t>(std::strtoul(t.c_str() + 4, nullptr, 16));
+      pos = t.find(')', 4);
+      if (pos == std::string::npos)
+        return;
+      ++pos;
+    }
+    if (t.compare(pos, 2, ":\"") != 0)
+      return;
+    pos += 2;
+    if (unescape(t, pos, '"', v.str))
+      v.type = type;
+  } else if (t.compare(0, 6, "dword:") == 0) {
+    v.dword = static_cast<uint32_t>(std::strtoul(t.c_str() + 6, nullptr, 16));
+    v.type = RegistryHive::DWORD;
+  } else if (t.compare(0, 3, "hex") == 0) {
+    uint32_t type = RegistryHive::BINARY;
+    pos = 3;
+    if (t.size() > 3 && t[3] == '(') {
+      type = static_cast<uint32_t>(std::strtoul(t.c_str() + 4, nullptr, 16));
+      pos = t.find(')', 4);
+      if (pos == std::string::npos)
+        return;
+      ++pos;
+    }
+    if (pos >= t.size() || t[pos] != ':')
+      return;
+    if (parseHex(t.substr(pos + 1), v.data))
+      v.type = type;
+  }
+}
+
+std::string encodeValue(const RegistryHive::Value &v) {
+  char buf[32];
+  switch (v.type) {
+  case RegistryHive::SZ:
+    return "\"" + escape(v.str, "\"") + "\"";
+  case RegistryHive::DWORD:
+    std::snprintf(buf, sizeof(buf), "dword:%08x", v.dword);
+    return buf;
+  case RegistryHive::EXPAND_SZ:
+    return "str(2):\"" + escape(v.str, "\"") + "\"";
+  default:
+    break;
+  }
+  std::string out;
+  if (v.type == RegistryHive::BINARY) {
+    out = "hex:";
+  } else {
+    std::snprintf(buf, sizeof(buf), "hex(%x):", v.type);
+    out = buf;
+  }
+  // Wrapped like Wine does so lines stay readable
+  size_t col = out.size();
+  for (size_t i = 0; i < v.data.size(); ++i) {
+    std::snprintf(buf, sizeof(buf), "%02x", v.data[i]);
+    out += buf;
+    col += 2;
+    if (i + 1 < v.data.size()) {
+      out += ',';
+      if (++col > 76) {
+        out += "\\\n  ";
+        col = 2;
+      }
+    }
+  }
+  return out;
+}
+
+std::string stripRoot(const std::string &key, const char *root) {
+  size_t n = std::strlen(root);
+  if (key.size() < n || lower(key.substr(0, n)) != root)
+    return {};
+  if (key.size() == n)
+    return "\\";
+  if (key[n] != '\\')
+    return {};
+  return key.substr(n);
+}
+
+struct CachedHive {
+  struct timespec mtime{};
+  off_t size = 0;
+  std::shared_ptr<const RegistryHive> hive;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedHive> cache;
+
+} // namespace
+
+bool RegistryHive::load(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+
+  preamble_.clear();
+  keys_.clear();
+  index_.clear();
+
+  Key *current = nullptr;
+  size_t pos = 0;
+  std::string line;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    if (eol == std::string::npos)
+      eol = text.size();
+    line.assign(text, pos, eol - pos);
+    pos = eol + 1;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    if (!current && (line.empty() || line[0] != '[')) {
+      preamble_.push_back(line);
+      continue;
+    }
+    if (line.empty())
+      continue;
+
+    if (line[0] == '[') {
+      size_t p = 1;
+      std::string name;
+      if (!unescape(line, p, ']', name))
+        return false;
+      Key key;
+      key.rawName = line.substr(1, p - 2);
+      key.modified = std::strtoll(line.c_str() + p, nullptr, 10);
+      std::string id = lower(name);
+      auto it = index_.find(id);
+      if (it != index_.end()) {
+        current = &keys_[it->second];
+      } else {
+        index_.emplace(std::move(id), keys_.size());
+        keys_.push_back(std::move(key));
+        current = &keys_.back();
+      }
+      continue;
+    }
+
+    if (line[0] == '#') {
+      current->meta.push_back(line);
+      continue;
+    }
+
+    if (line[0] != '"' && line[0] != '@') {
+      current->meta.push_back(line);
+      continue;
+    }
+
+    Value v;
+    size_t p = 1;
+    if (line[0] == '"' && !unescape(line, p, '"', v.name))
+      return false;
+    if (p >= line.size() || line[p] != '=')
+      return false;
+    v.raw = line.substr(p + 1);
+    // Long hex data continues on the next lines after a trailing backslash
+    while (!v.raw.empty() && v.raw.back() == '\\' &&
+           v.raw.compare(0, 3, "hex") == 0 && pos < text.size()) {
+      v.raw.pop_back();
+      eol = text.find('\n', pos);
+      if (eol == std::string::npos)
+        eol = text.size();
+      line.assign(text, pos, eol - pos);
+      pos = eol + 1;
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      size_t start = line.find_first_not_of(" \t");
+      v.raw += start == std::string::npos ? "" : line.substr(start);
+    }
+    decodeValue(v);
+
+    std::string id = lower(v.name);
+    auto it = current->index.find(id);
+    if (it != current->index.end()) {
+      current->values[it->second] = std::move(v);
+    } else {
+      current->index.emplace(std::move(id), current->values.size());
+      current->values.push_back(std::move(v));
+    }
+  }
+  return true;
+}
+
+bool RegistryHive::save(const std::filesystem::path &path) const {
+  std::string out;
+  for (const auto &line : preamble_)
+    out += line + "\n";
+
+  const time_t now = std::time(nullptr);
+  // FILETIME: 100ns ticks since 1601
+  const uint64_t ticks = (static_cast<uint64_t>(now) + 11644473600ULL) * 10000000ULL;
+  char stamp[40];
+  std::snprintf(stamp, sizeof(stamp), "#time=%x%08x",
+                static_cast<unsigned>(ticks >> 32),
+                static_cast<unsigned>(ticks & 0xffffffffu));
+
+  for (const auto &key : keys_) {
+    out += "[" + key.rawName + "] " +
+           std::to_string(key.dirty ? static_cast<int64_t>(now) : key.modified) +
+           "\n";
+    bool hasTime = false;
+    for (const auto &m : key.meta) {
+      if (key.dirty && m.compare(0, 6, "#time=") == 0) {
+        out += stamp;
+        out += '\n';
+        hasTime = true;
+      } else {
+        out += m + "\n";
+      }
+    }
+    if (key.dirty && !hasTime) {
+      out += stamp;
+      out += '\n';
+    }
+    for (const auto &v : key.values) {
+      out += v.name.empty() ? "@" : "\"" + escape(v.name, "\"") + "\"";
+      out += "=";
+      out += v.raw.empty() && v.type != 0 ? encodeValue(v) : v.raw;
+      out += "\n";
+    }
+    out += "\n";
+  }
+
+  std::filesystem::path tmp = path;
+  tmp += ".rsjfw-tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return false;
+  size_t done = 0;
+  while (done < out.size()) {
+    ssize_t n = ::write(fd, out.data() + done, out.size() - done);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    done += static_cast<size_t>(n);
+  }
+  bool ok = done == out.size() && ::fsync(fd) == 0;
+  ok = ::close(fd) == 0 && ok;
+  if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool RegistryHive::hasKey(const std::string &key) const {
+  return index_.count(lower(key)) > 0;
+}
+
+const RegistryHive::Value *RegistryHive::find(const std::string &key,
+                                              const std::string &name) const {
+  auto it = index_.find(lower(key));
+  if (it == index_.end())
+    return nullptr;
+  const Key &k = keys_[it->second];
+  auto vit = k.index.find(lower(name));
+  return vit == k.index.end() ? nullptr : &k.values[vit->second];
+}
+
+RegistryHive::Key &RegistryHive::keyFor(const std::string &path) {
+  std::string id = lower(path);
+  auto it = index_.find(id);
+  if (it != index_.end())
+    return keys_[it->second];
+  Key key;
+  key.rawName = escape(path, "[]");
+  index_.emplace(std::move(id), keys_.size());
+  keys_.push_back(std::move(key));
+  return keys_.back();
+}
+
+void RegistryHive::set(const std::string &key, Value value) {
+  Key &k = keyFor(key);
+  k.dirty = true;
+  value.raw.clear();
+  std::string id = lower(value.name);
+  auto it = k.index.find(id);
+  if (it != k.index.end()) {
+    k.values[it->second] = std::move(value);
+  } else {
+    k.index.emplace(std::move(id), k.values.size());
+    k.values.push_back(std::move(value));
+  }
+}
+
+bool RegistryHive::resolve(const std::string &fullKey, std::string &hiveFile,
+                           std::string &keyPath) {
+  std::string rest;
+  if (!(rest = stripRoot(fullKey, "hkey_current_user")).empty() ||
+      !(rest = stripRoot(fullKey, "hkcu")).empty()) {
+    hiveFile = "user.reg";
+  } else if (!(rest = stripRoot(fullKey, "hkey_local_machine")).empty() ||
+             !(rest = stripRoot(fullKey, "hklm")).empty()) {
+    hiveFile = "system.reg";
+  } else if (!(rest = stripRoot(fullKey, "hkey_classes_root")).empty() ||
+             !(rest = stripRoot(fullKey, "hkcr")).empty()) {
+    // What regedit does with HKCR: machine-wide classes
+    hiveFile = "system.reg";
+    rest = "\\Software\\Classes" + (rest == "\\" ? "" : rest);
+  } else {
+    return false;
+  }
+  size_t start = rest.find_first_not_of('\\');
+  size_t end = rest.find_last_not_of('\\');
+  if (start == std::string::npos)
+    return false;
+  keyPath = rest.substr(start, end - start + 1);
+  return true;
+}
+
+std::shared_ptr<const RegistryHive>
+RegistryHive::open(const std::filesystem::path &file) {
+  struct stat st{};
+  if (::stat(file.c_str(), &st) != 0)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto &entry = cache[file.string()];
+  if (entry.hive && entry.size == st.st_size &&
+      entry.mtime.tv_sec == st.st_mtim.tv_sec &&
+      entry.mtime.tv_nsec == st.st_mtim.tv_nsec)
+    return entry.hive;
+
+  RSJFW_TRACE("registry::load", file.filename().string());
+  auto hive = std::make_shared<RegistryHive>();
+  if (!hive->load(file)) {
+    LOG_WARN("Could not parse registry hive " + file.string());
+    cache.erase(file.string());
+    return nullptr;
+  }
+  entry.mtime = st.st_mtim;
+  entry.size = st.st_size;
+  entry.hive = hive;
+  return hive;
+}
+
+bool RegistryHive::apply(const std::filesystem::path &prefixDir,
+                         const std::vector<wine::Prefix::RegistryEntry> &entries) {
+  RSJFW_TRACE("registry::apply");
+  std::map<std::string, std::shared_ptr<RegistryHive>> hives;
+  std::vector<std::pair<std::string, std::string>> targets;
+  for (const auto &entry : entries) {
+    std::string file, path;
+    if (!resolve(entry.key, file, path))
+      return false;
+    if (!hives.count(file)) {
+      auto hive = open(prefixDir / file);
+      if (!hive)
+        return false;
+      hives[file] = std::make_shared<RegistryHive>(*hive);
+    }
+    targets.emplace_back(std::move(file), std::move(path));
+  }
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const auto &entry = entries[i];
+    Value v;
+    v.name = entry.valueName;
+    if (entry.type == "REG_DWORD") {
+      v.type = DWORD;
+      try {
+        v.dword = static_cast<uint32_t>(std::stoul(entry.value, nullptr, 0));
+      } catch (...) {
+        v.dword = 0;
+      }
+    } else if (entry.type == "REG_BINARY") {
+      v.type = BINARY;
+      // Accepts both "aa,bb,cc" and reg-add style "aabbcc"
+      if (!parseHex(entry.value, v.data))
+        return false;
+    } else if (entry.type == "REG_EXPAND_SZ") {
+      v.type = EXPAND_SZ;
+      v.str = entry.value;
+    } else if (entry.type.empty() || entry.type == "REG_SZ") {
+      v.type = SZ;
+      v.str = entry.value;
+    } else {
+      return false;
+    }
+    hives[targets[i].first]->set(targets[i].second, std::move(v));
+  }
+
+  for (auto &[file, hive] : hives) {
+    if (!hive->save(prefixDir / file)) {
+      LOG_ERROR("Failed to write registry hive " + (prefixDir / file).string());
+      return false;
+    }
+  }
+  return true;
+}
+
 Registry::Registry(rsjfw::wine::Prefix &pfx) : pfx_(pfx) {}
 
 bool Registry::add(const std::string &key, const std::string &valueName,
@@ -31,18 +651,41 @@ bool Registry::addBinary(const std::string &key, const std::string &valueName,
   return pfx_.registryAdd(key, valueName, ss.str(), "REG_BINARY");
 }
 
+bool Registry::lookup(const std::string &key, const std::string &valueName,
+                      const RegistryHive::Value *&value,
+                      std::shared_ptr<const RegistryHive> &hive) {
+  std::string file, path;
+  if (!RegistryHive::resolve(key, file, path) || pfx_.serverRunning())
+    return false;
+  hive = RegistryHive::open(std::filesystem::path(pfx_.dir()) / file);
+  if (!hive)
+    return false;
+  value = hive->find(path, valueName);
+  return true;
+}
+
 bool Registry::exists(const std::string &key, const std::string &valueName) {
-  std::vector<std::string> args = {"query", key, "/v", valueName};
-  bool found = false;
+  const RegistryHive::Value *value = nullptr;
+  std::shared_ptr<const RegistryHive> hive;
+  if (lookup(key, valueName, value, hive))
+    return value != nullptr;
 
-  // reg query returns 0 (true) if found, but we need to check exit code
-  // The Prefix::wine function returns true if the process executed successfully
-  // (exit code 0) So if it returns true, the key exists.
+  // reg query exits 0 only if the value exists
+  std::vector<std::string> args = {"query", key, "/v", valueName};
   return pfx_.wine("reg", args, nullptr, "", true);
 }
 
 std::string Registry::readString(const std::string &key,
                                  const std::string &valueName) {
+  const RegistryHive::Value *value = nullptr;
+  std::shared_ptr<const RegistryHive> hive;
+  if (lookup(key, valueName, value, hive)) {
+    if (value && (value->type == RegistryHive::SZ ||
+                  value->type == RegistryHive::EXPAND_SZ))
+      return value->str;
+    return "";
+  }
+
   std::vector<std::string> args = {"query", key, "/v", valueName};
   std::string result = "";
 
@@ -69,6 +712,16 @@ std::string Registry::readString(const std::string &key,
 
 std::vector<unsigned char> Registry::readBinary(const std::string &key,
                                                 const std::string &valueName) {
+  const RegistryHive::Value *value = nullptr;
+  std::shared_ptr<const RegistryHive> hive;
+  if (lookup(key, valueName, value, hive)) {
+    if (value && value->type != RegistryHive::SZ &&
+        value->type != RegistryHive::EXPAND_SZ &&
+        value->type != RegistryHive::DWORD)
+      return value->data;
+    return {};
+  }
+
   std::vector<std::string> args = {"query", key, "/v", valueName};
   std::string result = "";
 
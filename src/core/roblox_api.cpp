@@ -1,5 +1,6 @@
 #include "rsjfw/roblox_api.hpp"
 #include "rsjfw/http.hpp"
+#include "rsjfw/mirror.hpp"
 #include "json.hpp"
 #include <sstream>
 #include <iostream>
@@ -15,17 +16,29 @@ static std::string trim(const std::string& s) {
 
 const std::string RobloxAPI::BASE_URL = "https://setup.rbxcdn.com/";
 
+std::string RobloxAPI::normalizeChannel(const std::string& channel) {
+    return channel == "production" ? "LIVE" : channel;
+}
+
+std::string RobloxAPI::baseUrl() {
+    return Mirror::enabled() ? Mirror::url("setup/") : BASE_URL;
+}
+
 std::string RobloxAPI::getLatestVersionGUID(const std::string& channel) {
-    std::string url = "https://clientsettings.roblox.com/v2/client-version/WindowsStudio64";
-    
-    std::string lookupChannel = channel;
-    if (lookupChannel == "production") lookupChannel = "LIVE";
+    std::string lookupChannel = normalizeChannel(channel);
 
-    if (lookupChannel != "LIVE") {
-        url += "?channel=" + lookupChannel;
+    std::string url;
+    if (Mirror::enabled()) {
+        url = Mirror::url("clientsettings/" + lookupChannel + ".json");
+    } else {
+        url = "https://clientsettings.roblox.com/v2/client-version/WindowsStudio64";
+        if (lookupChannel != "LIVE") {
+            url += "?channel=" + lookupChannel;
+        }
     }
-    
-    std::string response = HTTP::get(url);
+
+    // Checked on every launch; a short TTL keeps warm launches off the network
+    std::string response = HTTP::getCached(url, std::chrono::minutes(5));
     auto j = nlohmann::json::parse(response);
     
     if (j.contains("clientVersionUpload")) {
@@ -36,11 +49,13 @@ std::string RobloxAPI::getLatestVersionGUID(const std::string& channel) {
 }
 
 std::vector<RobloxPackage> RobloxAPI::getPackageManifest(const std::string& versionGUID) {
-    std::string url = BASE_URL + versionGUID + "-rbxPkgManifest.txt";
-    std::string response = HTTP::get(url);
-    
+    std::string url = baseUrl() + versionGUID + "-rbxPkgManifest.txt";
+    return parsePackageManifest(HTTP::get(url));
+}
+
+std::vector<RobloxPackage> RobloxAPI::parsePackageManifest(const std::string& text) {
     std::vector<RobloxPackage> packages;
-    std::stringstream ss(response);
+    std::stringstream ss(text);
     std::string line;
     
     if (!std::getline(ss, line)) return packages;
@@ -70,4 +85,14 @@ std::vector<RobloxPackage> RobloxAPI::getPackageManifest(const std::string& vers
     return packages;
 }
 
+std::string RobloxAPI::formatPackageManifest(const std::vector<RobloxPackage>& packages) {
+    std::ostringstream ss;
+    ss << "v0\n";
+    for (const auto& pkg : packages) {
+        ss << pkg.name << "\n" << pkg.checksum << "\n"
+           << pkg.size << "\n" << pkg.packedSize << "\n";
+    }
+    return ss.str();
+}
+
 } // namespace rsjfw
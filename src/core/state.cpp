@@ -10,6 +10,13 @@ State& State::instance() {
 }
 
 void State::set(AppState state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Going idle while Studio runs means back to IN_STUDIO
+    if (state == AppState::IDLE &&
+        std::any_of(instances_.begin(), instances_.end(),
+                    [](const StudioInstance& i) { return i.running; })) {
+        state = AppState::IN_STUDIO;
+    }
     state_.store(state);
 }
 
@@ -51,20 +58,55 @@ float State::getProgress() const {
     return progress_.load();
 }
 
-void State::addStudioInstance(int pid) {
+void State::addStudioInstance(int pid, long startTime) {
     std::lock_guard<std::mutex> lock(mutex_);
-    // Check if already exists
+    // Check if already exists (a reused PID replaces an exited entry)
     for (const auto& inst : instances_) {
-        if (inst.pid == pid) return;
+        if (inst.pid == pid && inst.running) return;
     }
+    instances_.erase(std::remove_if(instances_.begin(), instances_.end(),
+                                    [pid](const StudioInstance& i) { return i.pid == pid; }),
+                     instances_.end());
     
     StudioInstance inst;
     inst.pid = pid;
-    inst.startTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    inst.startTime = startTime > 0 ? startTime : std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     inst.windowTitle = "Detecting..."; // Will be updated by polling loop potentially
     instances_.push_back(inst);
-    
-    state_.store(AppState::IN_STUDIO);
+
+    // Reported from the supervisor thread at any time; a download or setup
+    // in progress keeps its state and set(IDLE) picks Studio up afterwards
+    AppState idle = AppState::IDLE;
+    state_.compare_exchange_strong(idle, AppState::IN_STUDIO);
+}
+
+void State::markStudioExited(int pid, int exitCode) {
+    static constexpr size_t kKeepExited = 16;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& inst : instances_) {
+        if (inst.pid == pid && inst.running) {
+            inst.running = false;
+            inst.exitCode = exitCode;
+        }
+    }
+
+    // Drop the oldest exited entries beyond the history we keep
+    size_t exited = std::count_if(instances_.begin(), instances_.end(),
+                                  [](const StudioInstance& i) { return !i.running; });
+    for (auto it = instances_.begin(); it != instances_.end() && exited > kKeepExited;) {
+        if (!it->running) {
+            it = instances_.erase(it);
+            --exited;
+        } else {
+            ++it;
+        }
+    }
+
+    bool anyRunning = std::any_of(instances_.begin(), instances_.end(),
+                                  [](const StudioInstance& i) { return i.running; });
+    if (!anyRunning && state_.load() == AppState::IN_STUDIO) {
+        state_.store(AppState::IDLE);
+    }
 }
 
 void State::removeStudioInstance(int pid) {
@@ -72,7 +114,9 @@ void State::removeStudioInstance(int pid) {
     auto it = std::remove_if(instances_.begin(), instances_.end(), [pid](const StudioInstance& i){ return i.pid == pid; });
     instances_.erase(it, instances_.end());
     
-    if (instances_.empty() && state_.load() == AppState::IN_STUDIO) {
+    bool anyRunning = std::any_of(instances_.begin(), instances_.end(),
+                                  [](const StudioInstance& i) { return i.running; });
+    if (!anyRunning && state_.load() == AppState::IN_STUDIO) {
         state_.store(AppState::IDLE);
     }
 }
@@ -84,7 +128,8 @@ std::vector<StudioInstance> State::getInstances() const {
 
 bool State::isStudioRunning() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    return !instances_.empty();
+    return std::any_of(instances_.begin(), instances_.end(),
+                       [](const StudioInstance& i) { return i.running; });
 }
 
 void State::setDebugVar(const std::string& key, const std::string& value) {
@@ -0,0 +1,339 @@
+#include "rsjfw/trace.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/path_manager.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace rsjfw {
+
+namespace {
+
+constexpr size_t RING_SIZE = 4096;
+constexpr size_t DETAIL_LEN = 96;
+
+// One slot of a thread's ring. `seq` is odd while the owner writes it, so a
+// concurrent dump can tell a torn slot from a finished one and skip it.
+struct Event {
+  std::atomic<uint64_t> seq{0};
+  const char *name = nullptr;
+  char detail[DETAIL_LEN] = {};
+  uint64_t startUs = 0;
+  uint64_t durUs = 0;
+};
+
+struct ThreadRing {
+  pid_t tid = 0;
+  std::string threadName;
+  std::atomic<uint64_t> head{0};
+  std::array<Event, RING_SIZE> events;
+};
+
+struct Snapshot {
+  const char *name;
+  std::string detail;
+  uint64_t startUs;
+  uint64_t durUs;
+};
+
+// What is left of a finished thread's ring: only the recorded spans, so a
+// short-lived worker doesn't keep its whole ring alive
+struct Retired {
+  pid_t tid;
+  std::string threadName;
+  std::vector<Snapshot> spans;
+};
+constexpr size_t MAX_RETIRED_SPANS = 64 * 1024;
+
+// Never freed, so spans recorded while the process exits stay safe
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<ThreadRing>> &rings =
+    *new std::vector<std::unique_ptr<ThreadRing>>;
+std::deque<Retired> &retired = *new std::deque<Retired>;
+size_t retiredSpans = 0;
+// Spans that ended on another thread (Trace::Interval), by starting thread
+std::vector<std::pair<pid_t, Snapshot>> &crossThread =
+    *new std::vector<std::pair<pid_t, Snapshot>>;
+
+std::vector<Snapshot> snapshot(const ThreadRing &ring);
+
+// Set once the thread's RingOwner is gone; late spans are dropped
+ThreadRing *const EXITED = reinterpret_cast<ThreadRing *>(1);
+thread_local ThreadRing *currentRing = nullptr;
+
+void retire(ThreadRing *ring) {
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  auto it = std::find_if(rings.begin(), rings.end(),
+                         [&](const auto &r) { return r.get() == ring; });
+  if (it == rings.end())
+    return;
+  Retired r{ring->tid, ring->threadName, snapshot(*ring)};
+  rings.erase(it);
+  if (r.spans.empty())
+    return;
+  retiredSpans += r.spans.size();
+  retired.push_back(std::move(r));
+  while (retiredSpans > MAX_RETIRED_SPANS && retired.size() > 1) {
+    retiredSpans -= retired.front().spans.size();
+    retired.pop_front();
+  }
+}
+
+struct RingOwner {
+  ~RingOwner() {
+    if (currentRing && currentRing != EXITED)
+      retire(currentRing);
+    currentRing = EXITED;
+  }
+};
+
+ThreadRing *localRing() {
+  if (currentRing)
+    return currentRing == EXITED ? nullptr : currentRing;
+  thread_local RingOwner owner;
+  auto owned = std::make_unique<ThreadRing>();
+  owned->tid = static_cast<pid_t>(syscall(SYS_gettid));
+  char name[16] = {};
+  pthread_getname_np(pthread_self(), name, sizeof(name));
+  owned->threadName = name;
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  rings.push_back(std::move(owned));
+  currentRing = rings.back().get();
+  return currentRing;
+}
+
+// Every recorded span with its thread, called with ringsMutex held
+template <typename Fn> void forEachSpan(Fn &&fn) {
+  for (const auto &ring : rings)
+    for (const auto &s : snapshot(*ring))
+      fn(ring->tid, ring->threadName, s);
+  for (const auto &r : retired)
+    for (const auto &s : r.spans)
+      fn(r.tid, r.threadName, s);
+  for (const auto &[tid, s] : crossThread)
+    fn(tid, std::string(), s);
+}
+
+std::vector<Snapshot> snapshot(const ThreadRing &ring) {
+  std::vector<Snapshot> out;
+  uint64_t head = ring.head.load(std::memory_order_acquire);
+  uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+  for (uint64_t i = first; i < head; ++i) {
+    const Event &ev = ring.events[i % RING_SIZE];
+    uint64_t seq = ev.seq.load(std::memory_order_acquire);
+    if (seq != 2 * i + 2)
+      continue;
+    Snapshot s{ev.name, std::string(ev.detail, strnlen(ev.detail, DETAIL_LEN)),
+               ev.startUs, ev.durUs};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (ev.seq.load(std::memory_order_relaxed) == seq)
+      out.push_back(std::move(s));
+  }
+  return out;
+}
+
+std::string seconds(uint64_t us) {
+  std::ostringstream ss;
+  ss.precision(3);
+  ss << std::fixed << us / 1e6 << "s";
+  return ss.str();
+}
+
+} // namespace
+
+std::atomic<bool> Trace::enabled_{false};
+
+Trace::Span::Span(const char *name, const std::string &detail) : name_(name) {
+  if (!enabled())
+    return;
+  detail_ = detail;
+  startUs_ = nowUs();
+}
+
+Trace::Span::~Span() {
+  if (startUs_)
+    record(name_, detail_, startUs_, nowUs());
+}
+
+Trace::Interval::Interval(const char *name, const std::string &detail)
+    : name_(name) {
+  if (!enabled())
+    return;
+  detail_ = detail;
+  tid_ = static_cast<int>(syscall(SYS_gettid));
+  startUs_ = nowUs();
+}
+
+Trace::Interval::~Interval() { end(); }
+
+void Trace::Interval::end() {
+  if (!startUs_ || ended_.exchange(true))
+    return;
+  Snapshot s{name_, detail_.substr(0, DETAIL_LEN - 1), startUs_,
+             nowUs() - startUs_};
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  if (crossThread.size() < RING_SIZE)
+    crossThread.emplace_back(tid_, std::move(s));
+}
+
+void Trace::enable(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+
+uint64_t Trace::nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Trace::record(const char *name, const std::string &detail,
+                   uint64_t startUs, uint64_t endUs) {
+  ThreadRing *owned = localRing();
+  if (!owned)
+    return;
+  ThreadRing &ring = *owned;
+  uint64_t i = ring.head.load(std::memory_order_relaxed);
+  Event &ev = ring.events[i % RING_SIZE];
+
+  ev.seq.store(2 * i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  ev.name = name;
+  size_t n = std::min(detail.size(), DETAIL_LEN - 1);
+  std::memcpy(ev.detail, detail.data(), n);
+  ev.detail[n] = '\0';
+  ev.startUs = startUs;
+  ev.durUs = endUs - startUs;
+  ev.seq.store(2 * i + 2, std::memory_order_release);
+  ring.head.store(i + 1, std::memory_order_release);
+}
+
+std::filesystem::path Trace::dump() {
+  if (!enabled())
+    return {};
+
+  nlohmann::json events = nlohmann::json::array();
+  const int pid = getpid();
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    std::map<pid_t, std::string> threads;
+    forEachSpan([&](pid_t tid, const std::string &threadName,
+                    const Snapshot &s) {
+      if (!threadName.empty() || !threads.count(tid))
+        threads[tid] = threadName;
+      nlohmann::json ev = {{"ph", "X"},      {"name", s.name},
+                           {"cat", "rsjfw"}, {"pid", pid},
+                           {"tid", tid},     {"ts", s.startUs},
+                           {"dur", s.durUs}};
+      if (!s.detail.empty())
+        ev["args"] = {{"detail", s.detail}};
+      events.push_back(std::move(ev));
+    });
+    for (const auto &[tid, threadName] : threads)
+      events.push_back({{"ph", "M"},
+                        {"name", "thread_name"},
+                        {"pid", pid},
+                        {"tid", tid},
+                        {"args", {{"name", threadName}}}});
+  }
+  if (events.empty())
+    return {};
+
+  std::time_t t = std::time(nullptr);
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&t));
+  std::filesystem::path path =
+      PathManager::instance().logs() / ("trace-" + std::string(stamp) + ".json");
+
+  std::ofstream ofs(path, std::ios::trunc);
+  ofs << nlohmann::json{{"traceEvents", events},
+                        {"displayTimeUnit", "ms"}}
+             .dump();
+  if (!ofs) {
+    LOG_WARN("Could not write trace to " + path.string());
+    return {};
+  }
+  LOG_INFO("Trace written to " + path.string());
+  return path;
+}
+
+void Trace::logSummary(size_t top) {
+  if (!enabled())
+    return;
+
+  struct Total {
+    uint64_t us = 0, maxUs = 0;
+    size_t count = 0;
+  };
+  std::map<std::string, Total> totals;
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    forEachSpan([&](pid_t, const std::string &, const Snapshot &s) {
+      auto &t = totals[s.name];
+      t.us += s.durUs;
+      t.maxUs = std::max(t.maxUs, s.durUs);
+      ++t.count;
+    });
+  }
+
+  std::vector<std::pair<std::string, Total>> sorted(totals.begin(),
+                                                    totals.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+    return a.second.us > b.second.us;
+  });
+  if (sorted.size() > top)
+    sorted.resize(top);
+
+  LOG_INFO("Slowest phases (total over all threads):");
+  for (const auto &[name, t] : sorted)
+    LOG_INFO("  " + name + ": " + seconds(t.us) + " in " +
+             std::to_string(t.count) + " span(s), longest " +
+             seconds(t.maxUs));
+}
+
+void Trace::dumpOnSignal(int sig) {
+  // The handler only pokes a pipe; the dump itself runs on a thread of its
+  // own that lives as long as the process
+  static int fds[2] = {-1, -1};
+  if (fds[0] >= 0 || pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+    return;
+  int readFd = fds[0];
+  fcntl(readFd, F_SETFL, fcntl(readFd, F_GETFL) & ~O_NONBLOCK);
+
+  struct sigaction sa{};
+  sa.sa_handler = [](int) {
+    int saved = errno;
+    char c = 1;
+    ssize_t n = write(fds[1], &c, 1);
+    (void)n;
+    errno = saved;
+  };
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(sig, &sa, nullptr);
+
+  std::thread([readFd] {
+    pthread_setname_np(pthread_self(), "rsjfw-trace");
+    char buf[16];
+    while (read(readFd, buf, sizeof(buf)) > 0) {
+      if (enabled())
+        dump();
+    }
+  }).detach();
+}
+
+} // namespace rsjfw
@@ -0,0 +1,61 @@
+#include "rsjfw/version_index.hpp"
+#include <fstream>
+#include <sstream>
+
+namespace rsjfw {
+
+std::filesystem::path
+VersionIndex::fileFor(const std::filesystem::path &versionDir) {
+  return versionDir / ".rsjfw_index";
+}
+
+// One tab-separated line per file: package, md5, size, path
+bool VersionIndex::load(const std::filesystem::path &versionDir) {
+  entries_.clear();
+  std::ifstream ifs(fileFor(versionDir));
+  if (!ifs)
+    return false;
+
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty())
+      continue;
+    std::istringstream ss(line);
+    Entry e;
+    std::string size;
+    if (!std::getline(ss, e.package, '\t') || !std::getline(ss, e.md5, '\t') ||
+        !std::getline(ss, size, '\t') || !std::getline(ss, e.path))
+      continue;
+    try {
+      e.size = std::stoull(size);
+    } catch (...) {
+      continue;
+    }
+    entries_.push_back(std::move(e));
+  }
+  return true;
+}
+
+bool VersionIndex::save(const std::filesystem::path &versionDir) const {
+  std::filesystem::path target = fileFor(versionDir);
+  std::filesystem::path tmp = target;
+  tmp += ".tmp";
+
+  {
+    std::ofstream ofs(tmp, std::ios::trunc);
+    if (!ofs)
+      return false;
+    for (const auto &e : entries_) {
+      ofs << e.package << '\t' << e.md5 << '\t' << e.size << '\t' << e.path
+          << '\n';
+    }
+    if (!ofs)
+      return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, target, ec);
+  return !ec;
+}
+
+} // namespace rsjfw
@@ -1,6 +1,9 @@
 #include "rsjfw/wine.hpp"
 #include "rsjfw/logger.hpp"
+#include "rsjfw/registry.hpp"
+#include "rsjfw/trace.hpp"
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <fstream>
@@ -120,6 +123,14 @@ bool Prefix::runCommand(const std::string &exe,
                         const std::vector<std::string> &args,
                         std::function<void(const std::string &)> onOutput,
                         const std::string &cwd, bool wait) {
+  // Detached commands only count until the fork
+  std::string traceDetail;
+  if (Trace::enabled()) {
+    traceDetail = std::filesystem::path(exe).filename().string();
+    for (size_t i = 0; i < args.size() && i < 3; ++i)
+      traceDetail += " " + args[i];
+  }
+  RSJFW_TRACE("wine::Prefix::runCommand", traceDetail);
   std::vector<std::string> finalArgs;
   finalArgs.push_back(exe);
   finalArgs.insert(finalArgs.end(), args.begin(), args.end());
@@ -175,6 +186,9 @@ bool Prefix::runCommand(const std::string &exe,
     _exit(127);
   }
 
+  if (onSpawn_)
+    onSpawn_(pid);
+
   if (wait) {
     if (onOutput) {
       close(pipefd[1]);
@@ -243,6 +257,11 @@ bool Prefix::wine(const std::string &target,
 
 bool Prefix::registryAdd(const std::string &key, const std::string &valueName,
                          const std::string &value, const std::string &type) {
+  if (withServerStopped([&] {
+        return RegistryHive::apply(dir_, {{key, valueName, value, type}});
+      }))
+    return true;
+
   std::vector<std::string> args = {"reg", "add", key, "/f"};
   if (!valueName.empty()) {
     args.push_back("/v");
@@ -266,10 +285,71 @@ bool Prefix::registryAdd(const std::string &key, const std::string &valueName,
 
 bool Prefix::kill() { return wine("wineserver", {"-k"}); }
 
+std::string Prefix::serverDir() const {
+  struct stat st{};
+  if (::stat(dir_.c_str(), &st) != 0)
+    return "";
+  char path[128];
+  snprintf(path, sizeof(path), "/tmp/.wine-%u/server-%llx-%llx",
+           static_cast<unsigned>(getuid()),
+           static_cast<unsigned long long>(st.st_dev),
+           static_cast<unsigned long long>(st.st_ino));
+  return path;
+}
+
+bool Prefix::serverRunning() const {
+  // Wine keeps a lock held for the server's lifetime in <serverDir>/lock
+  std::string dir = serverDir();
+  if (dir.empty())
+    return false;
+  int fd = ::open((dir + "/lock").c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct flock fl{};
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  bool locked = fcntl(fd, F_GETLK, &fl) == 0 && fl.l_type != F_UNLCK;
+  close(fd);
+  return locked;
+}
+
+bool Prefix::withServerStopped(const std::function<bool()> &fn) const {
+  std::string dir = serverDir();
+  if (dir.empty())
+    return false;
+  // Same layout and modes wineserver creates, which it checks
+  std::string parent = dir.substr(0, dir.rfind('/'));
+  if ((mkdir(parent.c_str(), 0700) != 0 && errno != EEXIST) ||
+      (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST))
+    return false;
+  int fd = ::open((dir + "/lock").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+                  0600);
+  if (fd < 0)
+    return false;
+  // An open file description lock: it conflicts with the server's, and
+  // another thread closing the file (serverRunning()) doesn't drop it
+  struct flock fl{};
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  if (fcntl(fd, F_OFD_SETLK, &fl) != 0) {
+    close(fd);
+    return false;
+  }
+  bool ok = fn();
+  close(fd);
+  return ok;
+}
+
 bool Prefix::registryApply(const std::vector<RegistryEntry> &entries) {
   if (entries.empty())
     return true;
 
+  // With the server down the hives on disk are authoritative, so the batch
+  // is written straight into them instead of booting Wine for regedit. A
+  // fresh prefix has no hives yet and still goes through regedit.
+  if (withServerStopped([&] { return RegistryHive::apply(dir_, entries); }))
+    return true;
+
   std::stringstream ss;
   ss << "Windows Registry Editor Version 5.00\r\n\r\n";
 
@@ -0,0 +1,110 @@
+#include "rsjfw/wine_server_pool.hpp"
+#include "rsjfw/config.hpp"
+#include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/trace.hpp"
+#include "rsjfw/wine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace rsjfw {
+
+// Fingerprint of the running persistent server, kept in the prefix
+static std::filesystem::path recordPath(const wine::Prefix &pfx) {
+  return std::filesystem::path(pfx.dir()) / ".rsjfw_server";
+}
+
+static bool waitForExit(const wine::Prefix &pfx) {
+  for (int i = 0; i < 50 && pfx.serverRunning(); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return !pfx.serverRunning();
+}
+
+bool WineServerPool::enabled() {
+  return Config::instance().getWine().persistentServer;
+}
+
+std::string WineServerPool::fingerprint(const wine::Prefix &pfx) {
+  // Only what the config decides; PATH, DBUS_SESSION_BUS_ADDRESS and the
+  // like follow whichever shell or browser started this launch
+  auto &genCfg = Config::instance().getGeneral();
+  auto &wineCfg = Config::instance().getWine();
+  std::string id = "v2\n" + pfx.root() + "\n" + pfx.dir() + "\n";
+  for (const auto &[key, val] : genCfg.customEnv)
+    if (!key.empty())
+      id += key + "=" + val + "\n";
+  id += "dxvk=" + std::to_string(genCfg.dxvk) + "\n";
+  id += "gpu=" + std::to_string(genCfg.selectedGpu) + "\n";
+  id += "WINEDEBUG=" + pfx.getEnv("WINEDEBUG") + "\n";
+  if (wineCfg.desktopMode && !wineCfg.multipleDesktops)
+    id += "desktop=" + wineCfg.desktopResolution + "\n";
+
+  Md5 md5;
+  md5.update(id.data(), id.size());
+  return md5.hexdigest();
+}
+
+bool WineServerPool::ensure(wine::Prefix &pfx, bool keepRunning) {
+  if (!enabled())
+    return false;
+
+  std::string fp = fingerprint(pfx);
+  if (pfx.serverRunning()) {
+    std::string recorded;
+    std::ifstream(recordPath(pfx)) >> recorded;
+    if (recorded == fp) {
+      LOG_DEBUG("Reusing warm wineserver for " + pfx.dir());
+      return true;
+    }
+    if (keepRunning) {
+      LOG_INFO("Prefix configuration changed, keeping the running wineserver "
+               "until the next launch.");
+      return true;
+    }
+    LOG_INFO("Prefix configuration changed, restarting wineserver...");
+    release(pfx);
+  }
+
+  RSJFW_TRACE("WineServerPool::start");
+  LOG_INFO("Starting persistent wineserver for " + pfx.dir());
+  // Forks into the background once its socket is ready
+  if (!pfx.runCommand(pfx.bin("wineserver"), {"-p"}) || !pfx.serverRunning()) {
+    LOG_WARN("Failed to start a persistent wineserver.");
+    return false;
+  }
+
+  {
+    RSJFW_TRACE("WineServerPool::wineboot");
+    pfx.wine("wineboot", {}, [](const std::string &) {});
+  }
+
+  auto &wineCfg = Config::instance().getWine();
+  if (wineCfg.desktopMode && !wineCfg.multipleDesktops) {
+    // Launches open in this desktop, as runWine uses the same name
+    std::string resolution = wineCfg.desktopResolution;
+    resolution.erase(std::remove(resolution.begin(), resolution.end(), ' '),
+                     resolution.end());
+    if (resolution.empty())
+      resolution = "1920x1080";
+    pfx.wine("explorer", {"/desktop=RSJFW_Desktop," + resolution},
+             [](const std::string &) {}, "", false);
+  }
+
+  std::ofstream(recordPath(pfx)) << fp << "\n";
+  return true;
+}
+
+void WineServerPool::release(wine::Prefix &pfx) {
+  std::error_code ec;
+  std::filesystem::remove(recordPath(pfx), ec);
+  if (!pfx.serverRunning())
+    return;
+  pfx.runCommand(pfx.bin("wineserver"), {"-k"});
+  if (!waitForExit(pfx))
+    LOG_WARN("wineserver for " + pfx.dir() + " did not exit.");
+}
+
+} // namespace rsjfw
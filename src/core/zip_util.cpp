@@ -1,15 +1,34 @@
 #include "rsjfw/zip_util.hpp"
 #include "rsjfw/logger.hpp"
+#include "rsjfw/md5.hpp"
+#include "rsjfw/trace.hpp"
 #include <archive.h>
 #include <archive_entry.h>
 #include <filesystem>
 #include <iostream>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace rsjfw {
 
-static int copy_data(struct archive* ar, struct archive* aw) {
+struct FileDigest {
+    Md5 md5;
+    uint64_t next = 0;
+    bool inOrder = true;
+};
+
+static int copy_data(struct archive* ar, struct archive* aw, FileDigest* digest = nullptr) {
     int r;
     const void* buff;
     size_t size;
@@ -19,6 +38,12 @@ static int copy_data(struct archive* ar, struct archive* aw) {
         r = archive_read_data_block(ar, &buff, &size, &offset);
         if (r == ARCHIVE_EOF) return ARCHIVE_OK;
         if (r < ARCHIVE_OK) return r;
+        if (digest) {
+            // Sparse or out-of-order blocks can't be hashed incrementally
+            if (static_cast<uint64_t>(offset) != digest->next) digest->inOrder = false;
+            if (digest->inOrder) digest->md5.update(buff, size);
+            digest->next = offset + size;
+        }
         r = archive_write_data_block(aw, buff, size, offset);
         if (r < ARCHIVE_OK) {
             std::cerr << "[RSJFW] Archive write error: " << archive_error_string(aw) << std::endl;
@@ -27,8 +52,97 @@ static int copy_data(struct archive* ar, struct archive* aw) {
     }
 }
 
-bool ZipUtil::extract(const std::string& archivePath, const std::string& destPath) {
-    struct archive* a;
+// Bounded chunk queue between the network thread and libarchive
+class BytePipe {
+public:
+    explicit BytePipe(size_t capacity) : capacity_(capacity) {}
+
+    SinkResult tryPush(const char* data, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (aborted_) return SinkResult::Abort;
+        if (buffered_ >= capacity_) return SinkResult::Full;
+        chunks_.emplace_back(data, data + len);
+        buffered_ += len;
+        cv_.notify_all();
+        return SinkResult::Ok;
+    }
+
+    // Blocks until a chunk is available. Returns false at end of stream.
+    bool pop(std::vector<char>& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] { return aborted_ || closed_ || !chunks_.empty(); });
+        if (aborted_ || chunks_.empty()) return false;
+        out = std::move(chunks_.front());
+        chunks_.pop_front();
+        buffered_ -= out.size();
+        cv_.notify_all();
+        return true;
+    }
+
+    void close(bool ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        producerOk_ = ok;
+        cv_.notify_all();
+    }
+
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aborted_ = true;
+        cv_.notify_all();
+    }
+
+    bool producerOk() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_ && producerOk_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<char>> chunks_;
+    size_t buffered_ = 0;
+    size_t capacity_;
+    bool closed_ = false;
+    bool aborted_ = false;
+    bool producerOk_ = false;
+};
+
+struct StreamReadContext {
+    BytePipe* pipe;
+    std::vector<char> current;
+};
+
+static la_ssize_t streamRead(struct archive* a, void* clientData, const void** buff) {
+    auto* ctx = static_cast<StreamReadContext*>(clientData);
+    if (!ctx->pipe->pop(ctx->current)) {
+        if (ctx->pipe->producerOk()) return 0; // Clean EOF
+        archive_set_error(a, EIO, "Archive stream interrupted");
+        return ARCHIVE_FATAL;
+    }
+    *buff = ctx->current.data();
+    return static_cast<la_ssize_t>(ctx->current.size());
+}
+
+static bool sanitizeEntryPath(const char* currentFile, std::string& relPath) {
+    relPath = currentFile;
+
+    // Sanitize: Remove leading slashes/backslashes
+    while (!relPath.empty() && (relPath[0] == '/' || relPath[0] == '\\')) {
+        relPath = relPath.substr(1);
+    }
+
+    // Sanitize: Prevent directory traversal (..)
+    // This is a basic check.
+    if (relPath.find("..") != std::string::npos) {
+         LOG_WARN("Skipping potentially unsafe entry: " + std::string(currentFile));
+         return false;
+    }
+    return true;
+}
+
+static bool extractEntries(struct archive* a, const std::string& destPath,
+                           const ZipUtil::FileCallback& onFile) {
     struct archive* ext;
     struct archive_entry* entry;
     int flags;
@@ -39,21 +153,10 @@ bool ZipUtil::extract(const std::string& archivePath, const std::string& destPat
     flags |= ARCHIVE_EXTRACT_ACL;
     flags |= ARCHIVE_EXTRACT_FFLAGS;
 
-    a = archive_read_new();
-    archive_read_support_format_all(a);
-    archive_read_support_filter_all(a);
-    
     ext = archive_write_disk_new();
     archive_write_disk_set_options(ext, flags);
     archive_write_disk_set_standard_lookup(ext);
 
-    if ((r = archive_read_open_filename(a, archivePath.c_str(), 10240))) {
-        LOG_ERROR("Could not open archive " + archivePath + ": " + std::string(archive_error_string(a)));
-        archive_read_free(a);
-        archive_write_free(ext);
-        return false;
-    }
-
     std::filesystem::path dest(destPath);
     std::filesystem::create_directories(dest);
 
@@ -64,39 +167,29 @@ bool ZipUtil::extract(const std::string& archivePath, const std::string& destPat
              LOG_WARN("Archive header warning: " + std::string(archive_error_string(a)));
         }
         if (r < ARCHIVE_WARN) {
-            archive_read_free(a);
             archive_write_free(ext);
             return false;
         }
 
-        const char* currentFile = archive_entry_pathname(entry);
-        std::string relPath = currentFile;
-        
-        // Sanitize: Remove leading slashes/backslashes
-        while (!relPath.empty() && (relPath[0] == '/' || relPath[0] == '\\')) {
-            relPath = relPath.substr(1);
-        }
-        
-        // Sanitize: Prevent directory traversal (..)
-        // This is a basic check.
-        if (relPath.find("..") != std::string::npos) {
-             LOG_WARN("Skipping potentially unsafe entry: " + std::string(currentFile));
-             continue;
-        }
+        std::string relPath;
+        if (!sanitizeEntryPath(archive_entry_pathname(entry), relPath)) continue;
 
         std::filesystem::path fullPath = dest / relPath;
         archive_entry_set_pathname(entry, fullPath.string().c_str());
 
+        bool isFile = archive_entry_filetype(entry) == AE_IFREG;
+        FileDigest digest;
+
         r = archive_write_header(ext, entry);
         if (r < ARCHIVE_OK) {
              LOG_WARN("Archive write header warning: " + std::string(archive_error_string(ext)));
-        } else if (archive_entry_size(entry) > 0) {
-            r = copy_data(a, ext);
+             isFile = false;
+        } else if (!archive_entry_size_is_set(entry) || archive_entry_size(entry) > 0) {
+            r = copy_data(a, ext, onFile && isFile ? &digest : nullptr);
             if (r < ARCHIVE_OK) {
                 LOG_ERROR("Archive data copy error: " + std::string(archive_error_string(ext)));
             }
             if (r < ARCHIVE_WARN) {
-                archive_read_free(a);
                 archive_write_free(ext);
                 return false;
             }
@@ -104,15 +197,293 @@ bool ZipUtil::extract(const std::string& archivePath, const std::string& destPat
         r = archive_write_finish_entry(ext);
         if (r < ARCHIVE_OK) {
              LOG_WARN("Archive finish entry warning: " + std::string(archive_error_string(ext)));
+        } else if (onFile && isFile) {
+            ZipUtil::ExtractedFile file;
+            file.path = fullPath.string();
+            file.size = digest.next;
+            if (digest.inOrder) file.md5 = digest.md5.hexdigest();
+            onFile(file);
         }
     }
 
-    archive_read_close(a);
-    archive_read_free(a);
     archive_write_close(ext);
     archive_write_free(ext);
+    return true;
+}
+
+// Zips smaller than this aren't worth the extra readers
+static constexpr uint64_t kParallelMinSize = 8 * 1024 * 1024;
+
+enum class ParallelResult { Done, Failed, Unsupported };
+
+struct ZipEntry {
+    std::string relPath;
+    bool isDir = false;
+    uint64_t size = 0;
+    mode_t perm = 0;
+    time_t mtime = 0;
+};
 
+static bool isZipFile(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[4] = {};
+    return ifs.read(magic, sizeof(magic)) && std::memcmp(magic, "PK\x03\x04", 4) == 0;
+}
+
+static struct archive* openSeekableZip(const std::string& path) {
+    struct archive* a = archive_read_new();
+    archive_read_support_format_zip_seekable(a);
+    if (archive_read_open_filename(a, path.c_str(), 65536) != ARCHIVE_OK) {
+        archive_read_free(a);
+        return nullptr;
+    }
+    return a;
+}
+
+static bool pwriteAll(int fd, const void* buff, size_t size, off_t offset) {
+    const char* p = static_cast<const char*>(buff);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
     return true;
 }
 
+// Inflates the current entry of `a` into a fresh file at `path`
+static bool writeZipEntry(struct archive* a, const ZipEntry& ze, const std::filesystem::path& path,
+                          FileDigest* digest) {
+    // Never write through an existing file, it may be a link into another version
+    unlink(path.c_str());
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Could not create " + path.string() + ": " + std::strerror(errno));
+        return false;
+    }
+
+    bool ok = true;
+    for (;;) {
+        const void* buff;
+        size_t size;
+        la_int64_t offset;
+        int r = archive_read_data_block(a, &buff, &size, &offset);
+        if (r == ARCHIVE_EOF) break;
+        if (r < ARCHIVE_WARN) {
+            LOG_ERROR("Archive data read error: " + std::string(archive_error_string(a)));
+            ok = false;
+            break;
+        }
+        if (digest) {
+            if (static_cast<uint64_t>(offset) != digest->next) digest->inOrder = false;
+            if (digest->inOrder) digest->md5.update(buff, size);
+            digest->next = offset + size;
+        }
+        if (!pwriteAll(fd, buff, size, offset)) {
+            LOG_ERROR("Write error on " + path.string() + ": " + std::strerror(errno));
+            ok = false;
+            break;
+        }
+    }
+
+    if (ok) {
+        // Sparse tails never produce a block, size the file explicitly
+        if (ftruncate(fd, ze.size) != 0) ok = false;
+        fchmod(fd, ze.perm ? ze.perm : 0644);
+        struct timespec times[2] = {{ze.mtime, 0}, {ze.mtime, 0}};
+        futimens(fd, times);
+    }
+    close(fd);
+    if (digest) digest->next = ze.size;
+    return ok;
+}
+
+static ParallelResult extractZipParallel(const std::string& archivePath, const std::string& destPath,
+                                         const ZipUtil::FileCallback& onFile) {
+    // Read the central directory once to learn the layout
+    struct archive* a = openSeekableZip(archivePath);
+    if (!a) return ParallelResult::Unsupported;
+
+    std::vector<ZipEntry> entries;
+    struct archive_entry* entry;
+    int r;
+    while ((r = archive_read_next_header(a, &entry)) == ARCHIVE_OK) {
+        ZipEntry ze;
+        mode_t type = archive_entry_filetype(entry);
+        // Links and specials keep going through archive_write_disk
+        if (type != AE_IFREG && type != AE_IFDIR) {
+            r = ARCHIVE_FATAL;
+            break;
+        }
+        if (!sanitizeEntryPath(archive_entry_pathname(entry), ze.relPath)) ze.relPath.clear();
+        ze.isDir = type == AE_IFDIR;
+        ze.size = archive_entry_size(entry);
+        ze.perm = archive_entry_perm(entry);
+        ze.mtime = archive_entry_mtime(entry);
+        entries.push_back(std::move(ze));
+    }
+    archive_read_close(a);
+    archive_read_free(a);
+    if (r != ARCHIVE_EOF) return ParallelResult::Unsupported;
+
+    std::filesystem::path dest(destPath);
+    std::error_code ec;
+    std::filesystem::create_directories(dest, ec);
+
+    // Lay out the directory tree up front so workers only ever create files
+    std::vector<size_t> files;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const auto& ze = entries[i];
+        if (ze.relPath.empty()) continue;
+        std::filesystem::path full = dest / ze.relPath;
+        std::filesystem::create_directories(ze.isDir ? full : full.parent_path(), ec);
+        if (!ze.isDir) files.push_back(i);
+    }
+
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    size_t numWorkers = std::min<size_t>({hw, 8, files.size()});
+    if (numWorkers == 0) return ParallelResult::Done;
+
+    // Largest entries first onto the least loaded worker
+    std::sort(files.begin(), files.end(),
+              [&](size_t x, size_t y) { return entries[x].size > entries[y].size; });
+    std::vector<int> owner(entries.size(), -1);
+    std::vector<uint64_t> load(numWorkers, 0);
+    for (size_t i : files) {
+        size_t w = std::min_element(load.begin(), load.end()) - load.begin();
+        owner[i] = static_cast<int>(w);
+        load[w] += entries[i].size + 1;
+    }
+
+    // Reported only once every entry is in, so a failed pass that is retried
+    // sequentially doesn't report files twice
+    std::atomic<bool> failed{false};
+    std::mutex doneMutex;
+    std::vector<ZipUtil::ExtractedFile> done;
+    std::vector<std::jthread> workers;
+    for (size_t w = 0; w < numWorkers; ++w) {
+        workers.emplace_back([&, w]() {
+            struct archive* wa = openSeekableZip(archivePath);
+            if (!wa) {
+                failed = true;
+                return;
+            }
+
+            size_t last = 0;
+            for (size_t i = 0; i < owner.size(); ++i)
+                if (owner[i] == static_cast<int>(w)) last = i;
+
+            // Headers come from the central directory, so skipping entries
+            // that belong to other workers costs a seek, not an inflate
+            struct archive_entry* we;
+            for (size_t i = 0; i <= last && !failed; ++i) {
+                if (archive_read_next_header(wa, &we) != ARCHIVE_OK) {
+                    LOG_ERROR("Archive header error: " + std::string(archive_error_string(wa)));
+                    failed = true;
+                    break;
+                }
+                if (owner[i] != static_cast<int>(w)) continue;
+
+                const auto& ze = entries[i];
+                std::filesystem::path full = dest / ze.relPath;
+                FileDigest digest;
+                if (!writeZipEntry(wa, ze, full, onFile ? &digest : nullptr)) {
+                    failed = true;
+                    break;
+                }
+                if (onFile) {
+                    ZipUtil::ExtractedFile file;
+                    file.path = full.string();
+                    file.size = ze.size;
+                    if (digest.inOrder) file.md5 = digest.md5.hexdigest();
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    done.push_back(std::move(file));
+                }
+            }
+
+            archive_read_close(wa);
+            archive_read_free(wa);
+        });
+    }
+    workers.clear();
+
+    if (failed) return ParallelResult::Failed;
+    if (onFile) {
+        for (const auto& file : done) onFile(file);
+    }
+    return ParallelResult::Done;
+}
+
+bool ZipUtil::extract(const std::string& archivePath, const std::string& destPath,
+                      const FileCallback& onFile) {
+    RSJFW_TRACE("ZipUtil::extract", std::filesystem::path(archivePath).filename().string());
+    std::error_code ec;
+    if (std::filesystem::file_size(archivePath, ec) >= kParallelMinSize && !ec &&
+        isZipFile(archivePath)) {
+        ParallelResult pr = extractZipParallel(archivePath, destPath, onFile);
+        if (pr == ParallelResult::Done) return true;
+        // One bad entry or reader shouldn't fail the package; every entry is
+        // rewritten from scratch on the single pass below
+        if (pr == ParallelResult::Failed)
+            LOG_WARN("Parallel extraction of " + archivePath + " failed, retrying sequentially");
+    }
+
+    struct archive* a = archive_read_new();
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+
+    if (archive_read_open_filename(a, archivePath.c_str(), 10240)) {
+        LOG_ERROR("Could not open archive " + archivePath + ": " + std::string(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    bool ok = extractEntries(a, destPath, onFile);
+
+    archive_read_close(a);
+    archive_read_free(a);
+    return ok;
+}
+
+bool ZipUtil::extractStream(const StreamSource& source, const std::string& destPath,
+                            const FileCallback& onFile) {
+    RSJFW_TRACE("ZipUtil::extractStream", destPath);
+    BytePipe pipe(16 * 1024 * 1024);
+
+    std::jthread producer([&]() {
+        bool ok = source([&](const char* data, size_t len) { return pipe.tryPush(data, len); });
+        pipe.close(ok);
+    });
+
+    StreamReadContext ctx{&pipe, {}};
+    struct archive* a = archive_read_new();
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+
+    bool ok = false;
+    if (archive_read_open(a, &ctx, nullptr, streamRead, nullptr) != ARCHIVE_OK) {
+        LOG_ERROR("Could not open archive stream: " + std::string(archive_error_string(a)));
+    } else {
+        ok = extractEntries(a, destPath, onFile);
+        archive_read_close(a);
+    }
+    archive_read_free(a);
+
+    // libarchive stops at the zip central directory; consume the tail so the
+    // producer sees the whole body (callers checksum and cache it)
+    if (ok) {
+        std::vector<char> rest;
+        while (pipe.pop(rest)) {}
+    }
+    // Unblock the producer if we bailed out before draining the stream
+    pipe.abort();
+    producer.join();
+
+    return ok && pipe.producerOk();
+}
+
 } // namespace rsjfw
@@ -426,6 +426,17 @@ void GUI::run(const std::function<void()> &renderCallback) {
         });
       }
 
+      // Stage the next Studio version while the config window is open
+      static bool prefetchStarted = false;
+      if (!prefetchStarted &&
+          Config::instance().getInstaller().backgroundUpdates) {
+        prefetchStarted = true;
+        TaskRunner::instance().run([]() {
+          Downloader dl(PathManager::instance().root().string());
+          dl.prefetchLatest();
+        });
+      }
+
       // Animation state
       // currentMainTab_ is now a member
       // targetMainTab_ is now a member
@@ -4,37 +4,19 @@
 #include "rsjfw/gui.hpp"
 #include "rsjfw/launcher.hpp"
 #include "rsjfw/path_manager.hpp"
+#include "rsjfw/process_supervisor.hpp"
+#include "rsjfw/state.hpp"
 #include "rsjfw/task_runner.hpp"
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
 #include <thread>
 #include <unistd.h>
 
 namespace rsjfw {
 
-static bool isStudioRunning() {
-  // Use pidof which doesn't match itself, look for the actual exe name
-  int ret = system("pgrep -x 'RobloxStudioBeta.exe' >/dev/null 2>&1");
-  if (ret == 0)
-    return true;
-
-  // Fallback: check with grep, excluding grep itself
-  FILE *f = popen(
-      "ps aux 2>/dev/null | grep -i 'RobloxStudio' | grep -v grep | wc -l",
-      "r");
-  if (!f)
-    return false;
-  char buf[16] = {0};
-  fgets(buf, sizeof(buf), f);
-  pclose(f);
-  return (atoi(buf) > 0);
-}
-
-static bool studioRunning = false;
-static float lastCheckTime = -10.0f; // Force immediate check
-
 HomePage::HomePage(GUI *gui, GLuint logoTexture, int logoWidth, int logoHeight)
     : gui_(gui), logoTexture_(logoTexture), logoWidth_(logoWidth),
       logoHeight_(logoHeight) {}
@@ -42,12 +24,15 @@ HomePage::HomePage(GUI *gui, GLuint logoTexture, int logoWidth, int logoHeight)
 void HomePage::render() {
   ImVec2 windowSize = ImGui::GetContentRegionAvail();
 
-  // Check Studio status every 3 seconds
-  float currentTime = (float)ImGui::GetTime();
-  if (currentTime - lastCheckTime > 3.0f) {
-    studioRunning = isStudioRunning();
-    lastCheckTime = currentTime;
-  }
+  // Launches from this process are tracked as they happen and other RSJFW
+  // processes (protocol links) announce theirs; only Studio that was
+  // already running when the GUI opened needs a /proc scan
+  static std::once_flag adopted;
+  std::call_once(adopted, [] {
+    ProcessSupervisor::instance().followLaunches();
+    ProcessSupervisor::instance().adoptRunning();
+  });
+  bool studioRunning = State::instance().isStudioRunning();
 
   // Compact logo
   if (logoTexture_ != 0) {
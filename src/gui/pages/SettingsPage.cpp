@@ -431,6 +431,13 @@ void SettingsPage::renderWineTab() {
     changed = true;
   }
 
+  bool persistentServer = cfg.getWine().persistentServer;
+  if (ImGui::Checkbox("Keep Wine Running", &persistentServer)) {
+    cfg.getWine().persistentServer = persistentServer;
+    changed = true;
+  }
+  ImGui::TextDisabled("Keeps the wineserver warm between launches.");
+
   ImGui::Spacing();
   ImGui::Text("Installed Wine Roots");
   renderInstalledRoots(true);
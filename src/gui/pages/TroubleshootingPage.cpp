@@ -16,6 +16,9 @@
 
 namespace rsjfw {
 
+// Records shown at once from a structured log
+static constexpr uint64_t kLogWindow = 5000;
+
 TroubleshootingPage::TroubleshootingPage() {
     refreshLogList();
     // runHealthChecks(); // Lazy load instead
@@ -409,70 +412,182 @@ void TroubleshootingPage::renderLogsTab() {
         ImGui::Spacing();
         
         // Log content area
-        static std::string logContent;
-        static std::string lastLogPath;
         static auto lastRefresh = std::chrono::steady_clock::now();
         static bool autoScroll = true;
-        
+
+        uint8_t mask = (showErrors ? BinaryLogReader::levelBit(LogLevel::ERROR) : 0) |
+                       (showWarnings ? BinaryLogReader::levelBit(LogLevel::WARNING) : 0) |
+                       (showInfo ? BinaryLogReader::levelBit(LogLevel::INFO) |
+                                       BinaryLogReader::levelBit(LogLevel::DEBUG)
+                                 : 0);
+
         std::string currentLogPath = (PathManager::instance().logs() / logFiles_[selectedLog_]).string();
         auto now = std::chrono::steady_clock::now();
-        bool needsRefresh = (currentLogPath != lastLogPath) || 
-                           (liveMode && std::chrono::duration_cast<std::chrono::milliseconds>(now - lastRefresh).count() > 200);
-        
-        if (needsRefresh) {
-            std::ifstream ifs(currentLogPath);
-            std::stringstream buffer; 
-            buffer << ifs.rdbuf();
-            logContent = buffer.str();
-            lastLogPath = currentLogPath;
+        bool tick = liveMode && std::chrono::duration_cast<std::chrono::milliseconds>(now - lastRefresh).count() > 200;
+
+        if (currentLogPath != loadedLog_) {
+            openLog(currentLogPath);
+            logMask_ = mask;
+            if (structuredLog_) loadLogWindow(logReader_.seekTail(kLogWindow));
+            else filterLog(mask);
+            lastRefresh = now;
+        } else if (tick) {
+            // Only what was appended since the last look is read
+            if (structuredLog_) {
+                if (logReader_.refresh()) loadLogWindow(logReader_.seekTail(kLogWindow));
+            } else {
+                size_t known = logLines_.size();
+                readTextLog();
+                if (logLines_.size() < known) filterLog(mask);
+                for (size_t i = known; i < logLines_.size(); ++i) {
+                    if (BinaryLogReader::levelBit(logLevels_[i]) & mask) logVisible_.push_back((int)i);
+                }
+            }
             lastRefresh = now;
         }
-        
+        if (mask != logMask_) {
+            logMask_ = mask;
+            if (structuredLog_) loadLogWindow(logWindowStart_);
+            else filterLog(mask);
+        }
+
         // Auto-scroll toggle
         ImGui::Checkbox("Auto-scroll", &autoScroll);
         ImGui::SameLine();
         if (ImGui::Button("Copy All", ImVec2(80, 0))) {
-            ImGui::SetClipboardText(logContent.c_str());
+            std::string text;
+            for (int i : logVisible_) text += logLines_[i] + "\n";
+            ImGui::SetClipboardText(text.c_str());
         }
         ImGui::SameLine();
         if (ImGui::Button("Open Folder", ImVec2(100, 0))) {
             std::string cmd = "xdg-open " + PathManager::instance().logs().string() + " &";
             system(cmd.c_str());
         }
-        
+
+        // Structured logs seek through the sparse index instead of scrolling
+        // through hundreds of MB
+        if (structuredLog_ && logReader_.recordCount() > 0) {
+            float span = (logReader_.lastTime() - logReader_.firstTime()) / 1e6f;
+            static float jumpTo = 0.0f;
+            ImGui::SetNextItemWidth(300);
+            ImGui::SliderFloat("##jump", &jumpTo, 0.0f, span, "Jump to +%.1fs");
+            if (ImGui::IsItemDeactivatedAfterEdit()) {
+                liveMode = false;
+                loadLogWindow(logReader_.seekTime(logReader_.firstTime() + (uint64_t)(jumpTo * 1e6)));
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Next Error", ImVec2(90, 0))) {
+                // Step past the record at the top of the window first
+                uint64_t from = logWindowStart_;
+                logReader_.read(from, 1, 0xff, &from);
+                auto hit = logReader_.read(from, 1, BinaryLogReader::levelBit(LogLevel::ERROR));
+                if (!hit.empty()) {
+                    liveMode = false;
+                    loadLogWindow(hit.front().offset);
+                }
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("%llu records", (unsigned long long)logReader_.recordCount());
+        }
+
         ImGui::Spacing();
-        
-        // Log viewer with filtering
+
+        // Log viewer with filtering; only the rows on screen are drawn
         ImGui::BeginChild("LogContent", ImVec2(0, 0), true, ImGuiWindowFlags_HorizontalScrollbar);
-        
-        std::istringstream stream(logContent);
-        std::string line;
-        while (std::getline(stream, line)) {
-            bool isError = line.find("[ERROR]") != std::string::npos || line.find("error") != std::string::npos;
-            bool isWarning = line.find("[WARN]") != std::string::npos || line.find("warn") != std::string::npos;
-            bool isInfo = !isError && !isWarning;
-            
-            if ((isError && showErrors) || (isWarning && showWarnings) || (isInfo && showInfo)) {
-                if (isError) {
+
+        ImGuiListClipper clipper;
+        clipper.Begin((int)logVisible_.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                int i = logVisible_[row];
+                if (logLevels_[i] == LogLevel::ERROR) {
                     ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.3f, 0.3f, 1.0f));
-                } else if (isWarning) {
+                } else if (logLevels_[i] == LogLevel::WARNING) {
                     ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.8f, 0.2f, 1.0f));
                 } else {
                     ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.7f, 0.7f, 0.7f, 1.0f));
                 }
-                ImGui::TextUnformatted(line.c_str());
+                ImGui::TextUnformatted(logLines_[i].c_str());
                 ImGui::PopStyleColor();
             }
         }
-        
+        clipper.End();
+
         if (autoScroll && liveMode) {
             ImGui::SetScrollHereY(1.0f);
         }
-        
+
         ImGui::EndChild();
     }
 }
 
+void TroubleshootingPage::openLog(const std::string& path) {
+    loadedLog_ = path;
+    structuredLog_ = std::filesystem::path(path).extension() == ".rlog";
+    logLines_.clear();
+    logLevels_.clear();
+    logVisible_.clear();
+    logTextSize_ = 0;
+    logPartial_.clear();
+    logReader_.close();
+    if (structuredLog_) logReader_.open(path);
+    else readTextLog();
+}
+
+void TroubleshootingPage::readTextLog() {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(loadedLog_, ec);
+    if (ec) return;
+    if (size < logTextSize_) {
+        // Rotated or truncated
+        logLines_.clear();
+        logLevels_.clear();
+        logTextSize_ = 0;
+        logPartial_.clear();
+    }
+    if (size == logTextSize_) return;
+
+    std::ifstream ifs(loadedLog_, std::ios::binary);
+    ifs.seekg(logTextSize_);
+    std::string chunk(size - logTextSize_, '\0');
+    ifs.read(chunk.data(), chunk.size());
+    chunk.resize(ifs.gcount());
+    logTextSize_ += chunk.size();
+
+    logPartial_ += chunk;
+    size_t pos = 0, nl;
+    while ((nl = logPartial_.find('\n', pos)) != std::string::npos) {
+        std::string line = logPartial_.substr(pos, nl - pos);
+        bool isError = line.find("[ERROR]") != std::string::npos || line.find("error") != std::string::npos;
+        bool isWarning = line.find("[WARN]") != std::string::npos || line.find("warn") != std::string::npos;
+        logLevels_.push_back(isError ? LogLevel::ERROR : isWarning ? LogLevel::WARNING : LogLevel::INFO);
+        logLines_.push_back(std::move(line));
+        pos = nl + 1;
+    }
+    logPartial_.erase(0, pos);
+}
+
+void TroubleshootingPage::loadLogWindow(uint64_t offset) {
+    logWindowStart_ = offset;
+    logLines_.clear();
+    logLevels_.clear();
+    for (const auto& r : logReader_.read(offset, kLogWindow, logMask_)) {
+        logLines_.push_back(BinaryLogReader::format(r));
+        logLevels_.push_back(r.level);
+    }
+    // Already filtered by the reader
+    logVisible_.resize(logLines_.size());
+    for (size_t i = 0; i < logVisible_.size(); ++i) logVisible_[i] = (int)i;
+}
+
+void TroubleshootingPage::filterLog(uint8_t mask) {
+    logVisible_.clear();
+    for (size_t i = 0; i < logLines_.size(); ++i) {
+        if (BinaryLogReader::levelBit(logLevels_[i]) & mask) logVisible_.push_back((int)i);
+    }
+}
+
 // ...
 void TroubleshootingPage::runHealthChecks() {
     auto& diag = Diagnostics::instance();
@@ -485,7 +600,7 @@ void TroubleshootingPage::refreshLogList() {
     auto logsDir = PathManager::instance().logs();
     if (std::filesystem::exists(logsDir)) {
         for (const auto& entry : std::filesystem::directory_iterator(logsDir)) {
-            if (entry.path().extension() == ".log") {
+            if (entry.path().extension() == ".log" || entry.path().extension() == ".rlog") {
                 logFiles_.push_back(entry.path().filename().string());
             }
         }
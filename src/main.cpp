@@ -1,15 +1,22 @@
+#include "rsjfw/binary_log.hpp"
 #include "rsjfw/config.hpp"
 #include "rsjfw/downloader.hpp"
 #include "rsjfw/gui.hpp"
+#include "rsjfw/lan_peers.hpp"
 #include "rsjfw/launcher.hpp"
 #include "rsjfw/logger.hpp"
+#include "rsjfw/mirror.hpp"
 #include "rsjfw/path_manager.hpp"
 #include "rsjfw/socket.hpp"
 #include "rsjfw/task_runner.hpp"
+#include "rsjfw/trace.hpp"
 #include <algorithm>
+#include <csignal>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <string>
 #include <thread>
@@ -25,11 +32,32 @@ void showHelp() {
       << "  reinstall  Force reinstall Roblox Studio (removes versions first)\n"
       << "  launch     Launch the installed Roblox Studio\n"
       << "  kill       Kill any running Roblox Studio instances\n"
+      << "  verify     Check installed versions against their file index\n"
+      << "  share      Serve the package store to LAN peers until stopped\n"
+      << "  prefetch   Stage the latest Roblox Studio in the background\n"
+      << "  mirror sync <dir> [--version <guid>] [--wine <repo[@tag]>|none]\n"
+      << "             [--dxvk <repo[@tag]>|none]\n"
+      << "             Copy a Studio version and Wine/DXVK into an offline "
+         "mirror\n"
+      << "  log text [file] [--level <debug|info|warn|error>] [-f]\n"
+      << "             Print a structured log (default studio_latest.rlog) as "
+         "text\n"
       << "  help       Show this help message\n\n"
       << "Flags:\n"
       << "  -v, --verbose  Enable verbose logging to stdout\n"
       << "  -d, --debug    Enable full Wine debug logging (disable WINEDEBUG "
-         "suppression)\n";
+         "suppression)\n"
+      << "  --trace        Time each setup phase; writes a Chrome trace to "
+         "logs/ on exit or SIGUSR1\n";
+}
+
+// Logs the slowest phases and writes the trace file, once per run
+static void finishTrace() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    rsjfw::Trace::logSummary();
+    rsjfw::Trace::dump();
+  });
 }
 
 #include "rsjfw/version.hpp"
@@ -75,6 +103,15 @@ int main(int argc, char *argv[]) {
     args.erase(itDebug);
   }
 
+  auto itTrace = std::find(args.begin(), args.end(), "--trace");
+  const char *traceEnv = getenv("RSJFW_TRACE");
+  if (itTrace != args.end() || (traceEnv && std::string(traceEnv) == "1")) {
+    rsjfw::Trace::enable(true);
+    rsjfw::Trace::dumpOnSignal(SIGUSR1);
+    if (itTrace != args.end())
+      args.erase(itTrace);
+  }
+
   // Initialize PathManager early for SingleInstance and Logger
   rsjfw::PathManager::instance().init();
   auto &pathMgr = rsjfw::PathManager::instance();
@@ -116,12 +153,16 @@ int main(int argc, char *argv[]) {
     launcher.setDebug(debug);
 
     std::string targetVersion;
-    try {
-      targetVersion = downloader.getLatestVersionGUID();
-    } catch (...) {
+    if (rsjfw::Config::instance().getInstaller().backgroundUpdates)
+      targetVersion = downloader.getCurrentVersion();
+    if (targetVersion.empty()) {
+      try {
+        targetVersion = downloader.getLatestVersionGUID();
+      } catch (...) {
+      }
     }
     if (targetVersion.empty() ||
-        !downloader.isVersionInstalled(targetVersion)) {
+        !downloader.isVersionLaunchable(targetVersion)) {
       auto versions = downloader.getInstalledVersions();
       if (!versions.empty()) {
         std::sort(versions.rbegin(), versions.rend());
@@ -143,10 +184,42 @@ int main(int argc, char *argv[]) {
       launcher.setupFFlags(targetVersion);
       launcher.launchVersion(targetVersion, launchArgs, nullptr, nullptr,
                              false); // Detached
+      finishTrace();
       return 0;
     }
   }
 
+  // Read-only, so it may run next to a live instance
+  if (!args.empty() && args[0] == "log") {
+    if (args.size() < 2 || args[1] != "text") {
+      showHelp();
+      return 1;
+    }
+    std::filesystem::path file = pathMgr.logs() / "studio_latest.rlog";
+    rsjfw::LogLevel level = rsjfw::LogLevel::DEBUG;
+    bool follow = false;
+    for (size_t i = 2; i < args.size(); ++i) {
+      if (args[i] == "-f" || args[i] == "--follow") {
+        follow = true;
+      } else if (args[i] == "--level" && i + 1 < args.size()) {
+        std::string l = args[++i];
+        level = l == "error"  ? rsjfw::LogLevel::ERROR
+                : l == "warn" ? rsjfw::LogLevel::WARNING
+                : l == "info" ? rsjfw::LogLevel::INFO
+                              : rsjfw::LogLevel::DEBUG;
+      } else {
+        file = args[i];
+        if (!std::filesystem::exists(file))
+          file = pathMgr.logs() / args[i];
+      }
+    }
+    if (!rsjfw::BinaryLogReader::toText(file, std::cout, level, follow)) {
+      std::cerr << "[RSJFW] Not a structured log: " << file << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
   // Not a protocol link. Enforce single instance.
   rsjfw::SingleInstance singleInstance(pathMgr.root() / "rsjfw.lock");
   if (!singleInstance.isPrimary()) {
@@ -154,6 +227,30 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  // `share` waits for SIGINT/SIGTERM; blocked before any thread exists so
+  // every thread inherits the mask
+  sigset_t stopSignals;
+  sigemptyset(&stopSignals);
+  sigaddset(&stopSignals, SIGINT);
+  sigaddset(&stopSignals, SIGTERM);
+  const bool sharing = !args.empty() && args[0] == "share";
+  if (sharing)
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+  if (sharing) {
+    rsjfw::LanPeers::instance().start();
+    if (!rsjfw::LanPeers::instance().running()) {
+      std::cerr << "[RSJFW] LAN sharing is off (installer.lan_sharing)\n";
+      return 1;
+    }
+    std::cout << "[RSJFW] Sharing packages on port "
+              << rsjfw::LanPeers::instance().port() << "\n";
+    int sig = 0;
+    sigwait(&stopSignals, &sig);
+    rsjfw::LanPeers::instance().stop();
+    return 0;
+  }
+
   if (!args.empty() && args[0] == "kill") {
     LOG_INFO("Terminating Studio...");
     rsjfw::Launcher launcher(rsjfwRoot);
@@ -161,6 +258,86 @@ int main(int argc, char *argv[]) {
     return launcher.killStudio() ? 0 : 1;
   }
 
+  if (!args.empty() && args[0] == "verify") {
+    rsjfw::Downloader downloader(rsjfwRoot);
+    std::vector<std::string> versions;
+    if (args.size() > 1 && args[1][0] != '-')
+      versions.push_back(args[1]);
+    else
+      versions = downloader.getInstalledVersions();
+
+    bool clean = true;
+    for (const auto &version : versions) {
+      int problems = downloader.verifyVersion(version);
+      if (problems < 0)
+        std::cout << "[RSJFW] " << version
+                  << " has no file index (installed by an older RSJFW)\n";
+      clean = clean && problems == 0;
+    }
+    return clean ? 0 : 1;
+  }
+
+  if (!args.empty() && args[0] == "prefetch") {
+    rsjfw::Downloader downloader(rsjfwRoot);
+    bool ok = downloader.prefetchLatest();
+    rsjfw::TaskRunner::instance().shutdown();
+    finishTrace();
+    return ok ? 0 : 1;
+  }
+
+  if (!args.empty() && args[0] == "mirror") {
+    if (args.size() < 3 || args[1] != "sync") {
+      showHelp();
+      return 1;
+    }
+
+    // Defaults to the configured Wine and DXVK releases
+    auto &gen = rsjfw::Config::instance().getGeneral();
+    auto fromGitHub = [](const std::string &repo) {
+      return repo.find('/') != std::string::npos &&
+             repo.find("://") == std::string::npos;
+    };
+    std::optional<rsjfw::Mirror::ReleaseSource> wine, dxvk;
+    if (fromGitHub(gen.wineSource.repo))
+      wine = rsjfw::Mirror::ReleaseSource{gen.wineSource.repo,
+                                          gen.wineSource.version,
+                                          gen.wineSource.asset, true};
+    if (gen.dxvk && fromGitHub(gen.dxvkSource.repo))
+      dxvk = rsjfw::Mirror::ReleaseSource{gen.dxvkSource.repo,
+                                          gen.dxvkSource.version,
+                                          gen.dxvkSource.asset, false};
+
+    auto parseSource = [](const std::string &spec, bool isWine)
+        -> std::optional<rsjfw::Mirror::ReleaseSource> {
+      if (spec == "none")
+        return std::nullopt;
+      rsjfw::Mirror::ReleaseSource source;
+      source.isWine = isWine;
+      auto at = spec.find('@');
+      source.repo = spec.substr(0, at);
+      if (at != std::string::npos)
+        source.version = spec.substr(at + 1);
+      return source;
+    };
+
+    std::string version;
+    for (size_t i = 3; i + 1 < args.size(); i += 2) {
+      if (args[i] == "--version")
+        version = args[i + 1];
+      else if (args[i] == "--wine")
+        wine = parseSource(args[i + 1], true);
+      else if (args[i] == "--dxvk")
+        dxvk = parseSource(args[i + 1], false);
+    }
+
+    std::vector<rsjfw::Mirror::ReleaseSource> releases;
+    if (wine)
+      releases.push_back(*wine);
+    if (dxvk)
+      releases.push_back(*dxvk);
+    return rsjfw::Mirror::sync(args[2], version, releases) ? 0 : 1;
+  }
+
   std::string command = args.empty() ? "config" : args[0];
   // If the first argument IS a protocol, the command is 'launch'
   if (!args.empty() && (args[0].find("roblox-studio-auth:") == 0 ||
@@ -170,11 +347,18 @@ int main(int argc, char *argv[]) {
 
   LOG_INFO("RSJFW Started. Command: " + command);
 
+  // Serves the package store for as long as this instance runs; only for
+  // the commands that install or stay up, not one-shot ones
+  if (command == "config" || command == "install" ||
+      command == "reinstall" || command == "launch")
+    rsjfw::LanPeers::instance().start();
+
   if (command == "config") {
     auto &gui = rsjfw::GUI::instance();
     if (gui.init(800, 600, "RSJFW - Config", true)) {
       gui.setMode(rsjfw::GUI::MODE_CONFIG);
       gui.run(nullptr);
+      rsjfw::Downloader::cancelBackground();
       return 0;
     } else {
       LOG_ERROR("Could not initialize GUI for config editor. Check logs.");
@@ -244,6 +428,8 @@ int main(int argc, char *argv[]) {
 
           // GPU Compatibility Check - auto-fix DXVK if incompatible
           gui.setProgress(0.05f, "Checking GPU compatibility...");
+          std::optional<rsjfw::Trace::Span> vkSpan(std::in_place,
+                                                   "vulkaninfo");
           std::string vkCmd = "vulkaninfo --summary 2>/dev/null | grep "
                               "'apiVersion' | head -n 1 | awk '{print $3}'";
           FILE *vkPipe = popen(vkCmd.c_str(), "r");
@@ -287,9 +473,22 @@ int main(int argc, char *argv[]) {
             }
             pclose(vkPipe);
           }
-
-          gui.setProgress(0.1f, "Checking for updates...");
-          std::string latestVersion = downloader.getLatestVersionGUID();
+          vkSpan.reset();
+
+          // With background updates the staged version is launched as-is;
+          // the prefetch job keeps it fresh
+          std::string latestVersion;
+          if (!isInstallOnly &&
+              rsjfw::Config::instance().getInstaller().backgroundUpdates &&
+              rsjfw::Config::instance().getGeneral().robloxVersion.empty())
+            latestVersion = downloader.getCurrentVersion();
+
+          if (latestVersion.empty()) {
+            gui.setProgress(0.1f, "Checking for updates...");
+            latestVersion = downloader.getLatestVersionGUID();
+          } else {
+            LOG_INFO("Launching staged version " + latestVersion);
+          }
 
           gui.setProgress(0.2f, "Downloading " + latestVersion + "...");
 
@@ -323,6 +522,7 @@ int main(int argc, char *argv[]) {
           launcher.setupFFlags(latestVersion, launcherProgress);
 
           if (isInstallOnly) {
+            finishTrace();
             gui.setProgress(1.0f, "Installation Complete!");
             std::this_thread::sleep_for(std::chrono::seconds(2));
             gui.close();
@@ -363,6 +563,9 @@ int main(int argc, char *argv[]) {
 
           // Create window detector flag
           std::atomic<bool> studioStarted{false};
+          // Until Studio prints that its window is up
+          // Ended from the log reader thread, hence an Interval
+          rsjfw::Trace::Interval startupSpan("Studio startup");
 
           auto persistentProgress = [&](float p, std::string msg) {
             gui.setSubProgress(p, msg);
@@ -389,6 +592,7 @@ int main(int argc, char *argv[]) {
 
                       LOG_INFO("Studio window detected: " + line);
                       studioStarted = true;
+                      startupSpan.end();
                       gui.setSubProgress(1.0f, "Studio Started.");
                       std::this_thread::sleep_for(
                           std::chrono::milliseconds(800));
@@ -409,13 +613,16 @@ int main(int argc, char *argv[]) {
       gui.run(nullptr);
       gui.shutdown();
       rsjfw::TaskRunner::instance().shutdown();
+      finishTrace();
       return 0;
 
     } else {
       if (command == "install") {
         LOG_INFO("Starting installation to " + rsjfwRoot);
         rsjfw::Downloader downloader(rsjfwRoot);
-        return downloader.installLatest() ? 0 : 1;
+        bool ok = downloader.installLatest();
+        finishTrace();
+        return ok ? 0 : 1;
       } else {
         LOG_ERROR("GUI initialization-failed-fallback not fully implemented "
                   "for launch.");
@@ -0,0 +1,149 @@
+// Round trip of the structured Studio log: write, index, read back, and the
+// session handling `rsjfw log text -f` and the Troubleshooting viewer rely on
+#include "rsjfw/binary_log.hpp"
+#include "check.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using rsjfw::BinaryLogReader;
+using rsjfw::BinaryLogWriter;
+using rsjfw::LogLevel;
+using rsjfw::LogSource;
+
+static LogLevel levelFor(int i) {
+  return i % 100 == 0 ? LogLevel::ERROR
+         : i % 10 == 0 ? LogLevel::WARNING
+                       : LogLevel::DEBUG;
+}
+
+static void writeSession(const fs::path &path, const std::string &tag,
+                         int count) {
+  BinaryLogWriter writer;
+  CHECK(writer.open(path));
+  for (int i = 0; i < count; ++i)
+    writer.append(levelFor(i), LogSource::Wine, i % 2 ? "d3d" : "",
+                  tag + " line " + std::to_string(i));
+}
+
+static void testRoundTrip(const fs::path &dir) {
+  fs::path path = dir / "roundtrip.rlog";
+  const int count = 5000; // several indexed blocks plus an unindexed tail
+  writeSession(path, "a", count);
+
+  BinaryLogReader reader;
+  CHECK(reader.open(path));
+  CHECK(reader.recordCount() == static_cast<uint64_t>(count));
+  CHECK(reader.blocks().size() > 1);
+
+  uint64_t next = 0;
+  auto all = reader.read(reader.seekTail(count), count, 0xff, &next);
+  CHECK(all.size() == static_cast<size_t>(count));
+  CHECK(all.front().message == "a line 0");
+  CHECK(all.back().message == "a line " + std::to_string(count - 1));
+  CHECK(all[1].channel == "d3d" && all[1].source == LogSource::Wine);
+  CHECK(all[100].level == LogLevel::ERROR);
+
+  auto errors = reader.read(reader.seekTail(count), count,
+                            BinaryLogReader::levelBit(LogLevel::ERROR));
+  CHECK(errors.size() == static_cast<size_t>(count / 100));
+
+  auto tail = reader.read(reader.seekTail(10), count, 0xff);
+  CHECK(tail.size() >= 10);
+  CHECK(tail.back().message == all.back().message);
+
+  std::ostringstream text;
+  CHECK(BinaryLogReader::toText(path, text, LogLevel::WARNING));
+  CHECK(text.str().find("[ERROR] [wine] a line 100\n") != std::string::npos);
+  CHECK(text.str().find("a line 1\n") == std::string::npos);
+}
+
+static void testIdleFlush(const fs::path &dir) {
+  fs::path path = dir / "idle.rlog";
+  BinaryLogWriter writer;
+  CHECK(writer.open(path));
+  writer.append(LogLevel::INFO, LogSource::Studio, "", "only line");
+
+  // No further output, no flush(): the writer still has to get it out
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  BinaryLogReader reader;
+  CHECK(reader.open(path));
+  auto records = reader.read(0, 10, 0xff);
+  CHECK(records.size() == 1 && records[0].message == "only line");
+}
+
+static void testNewSession(const fs::path &dir) {
+  fs::path path = dir / "session.rlog";
+  writeSession(path, "first", 50);
+
+  BinaryLogReader reader;
+  CHECK(reader.open(path));
+  CHECK(reader.recordCount() == 50);
+  uint64_t session = reader.session();
+
+  // A longer rewrite: the file never looks truncated to the reader
+  writeSession(path, "second", 3000);
+  CHECK(reader.refresh());
+  CHECK(reader.session() != session);
+  CHECK(reader.recordCount() == 3000);
+  auto records = reader.read(0, 1, 0xff);
+  CHECK(!records.empty() && records[0].message == "second line 0");
+
+  // Replaced by a different file altogether
+  session = reader.session();
+  fs::path other = dir / "other.rlog";
+  writeSession(other, "third", 20);
+  fs::rename(other, path);
+  fs::rename(other.string() + ".idx", path.string() + ".idx");
+  CHECK(reader.refresh());
+  CHECK(reader.session() != session);
+  CHECK(reader.recordCount() == 20);
+}
+
+static void testBusyWriter(const fs::path &dir) {
+  fs::path path = dir / "busy.rlog";
+  BinaryLogWriter first;
+  CHECK(first.open(path));
+  first.append(LogLevel::INFO, LogSource::Studio, "", "still running");
+  first.flush();
+
+  BinaryLogWriter second;
+  CHECK(second.open(path));
+  CHECK(second.path() != path);
+  second.append(LogLevel::INFO, LogSource::Studio, "", "second session");
+  second.close();
+
+  BinaryLogReader reader;
+  CHECK(reader.open(path));
+  auto records = reader.read(0, 10, 0xff);
+  CHECK(records.size() == 1 && records[0].message == "still running");
+  CHECK(fs::exists(second.path()));
+
+  // Once nobody writes it, the next session cleans the overflow log up
+  first.close();
+  BinaryLogWriter third;
+  CHECK(third.open(path));
+  CHECK(third.path() == path);
+  CHECK(!fs::exists(second.path()));
+}
+
+int main() {
+  fs::path dir = fs::temp_directory_path() /
+                 ("rsjfw-binary-log-test-" + std::to_string(getpid()));
+  fs::create_directories(dir);
+
+  testRoundTrip(dir);
+  testIdleFlush(dir);
+  testNewSession(dir);
+  testBusyWriter(dir);
+
+  fs::remove_all(dir);
+  return testResult();
+}
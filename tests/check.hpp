@@ -0,0 +1,26 @@
+// Minimal assertions shared by the tests: CHECK records a failure and keeps
+// going, main returns testResult()
+#ifndef RSJFW_TESTS_CHECK_HPP
+#define RSJFW_TESTS_CHECK_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+static int testResult() {
+  if (failures)
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif // RSJFW_TESTS_CHECK_HPP
@@ -0,0 +1,31 @@
+// Package classes the installer schedules by: the boot order, and every
+// deferred package must be a real manifest name, or launch-before-complete
+// silently waits on it
+#include "rsjfw/downloader.hpp"
+#include "check.hpp"
+#include <string>
+
+using rsjfw::Downloader;
+
+int main() {
+  for (const auto &name : Downloader::deferrablePackages()) {
+    CHECK(Downloader::isKnownPackage(name));
+    CHECK(!Downloader::isCriticalPackage(name));
+  }
+  CHECK(!Downloader::isCriticalPackage("content-qt_translations.zip"));
+  CHECK(Downloader::isCriticalPackage("RobloxStudio.zip"));
+  CHECK(Downloader::isCriticalPackage("content-sounds.zip"));
+
+  // Boot order stays explicit however short the deferral list is
+  CHECK(Downloader::bootPriority("RobloxStudio.zip") <
+        Downloader::bootPriority("Libraries.zip"));
+  CHECK(Downloader::bootPriority("Libraries.zip") <
+        Downloader::bootPriority("shaders.zip"));
+  CHECK(Downloader::bootPriority("shaders.zip") <
+        Downloader::bootPriority("content-sounds.zip"));
+  CHECK(Downloader::bootPriority("content-sounds.zip") ==
+        Downloader::bootPriority("content-textures2.zip"));
+  CHECK(Downloader::isKnownPackage("RobloxStudio.zip"));
+
+  return testResult();
+}
@@ -0,0 +1,113 @@
+// The /proc scanner against real processes: getdents64 listing, stat field
+// 22 behind a process name with spaces and ')', environ parsing, and a prefix
+// that is stat()ed on every scan, so one re-created at the same path still
+// matches
+#include "rsjfw/process.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <climits>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using rsjfw::Process;
+
+static std::string sleepBinary() {
+  for (const char *p : {"/bin/sleep", "/usr/bin/sleep"})
+    if (access(p, X_OK) == 0)
+      return p;
+  return "";
+}
+
+// Runs a copy of sleep under `exe` with WINEPREFIX=`prefix`, once it has
+// exec()ed
+static pid_t spawn(const fs::path &exe, const fs::path &prefix) {
+  fs::copy_file(sleepBinary(), exe, fs::copy_options::overwrite_existing);
+  fs::permissions(exe, fs::perms::owner_all);
+  std::string env = "WINEPREFIX=" + prefix.string();
+  pid_t pid = fork();
+  if (pid == 0) {
+    char *argv[] = {const_cast<char *>(exe.c_str()), const_cast<char *>("30"),
+                    nullptr};
+    char *envp[] = {const_cast<char *>("RSJFW_TEST=WINEPREFIX=/decoy"),
+                    const_cast<char *>(env.c_str()), nullptr};
+    execve(exe.c_str(), argv, envp);
+    _exit(127);
+  }
+  std::string link = "/proc/" + std::to_string(pid) + "/exe";
+  for (int i = 0; i < 200; ++i) {
+    char target[PATH_MAX];
+    ssize_t n = readlink(link.c_str(), target, sizeof(target));
+    if (n > 0 && std::string(target, n) == exe.string())
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return pid;
+}
+
+static void stop(pid_t pid) {
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+static bool hasPid(const std::vector<rsjfw::ProcessInfo> &procs, pid_t pid) {
+  return std::any_of(procs.begin(), procs.end(),
+                     [&](const auto &p) { return p.pid == pid; });
+}
+
+int main() {
+  if (sleepBinary().empty()) {
+    std::fprintf(stderr, "no sleep binary, skipping\n");
+    return EXIT_SUCCESS;
+  }
+  fs::path dir = fs::temp_directory_path() /
+                 ("rsjfw-proc-test-" + std::to_string(getpid()));
+  fs::path prefix = dir / "prefix";
+  fs::create_directories(prefix);
+
+  // Wine-looking helper whose name puts spaces and ')' into /proc/pid/stat
+  pid_t helper = spawn(dir / "wine) (x y", prefix);
+  auto byName = Process::findByName("wine) (x");
+  CHECK(hasPid(byName, helper));
+  for (const auto &p : byName)
+    if (p.pid == helper)
+      CHECK(p.winePrefix == prefix.string());
+
+  // Not Studio, so never a target for killStudioInPrefix
+  CHECK(!hasPid(Process::findStudioInPrefix(prefix.string()), helper));
+
+  pid_t studio = spawn(dir / "RobloxStudioBeta.exe", prefix);
+  auto inPrefix = Process::findStudioInPrefix(prefix.string());
+  CHECK(hasPid(inPrefix, studio));
+  CHECK(!hasPid(inPrefix, helper));
+  auto anywhere = Process::findStudio();
+  CHECK(std::find(anywhere.begin(), anywhere.end(), studio) != anywhere.end());
+
+  // Prefix set up again at the same path: a new inode, same processes
+  fs::path fresh = dir / "fresh";
+  fs::create_directories(fresh);
+  fs::rename(prefix, dir / "old");
+  fs::rename(fresh, prefix);
+  CHECK(hasPid(Process::findStudioInPrefix(prefix.string()), studio));
+  // The old directory is just another path now
+  CHECK(!hasPid(Process::findStudioInPrefix((dir / "old").string()), studio));
+
+  CHECK(Process::findStudioInPrefix((dir / "missing").string()).empty());
+
+  stop(studio);
+  CHECK(!hasPid(Process::findStudioInPrefix(prefix.string()), studio));
+  stop(helper);
+  CHECK(!hasPid(Process::findByName("wine) (x"), helper));
+
+  fs::remove_all(dir);
+  return testResult();
+}
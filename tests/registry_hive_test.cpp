@@ -0,0 +1,165 @@
+// Wine text hives: parse -> apply -> save must change only what was set, and
+// the native path must stay off while a wineserver owns the prefix
+#include "rsjfw/registry.hpp"
+#include "rsjfw/wine.hpp"
+#include "check.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using rsjfw::RegistryHive;
+
+static const char USER_REG[] =
+    "WINE REGISTRY Version 2\n"
+    ";; All keys relative to \\\\User\\\\S-1-5-21-0-0-0-1000\n"
+    "\n"
+    "#arch=win64\n"
+    "\n"
+    "[Control Panel\\\\Desktop] 1700000000\n"
+    "#time=1da0000000000000\n"
+    "\"FontSmoothing\"=\"2\"\n"
+    "\"WheelScrollLines\"=\"3\"\n"
+    "\n"
+    "[Software\\\\Wine\\\\Direct3D] 1700000000\n"
+    "#time=1da0000000000000\n"
+    "\"Blob\"=hex:00,01,02,03,04,05,06,07,08,09,0a,0b,0c,0d,0e,0f,10,11,12,13,\\\n"
+    "  14,15\n"
+    "\"MaxVersionGL\"=dword:00040006\n"
+    "@=\"default\"\n"
+    "\n";
+
+static std::string readFile(const fs::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+static void testParse(const fs::path &file) {
+  RegistryHive hive;
+  CHECK(hive.load(file));
+  CHECK(hive.hasKey("control panel\\desktop"));
+  const auto *v = hive.find("Software\\Wine\\Direct3D", "maxversiongl");
+  CHECK(v && v->type == RegistryHive::DWORD && v->dword == 0x40006);
+  v = hive.find("Software\\Wine\\Direct3D", "Blob");
+  CHECK(v && v->type == RegistryHive::BINARY && v->data.size() == 22 &&
+        v->data[21] == 0x15);
+  v = hive.find("Software\\Wine\\Direct3D", "");
+  CHECK(v && v->type == RegistryHive::SZ && v->str == "default");
+
+  // Saving untouched keeps every line as it was; only continued hex data
+  // comes back joined onto one line
+  fs::path copy = file.parent_path() / "copy.reg";
+  CHECK(hive.save(copy));
+  std::string expected = USER_REG;
+  expected.erase(expected.find("\\\n  14"), 4);
+  CHECK(readFile(copy) == expected);
+}
+
+static void testApply(const fs::path &prefix) {
+  std::vector<rsjfw::wine::Prefix::RegistryEntry> entries = {
+      {"HKCU\\Control Panel\\Desktop", "FontSmoothing", "0", "REG_SZ"},
+      {"HKEY_CURRENT_USER\\Software\\Wine\\Direct3D", "csmt", "0x1",
+       "REG_DWORD"},
+      {"HKCU\\Software\\Wine\\Direct3D", "Renderer", "vulkan", ""},
+      {"HKCU\\Software\\Roblox\\New Key", "Data", "deadbeef", "REG_BINARY"},
+      {"HKCU\\Software\\Roblox\\New Key", "Path", "%TEMP%\\x",
+       "REG_EXPAND_SZ"},
+  };
+  CHECK(RegistryHive::apply(prefix, entries));
+
+  std::string text = readFile(prefix / "user.reg");
+  // Values nobody set are written back byte for byte
+  CHECK(text.find("\"WheelScrollLines\"=\"3\"\n") != std::string::npos);
+  CHECK(text.find("\"Blob\"=hex:00,01,02,03,04,05,06,07,08,09,0a,0b,0c,0d,"
+                  "0e,0f,10,11,12,13,14,15\n") != std::string::npos);
+  CHECK(text.find("#arch=win64\n") != std::string::npos);
+
+  RegistryHive hive;
+  CHECK(hive.load(prefix / "user.reg"));
+  const auto *v = hive.find("Control Panel\\Desktop", "FontSmoothing");
+  CHECK(v && v->type == RegistryHive::SZ && v->str == "0");
+  v = hive.find("Software\\Wine\\Direct3D", "csmt");
+  CHECK(v && v->type == RegistryHive::DWORD && v->dword == 1);
+  v = hive.find("Software\\Wine\\Direct3D", "Renderer");
+  CHECK(v && v->str == "vulkan");
+  v = hive.find("Software\\Wine\\Direct3D", "MaxVersionGL");
+  CHECK(v && v->dword == 0x40006);
+  v = hive.find("Software\\Roblox\\New Key", "Data");
+  CHECK(v && v->type == RegistryHive::BINARY &&
+        v->data == std::vector<unsigned char>({0xde, 0xad, 0xbe, 0xef}));
+  v = hive.find("Software\\Roblox\\New Key", "Path");
+  CHECK(v && v->type == RegistryHive::EXPAND_SZ && v->str == "%TEMP%\\x");
+
+  // A batch with anything it can't do natively writes nothing
+  std::string before = readFile(prefix / "user.reg");
+  CHECK(!RegistryHive::apply(
+      prefix, {{"HKCU\\Software\\Wine", "A", "1", "REG_SZ"},
+               {"HKCU\\Software\\Wine", "B", "x", "REG_MULTI_SZ"}}));
+  CHECK(readFile(prefix / "user.reg") == before);
+}
+
+static void testServerLock(const fs::path &prefix) {
+  rsjfw::wine::Prefix pfx("", prefix.string());
+  bool ran = false;
+  CHECK(pfx.withServerStopped([&] { return ran = true; }));
+  CHECK(ran);
+  CHECK(!pfx.serverRunning());
+
+  // Stand in for a wineserver: a child holding the lock the same way
+  int ready[2], done[2];
+  CHECK(pipe(ready) == 0 && pipe(done) == 0);
+  pid_t child = fork();
+  if (child == 0) {
+    struct stat st{};
+    ::stat(prefix.c_str(), &st);
+    char path[160];
+    std::snprintf(path, sizeof(path), "/tmp/.wine-%u/server-%llx-%llx/lock",
+                  static_cast<unsigned>(getuid()),
+                  static_cast<unsigned long long>(st.st_dev),
+                  static_cast<unsigned long long>(st.st_ino));
+    int fd = ::open(path, O_WRONLY);
+    struct flock fl{};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    char c = fd >= 0 && fcntl(fd, F_SETLK, &fl) == 0 ? 1 : 0;
+    (void)!write(ready[1], &c, 1);
+    (void)!read(done[0], &c, 1);
+    _exit(0);
+  }
+  char c = 0;
+  CHECK(read(ready[0], &c, 1) == 1 && c == 1);
+  ran = false;
+  CHECK(pfx.serverRunning());
+  CHECK(!pfx.withServerStopped([&] { return ran = true; }));
+  CHECK(!ran);
+  (void)!write(done[1], &c, 1);
+  waitpid(child, nullptr, 0);
+  CHECK(pfx.withServerStopped([&] { return ran = true; }));
+}
+
+int main() {
+  fs::path prefix = fs::temp_directory_path() /
+                    ("rsjfw-registry-test-" + std::to_string(getpid()));
+  fs::create_directories(prefix);
+  {
+    std::ofstream out(prefix / "user.reg", std::ios::binary);
+    out << USER_REG;
+  }
+
+  testParse(prefix / "user.reg");
+  testApply(prefix);
+  testServerLock(prefix);
+
+  fs::remove_all(prefix);
+  return testResult();
+}
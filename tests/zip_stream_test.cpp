@@ -0,0 +1,178 @@
+// Streamed package extraction: entries written with data descriptors (flag
+// bit 3) carry no size in their local header and must still be inflated
+#include "rsjfw/md5.hpp"
+#include "rsjfw/zip_util.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using rsjfw::SinkResult;
+using rsjfw::ZipUtil;
+
+static uint32_t crc32(const std::string &data) {
+  uint32_t crc = 0xffffffff;
+  for (unsigned char c : data) {
+    crc ^= c;
+    for (int k = 0; k < 8; ++k)
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void put16(std::string &out, uint32_t v) {
+  out += static_cast<char>(v & 0xff);
+  out += static_cast<char>((v >> 8) & 0xff);
+}
+
+static void put32(std::string &out, uint32_t v) {
+  put16(out, v & 0xffff);
+  put16(out, v >> 16);
+}
+
+// Deflated with stored blocks only, sizes and CRC deferred to a data
+// descriptor after each entry, the way streaming zip writers emit them
+static std::string dataDescriptorZip(
+    const std::vector<std::pair<std::string, std::string>> &files) {
+  std::string zip, central;
+  for (const auto &[name, data] : files) {
+    std::string deflated;
+    size_t pos = 0;
+    do {
+      size_t len = std::min<size_t>(data.size() - pos, 0xffff);
+      bool last = pos + len == data.size();
+      deflated += static_cast<char>(last ? 1 : 0);
+      put16(deflated, len);
+      put16(deflated, ~len & 0xffff);
+      deflated.append(data, pos, len);
+      pos += len;
+    } while (pos < data.size());
+
+    uint32_t offset = zip.size();
+    uint32_t crc = crc32(data);
+
+    put32(zip, 0x04034b50);
+    put16(zip, 20);
+    put16(zip, 0x0008);
+    put16(zip, 8);
+    put16(zip, 0);
+    put16(zip, 0x21);
+    put32(zip, 0);
+    put32(zip, 0);
+    put32(zip, 0);
+    put16(zip, name.size());
+    put16(zip, 0);
+    zip += name;
+    zip += deflated;
+    put32(zip, 0x08074b50);
+    put32(zip, crc);
+    put32(zip, deflated.size());
+    put32(zip, data.size());
+
+    put32(central, 0x02014b50);
+    put16(central, 20);
+    put16(central, 20);
+    put16(central, 0x0008);
+    put16(central, 8);
+    put16(central, 0);
+    put16(central, 0x21);
+    put32(central, crc);
+    put32(central, deflated.size());
+    put32(central, data.size());
+    put16(central, name.size());
+    put16(central, 0);
+    put16(central, 0);
+    put16(central, 0);
+    put16(central, 0);
+    put32(central, 0);
+    put32(central, offset);
+    central += name;
+  }
+
+  uint32_t centralOffset = zip.size();
+  zip += central;
+  put32(zip, 0x06054b50);
+  put16(zip, 0);
+  put16(zip, 0);
+  put16(zip, files.size());
+  put16(zip, files.size());
+  put32(zip, central.size());
+  put32(zip, centralOffset);
+  put16(zip, 0);
+  return zip;
+}
+
+static std::string readFile(const fs::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+static std::string md5Of(const std::string &data) {
+  rsjfw::Md5 md5;
+  md5.update(data.data(), data.size());
+  return md5.hexdigest();
+}
+
+int main() {
+  fs::path dir = fs::temp_directory_path() /
+                 ("rsjfw-zip-stream-test-" + std::to_string(getpid()));
+  fs::remove_all(dir);
+
+  std::string big;
+  for (int i = 0; big.size() < 200000; ++i)
+    big += "line " + std::to_string(i) + "\n";
+  std::vector<std::pair<std::string, std::string>> files = {
+      {"RobloxStudioBeta.exe", "MZ studio"},
+      {"content/fonts/big.txt", big},
+      {"empty.txt", ""},
+  };
+  std::string zip = dataDescriptorZip(files);
+
+  std::map<std::string, ZipUtil::ExtractedFile> seen;
+  bool ok = ZipUtil::extractStream(
+      [&](const rsjfw::ByteSink &sink) {
+        // Small chunks so local headers and descriptors straddle reads
+        for (size_t pos = 0; pos < zip.size();) {
+          size_t len = std::min<size_t>(zip.size() - pos, 4096);
+          SinkResult r = sink(zip.data() + pos, len);
+          if (r == SinkResult::Abort)
+            return false;
+          if (r == SinkResult::Full) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+          }
+          pos += len;
+        }
+        return true;
+      },
+      dir.string(),
+      [&](const ZipUtil::ExtractedFile &file) { seen[file.path] = file; });
+
+  CHECK(ok);
+  for (const auto &[name, data] : files) {
+    fs::path path = dir / name;
+    CHECK(fs::is_regular_file(path));
+    CHECK(readFile(path) == data);
+    auto it = seen.find(path.string());
+    CHECK(it != seen.end());
+    if (it == seen.end())
+      continue;
+    CHECK(it->second.size == data.size());
+    CHECK(it->second.md5 == md5Of(data));
+  }
+
+  fs::remove_all(dir);
+  return testResult();
+}